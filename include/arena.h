@@ -0,0 +1,79 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * a bump allocator for data that lives until a known point, e.g. the end of
+ * a frame. Allocation is a pointer bump and nothing is freed individually;
+ * reset releases everything at once. If the block runs out, the rest of the
+ * cycle spills into separately allocated blocks, and the next reset grows
+ * the block to the high-water mark, so a steady workload stops allocating
+ * after its first few cycles
+ */
+class LinearArena {
+public:
+	void init(size_t capacity);
+
+	void *allocate(size_t size, size_t alignment);
+
+	/* everything allocated since the last reset must be dead */
+	void reset();
+
+	size_t getUsed() const { return used + overflowUsed; }
+	size_t getCapacity() const { return capacity; }
+	size_t getHighWater() const { return highWater; }
+	uint32_t getGrowCount() const { return growCount; }
+
+private:
+	std::unique_ptr<uint8_t[]> block;
+	size_t capacity = 0;
+	size_t used = 0;
+
+	std::vector<std::unique_ptr<uint8_t[]>> overflowBlocks;
+	size_t overflowUsed = 0;
+
+	size_t highWater = 0;
+	uint32_t growCount = 0;
+};
+
+/*
+ * Standard allocator over a LinearArena, for containers that only live as
+ * long as the arena's cycle. deallocate does nothing, so a container that
+ * grows leaves its old storage behind until the reset; reserve up front
+ * where the size is known.
+ */
+template<typename T>
+struct ArenaAllocator {
+	typedef T value_type;
+
+	LinearArena *arena;
+
+	explicit ArenaAllocator(LinearArena &arena) : arena(&arena) {}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+	T *allocate(size_t count) {
+		return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *, size_t) {}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/* calls to the global operator new since the program started, from any thread */
+uint64_t getHeapAllocationCount();
+
+#endif
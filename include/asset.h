@@ -0,0 +1,107 @@
+#ifndef _ASSET_H
+#define _ASSET_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "lod.h"
+#include "vertex.h"
+
+/*
+ * Cooked asset container (.spk). Everything after the header is a table of
+ * sections followed by the section payloads, each starting on a 16-byte
+ * boundary. Vertex and index payloads are already in the layout the vertex
+ * and index buffers expect, so loading is an mmap plus memcpy into staging.
+ *
+ *   AssetHeader
+ *   AssetSection[sectionCount]
+ *   payloads...
+ */
+const uint32_t ASSET_MAGIC     = 0x414b5053;	// "SPKA"
+const uint32_t ASSET_VERSION   = 1;
+const uint32_t ASSET_ALIGNMENT = 16;
+
+enum AssetSectionType : uint32_t {
+	ASSET_SECTION_VERTICES     = 1,		// Vertex[]
+	ASSET_SECTION_INDICES      = 2,		// uint32_t[], local to each mesh
+	ASSET_SECTION_MESHES       = 3,		// AssetMesh[]
+	ASSET_SECTION_TEXTURES     = 4,		// AssetTexture[]
+	ASSET_SECTION_TEXTURE_DATA = 5		// texel payloads referenced by AssetTexture
+};
+
+struct AssetHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sectionCount;
+	uint32_t reserved;
+};
+
+struct AssetSection {
+	uint32_t type;
+	uint32_t count;		// number of elements
+	uint64_t offset;	// from the start of the file, ASSET_ALIGNMENT aligned
+	uint64_t size;		// in bytes
+	uint64_t reserved;
+};
+
+struct AssetMeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+
+struct AssetMesh {
+	int32_t vertexOffset;
+	uint32_t vertexCount;
+	float center[3];
+	float radius;
+	uint32_t lodCount;
+	AssetMeshLod lods[MAX_MESH_LODS];
+};
+
+struct AssetTexture {
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;		// VkFormat of the payload, R8G8B8A8 UNORM or SRGB
+	uint32_t mipLevels;		// 1; only the top level is stored
+	uint64_t dataOffset;	// into the texture data section
+	uint64_t dataSize;
+};
+
+// the on-disk layout is the GPU layout, so it must not drift silently
+static_assert(sizeof(Vertex) == 32, "Vertex layout changed, bump ASSET_VERSION");
+static_assert(sizeof(AssetHeader) == 16, "AssetHeader must stay 16 bytes");
+static_assert(sizeof(AssetSection) == 32, "AssetSection must stay 32 bytes");
+static_assert(sizeof(AssetTexture) == 32, "AssetTexture must stay 32 bytes");
+
+/**
+ * read-only memory mapping of a cooked asset file. open rejects a file whose
+ * tables do not fit their sections, whose meshes reach outside the vertex and
+ * index arrays, or whose textures are not the format and size they claim, so
+ * nothing read from an open file needs checking again
+ */
+class AssetFile {
+public:
+	~AssetFile();
+
+	bool open(const char *path);
+	void close();
+
+	/* payload of the first section of the given type, or nullptr */
+	const void *getSection(AssetSectionType type, uint64_t *size = nullptr, uint32_t *count = nullptr) const;
+
+	/* an empty mesh (no LODs) if index is out of range */
+	Mesh getMesh(uint32_t index) const;
+	uint32_t getMeshCount() const;
+
+private:
+	bool validate(const char *path) const;
+
+	const uint8_t *data = nullptr;
+	size_t length = 0;
+
+	const AssetSection *sections = nullptr;
+	uint32_t sectionCount = 0;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _DELETION_H
+#define _DELETION_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+/**
+ * defers destroying GPU objects until the work that may still use them has
+ * completed. Each deleter is tagged with the last frame (or any other
+ * monotonically increasing timeline value) that may use the object, and runs
+ * once that value has completed. Tags must be pushed in non-decreasing order
+ */
+class DeletionQueue {
+public:
+	void push(uint64_t lastUse, std::function<void()> deleter);
+
+	/* runs the deleters of everything last used at or before completed */
+	void collect(uint64_t completed);
+
+	/* runs every deleter; the device must be idle */
+	void flush();
+
+	size_t size() const { return entries.size(); }
+
+private:
+	struct Entry {
+		uint64_t lastUse;
+		std::function<void()> deleter;
+	};
+
+	std::deque<Entry> entries;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _DEVICECAPS_H
+#define _DEVICECAPS_H
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/**
+ * everything the engine asks a physical device, queried once. Format
+ * support is filled in as formats are first asked about; that lookup is
+ * thread-safe, the rest is read-only after init
+ */
+class DeviceCapabilities {
+public:
+	/**
+	 * queries device on instance, created for instanceApiVersion; the 1.1,
+	 * 1.2 and 1.3 feature structs are left zeroed unless both the instance
+	 * and the device are at that version. externalMemoryCapabilities says
+	 * whether VK_KHR_external_memory_capabilities is enabled on the instance
+	 */
+	void init(VkInstance instance, VkPhysicalDevice device, uint32_t instanceApiVersion, bool properties2Supported,
+			bool externalMemoryCapabilities);
+
+	DeviceCapabilities() = default;
+
+	/* takes over another device's queries, e.g. the candidate that was selected; not thread-safe */
+	DeviceCapabilities &operator=(DeviceCapabilities &&other);
+
+	bool extensionSupported(const char *name) const;
+
+	/* first family with a queue and all of queueBits, none of excludedBits; -1 if none */
+	int findQueueFamily(VkQueueFlags queueBits, VkQueueFlags excludedBits = 0) const;
+
+	/* first memory type in typeBits with all of desiredProperties; -1 if none */
+	int findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags desiredProperties) const;
+
+	const VkFormatProperties &getFormatProperties(VkFormat format) const;
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+	VkPhysicalDeviceProperties properties;		// limits are properties.limits
+	VkPhysicalDeviceFeatures features;
+	VkPhysicalDeviceVulkan11Features features11;
+	VkPhysicalDeviceVulkan12Features features12;
+	VkPhysicalDeviceVulkan13Features features13;
+
+	// zeroed unless VK_KHR_fragment_shading_rate is supported
+	VkPhysicalDeviceFragmentShadingRateFeaturesKHR fragmentShadingRateFeatures;
+	VkPhysicalDeviceFragmentShadingRatePropertiesKHR fragmentShadingRateProperties;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkDeviceSize deviceLocalHeapSize;			// of the largest device-local heap
+
+	std::vector<VkQueueFamilyProperties> queueFamilies;
+	std::vector<VkExtensionProperties> extensions;
+
+	bool uuidValid;								// needs Vulkan 1.1, or properties2 and external memory capabilities
+	uint8_t deviceUUID[VK_UUID_SIZE];
+
+private:
+	mutable std::mutex formatMutex;
+	mutable std::unordered_map<uint32_t, VkFormatProperties> formatProperties;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef _DRAWQUEUE_H
+#define _DRAWQUEUE_H
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/*
+ * Layout of the 64-bit draw sort key, most significant field first, so that
+ * sorting the keys groups draws by pass, then pipeline, then material, etc.
+ *
+ *   63..60  pass      (4 bits)
+ *   59..48  pipeline  (12 bits)
+ *   47..32  material  (16 bits)
+ *   31..16  mesh      (16 bits)
+ *   15..0   depth     (16 bits, quantised view depth)
+ */
+const uint32_t DRAW_KEY_PASS_BITS     = 4;
+const uint32_t DRAW_KEY_PIPELINE_BITS = 12;
+const uint32_t DRAW_KEY_MATERIAL_BITS = 16;
+const uint32_t DRAW_KEY_MESH_BITS     = 16;
+const uint32_t DRAW_KEY_DEPTH_BITS    = 16;
+
+struct DrawCommand {
+	uint64_t key;
+
+	VkPipeline pipeline;
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSet;
+	VkBuffer vertexBuffer;
+	VkBuffer indexBuffer;		// VK_NULL_HANDLE for non-indexed draws
+
+	uint32_t count;				// index count, or vertex count if non-indexed
+	uint32_t instanceCount;
+	uint32_t firstIndex;		// first vertex if non-indexed
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+
+	// if set, count through firstInstance are ignored and the arguments are
+	// read from this buffer at indirectOffset when the draw executes
+	VkBuffer indirectBuffer;
+	VkDeviceSize indirectOffset;
+};
+
+struct DrawStats {
+	uint32_t draws;
+	uint32_t pipelineBinds;
+	uint32_t descriptorSetBinds;
+	uint32_t vertexBufferBinds;
+	uint32_t indexBufferBinds;
+	uint32_t skippedBinds;
+};
+
+class DrawQueue {
+public:
+	static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint16_t depth);
+	static uint16_t quantiseDepth(float viewDepth, float nearPlane, float farPlane, bool backToFront = false);
+
+	void clear();
+	void push(const DrawCommand &draw);
+
+	/* radix sort the queued draws by key (stable) */
+	void sort();
+
+	/* record the queued draws in order, skipping redundant vkCmdBind* calls */
+	void record(VkCommandBuffer commandBuffer);
+
+	size_t size() const { return draws.size(); }
+	const DrawStats &getStats() const { return stats; }
+
+private:
+	struct SortEntry {
+		uint64_t key;
+		uint32_t index;
+	};
+
+	std::vector<DrawCommand> draws;
+	std::vector<SortEntry> order, scratch;
+
+	DrawStats stats = {};
+};
+
+#endif
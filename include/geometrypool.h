@@ -0,0 +1,72 @@
+#ifndef _GEOMETRYPOOL_H
+#define _GEOMETRYPOOL_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Room left in the geometry pool after the scene, in vertices and indices,
+ * for what is added to it later (the characters' indices, streamed meshes).
+ */
+const uint32_t GEOMETRY_POOL_VERTEX_HEADROOM = 1 << 16;
+const uint32_t GEOMETRY_POOL_INDEX_HEADROOM = 1 << 18;
+
+/**
+ * first-fit allocator of ranges of [0, capacity), counted in elements. Free
+ * ranges are kept sorted by offset and merged with their neighbours as they
+ * are returned
+ */
+class RangeAllocator {
+public:
+	void init(uint32_t capacity);
+
+	/* offset of count free elements; false if no free range is large enough */
+	bool allocate(uint32_t count, uint32_t &offset);
+	void free(uint32_t offset, uint32_t count);
+
+	uint32_t getCapacity() const { return capacity; }
+	uint32_t getUsed() const { return used; }
+
+private:
+	struct Range {
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	std::vector<Range> freeRanges;
+	uint32_t capacity = 0;
+	uint32_t used = 0;
+};
+
+/* where a mesh's geometry lives in the pool's buffers */
+struct GeometryAllocation {
+	uint32_t vertexOffset;		// in vertices
+	uint32_t vertexCount;
+	uint32_t firstIndex;		// in indices
+	uint32_t indexCount;
+};
+
+/**
+ * hands out the vertex and index ranges of static meshes from one vertex and
+ * one index buffer of fixed capacity, so every mesh is drawn with the same
+ * bindings and its draws differ only in firstIndex and vertexOffset. Only
+ * the bookkeeping is kept here; the buffers are created at the capacities
+ * given to init
+ */
+class GeometryPool {
+public:
+	void init(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+	/* both ranges or neither; false if either does not fit */
+	bool allocate(uint32_t vertexCount, uint32_t indexCount, GeometryAllocation &allocation);
+	void free(const GeometryAllocation &allocation);
+
+	const RangeAllocator &getVertices() const { return vertices; }
+	const RangeAllocator &getIndices() const { return indices; }
+
+private:
+	RangeAllocator vertices;
+	RangeAllocator indices;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef _JOBS_H
+#define _JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* jobs a worker's deque can hold before schedule runs new ones inline */
+const uint32_t JOB_DEQUE_CAPACITY = 4096;
+
+/*
+ * Counts the jobs scheduled against it that have not finished yet; a join
+ * point is a wait for it to reach zero.
+ */
+struct JobCounter {
+	std::atomic<uint32_t> pending{0};
+};
+
+typedef void (*JobFunction)(void *data, uint32_t begin, uint32_t end);
+
+/*
+ * A plain function over a range, so scheduling never allocates; data must
+ * stay alive until the job's counter is waited on.
+ */
+struct Job {
+	JobFunction function;
+	void *data;
+	uint32_t begin;
+	uint32_t end;
+	JobCounter *counter;
+};
+
+/**
+ * a fixed pool of workers, each with its own deque: a thread pushes and pops
+ * its own jobs at the back (newest first, still warm in cache) and idle
+ * threads steal from the front of the others'. The thread that calls init
+ * is thread 0; it and any thread that is not a worker share deque 0. Waiting
+ * on a counter runs jobs instead of blocking, so jobs may fork and join
+ * further jobs. Only one JobSystem may be running at a time
+ */
+class JobSystem {
+public:
+	~JobSystem();
+
+	/* starts workerCount workers; with pinWorkers, each only runs on its own core (Linux) */
+	void init(uint32_t workerCount, bool pinWorkers);
+
+	/* finishes the queued jobs and stops the workers */
+	void shutdown();
+
+	/* workers plus the thread that called init */
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(deques.size()); }
+
+	/* index of the calling thread's deque: 1 + worker index, or 0 */
+	static uint32_t getThreadIndex();
+
+	void schedule(const Job &job);
+
+	/* runs queued jobs until counter reaches zero */
+	void wait(JobCounter &counter);
+
+	/**
+	 * calls function(begin, end) over [0, count) in batches of batchSize,
+	 * on every thread including the caller, and returns once all are done
+	 */
+	template<typename Function>
+	void parallelFor(uint32_t count, uint32_t batchSize, const Function &function) {
+
+		JobCounter counter;
+
+		Job job = {};
+		job.function = [](void *data, uint32_t begin, uint32_t end) { (*static_cast<const Function *>(data))(begin, end); };
+		job.data     = const_cast<Function *>(&function);
+		job.counter  = &counter;
+
+		for (uint32_t begin = 0; begin < count; begin += batchSize) {
+			job.begin = begin;
+			job.end   = count - begin > batchSize ? begin + batchSize : count;
+			schedule(job);
+		}
+
+		wait(counter);
+	}
+
+private:
+	struct Deque {
+		std::mutex mutex;
+		Job jobs[JOB_DEQUE_CAPACITY];	// ring of [front, back)
+		uint32_t front = 0;
+		uint32_t back = 0;
+	};
+
+	bool pop(uint32_t thread, Job &job);
+	bool steal(uint32_t thread, Job &job);
+	bool runOne(uint32_t thread);
+	void work(uint32_t thread);
+
+	std::vector<std::unique_ptr<Deque>> deques;	// one per thread
+	std::vector<std::thread> workers;
+
+	// idle workers sleep until a job is queued
+	std::atomic<uint32_t> queuedJobs{0};
+	std::atomic<uint32_t> sleepingWorkers{0};
+	std::mutex sleepMutex;
+	std::condition_variable jobQueued;
+	bool running = false;
+};
+
+#endif
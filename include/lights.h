@@ -0,0 +1,73 @@
+#ifndef _LIGHTS_H
+#define _LIGHTS_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+ * Clustered forward lighting. The view frustum is cut into a grid of
+ * clusters, screen-space tiles in x and y and exponentially spaced depth
+ * slices in z. light_cull.comp bins every light into the clusters its range
+ * touches, and the fragment shader only shades with the lights of the cluster
+ * the fragment falls in.
+ *
+ *   params        ClusterParams
+ *   lights        Light[lightCount]
+ *   clusterCounts uint[CLUSTER_COUNT]                           lights in each cluster
+ *   clusterLights uint[CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER]  their indices
+ *
+ * Clusters are indexed x + y * CLUSTER_GRID_X + z * CLUSTER_GRID_X * CLUSTER_GRID_Y.
+ * A cluster keeps at most MAX_LIGHTS_PER_CLUSTER lights, the rest are dropped.
+ *
+ * The structures below must match the declarations in the shaders.
+ */
+const uint32_t CLUSTER_GRID_X = 16;
+const uint32_t CLUSTER_GRID_Y = 9;
+const uint32_t CLUSTER_GRID_Z = 24;
+const uint32_t CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+const uint32_t MAX_LIGHTS_PER_CLUSTER = 256;
+
+const uint32_t LIGHT_CULL_GROUP_SIZE = 128;	// local_size_x of light_cull.comp
+
+/* storage buffers, in binding order of light_cull.comp */
+enum LightBuffer {
+	LIGHT_BUFFER_PARAMS,
+	LIGHT_BUFFER_LIGHTS,
+	LIGHT_BUFFER_CLUSTER_COUNTS,
+	LIGHT_BUFFER_CLUSTER_LIGHTS,
+	LIGHT_BUFFER_COUNT
+};
+
+/*
+ * A spot light; a point light is one whose cone is wider than a sphere,
+ * cosInner = -1 and cosOuter = -2, so the same shading code handles both.
+ */
+struct Light {
+	glm::vec4 position;		// xyz world position, w range
+	glm::vec4 color;		// rgb colour times intensity, w cosine of the inner cone angle
+	glm::vec4 direction;	// xyz world direction, w cosine of the outer cone angle
+};
+
+struct ClusterParams {
+	glm::mat4 view;
+	glm::mat4 inverseProjection;
+	glm::vec4 screen;		// width, height, near plane, far plane
+	uint32_t lightCount;
+	uint32_t padding[3];
+};
+
+static_assert(sizeof(Light) == 48, "Light must match the shaders");
+static_assert(sizeof(ClusterParams) == 160, "ClusterParams must match the shaders");
+
+Light makePointLight(glm::vec3 position, float range, glm::vec3 color);
+Light makeSpotLight(glm::vec3 position, glm::vec3 direction, float range, float innerAngle, float outerAngle, glm::vec3 color);
+
+/**
+ * count lights of random colour scattered through the box [min, max], a
+ * quarter of them spot lights pointing down; the same seed gives the same
+ * lights
+ */
+std::vector<Light> scatterLights(uint32_t count, glm::vec3 min, glm::vec3 max, uint32_t seed);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef _LOD_H
+#define _LOD_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+
+const uint32_t MAX_MESH_LODS = 4;
+
+/* projected bounding-sphere diameter (pixels) below which LOD 0 is dropped */
+const float LOD_FULL_DETAIL_SIZE = 256.0f;
+
+/* fraction of the switch threshold a mesh must cross before its LOD changes */
+const float LOD_HYSTERESIS = 0.15f;
+
+struct MeshLod {
+	uint32_t firstIndex;	// into the shared index buffer
+	uint32_t indexCount;
+	float error;			// object-space simplification error
+};
+
+struct Mesh {
+	int32_t vertexOffset;	// into the shared vertex buffer
+	uint32_t vertexCount;
+
+	glm::vec3 center;
+	float radius;
+
+	uint32_t lodCount;
+	MeshLod lods[MAX_MESH_LODS];
+};
+
+/**
+ * quadric edge collapse simplification of an indexed triangle list. The
+ * vertex data is left untouched so every LOD can share it; returns the new
+ * index list and writes the largest collapse error (as a distance) to error
+ */
+std::vector<uint32_t> simplifyMesh(
+		const std::vector<Vertex> &vertices,
+		const std::vector<uint32_t> &indices,
+		size_t targetIndexCount,
+		float *error);
+
+/**
+ * appends a mesh and its generated LOD chain to the shared vertex and index
+ * arrays that back the scene's vertex and index buffers
+ */
+Mesh importMesh(
+		const std::vector<Vertex> &vertices,
+		const std::vector<uint32_t> &indices,
+		std::vector<Vertex> &sharedVertices,
+		std::vector<uint32_t> &sharedIndices);
+
+/**
+ * diameter in pixels of the mesh's bounding sphere seen from a perspective
+ * camera at the given distance
+ */
+float projectedSize(const Mesh &mesh, float distance, float fovY, float viewportHeight);
+
+/**
+ * picks the LOD for the given projected size, only moving away from the
+ * current LOD once the size is clearly past the switch threshold
+ */
+uint32_t selectLod(const Mesh &mesh, float projectedSize, uint32_t currentLod);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef _MEMORYBUDGET_H
+#define _MEMORYBUDGET_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/*
+ * What each device memory allocation is for. Transient memory is the
+ * per-swapchain attachments and scratch that are rebuilt on resize.
+ */
+enum MemoryCategory {
+	MEMORY_CATEGORY_BUFFER,
+	MEMORY_CATEGORY_IMAGE,
+	MEMORY_CATEGORY_STAGING,
+	MEMORY_CATEGORY_TRANSIENT,
+	MEMORY_CATEGORY_COUNT
+};
+
+const char *memoryCategoryName(MemoryCategory category);
+
+/*
+ * Heap usage starts to count as pressure at this fraction of the budget.
+ */
+const double MEMORY_PRESSURE_THRESHOLD = 0.9;
+
+/* usage of one heap, for the pressure callbacks */
+struct MemoryHeapStatus {
+	uint32_t heapIndex;
+	VkDeviceSize usage;		// what VK_EXT_memory_budget reports, else what is tracked
+	VkDeviceSize budget;	// what VK_EXT_memory_budget reports, else the heap size
+};
+
+/**
+ * accounts every device memory allocation by heap and category: allocated
+ * bytes (the allocation sizes) against used bytes (what the resources asked
+ * for, the rest is alignment and padding). With VK_EXT_memory_budget the
+ * driver's per-heap usage and budget are tracked too, which include other
+ * processes and the driver's own allocations
+ */
+class MemoryBudget {
+public:
+	using PressureCallback = std::function<void(const MemoryHeapStatus &status)>;
+
+	void init(const VkPhysicalDeviceMemoryProperties &memoryProperties);
+
+	void allocated(VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize allocatedBytes, VkDeviceSize usedBytes, MemoryCategory category);
+	void freed(VkDeviceMemory memory);
+
+	/* the latest VK_EXT_memory_budget figures, one per heap */
+	void setDriverBudget(const VkDeviceSize *heapBudget, const VkDeviceSize *heapUsage);
+
+	/**
+	 * called once when a heap crosses MEMORY_PRESSURE_THRESHOLD of its budget,
+	 * and again only after it has dropped back below; systems that can evict
+	 * (textures, meshes) should free what they can
+	 */
+	void addPressureCallback(PressureCallback callback);
+
+	MemoryHeapStatus getHeapStatus(uint32_t heapIndex) const;
+	uint32_t getHeapCount() const { return static_cast<uint32_t>(heaps.size()); }
+
+	void writeReport(FILE *file) const;
+	void writeJson(FILE *file) const;
+
+private:
+	struct Allocation {
+		uint32_t heapIndex;
+		MemoryCategory category;
+		VkDeviceSize allocatedBytes;
+		VkDeviceSize usedBytes;
+	};
+
+	struct Heap {
+		VkDeviceSize size;
+		bool deviceLocal;
+		VkDeviceSize allocatedBytes[MEMORY_CATEGORY_COUNT];
+		VkDeviceSize usedBytes[MEMORY_CATEGORY_COUNT];
+		uint32_t allocationCount;
+
+		// from VK_EXT_memory_budget, 0 until reported
+		VkDeviceSize driverBudget;
+		VkDeviceSize driverUsage;
+
+		bool underPressure;
+	};
+
+	void checkPressure(uint32_t heapIndex);
+
+	std::vector<uint32_t> typeHeaps;	// heap index of each memory type
+	std::vector<Heap> heaps;
+	std::unordered_map<VkDeviceMemory, Allocation> allocations;
+	std::vector<PressureCallback> pressureCallbacks;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef _OCCLUSION_H
+#define _OCCLUSION_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/*
+ * Hierarchical-Z occlusion culling. hiz.comp reduces the depth buffer of the
+ * previous frame into a pyramid: level 0 is a copy of the depth buffer and
+ * every texel of a higher level holds the farthest depth of the texels under
+ * it (the last row and column of an odd-sized level also cover the one that
+ * halving drops). occlusion_cull.comp then projects each object's bounding
+ * sphere with that frame's camera, picks the level where the sphere covers at
+ * most 2x2 texels, and writes the object's indirect draw with an instance
+ * count of 0 if the sphere lies behind all of them.
+ *
+ *   params   OcclusionParams
+ *   objects  CullObject[objectCount]
+ *   draws    VkDrawIndexedIndirectCommand[objectCount]
+ *
+ * Objects that come into view are drawn one frame late.
+ *
+ * The structures below must match the declarations in the shaders.
+ */
+const uint32_t HIZ_GROUP_SIZE = 8;					// local_size_x and _y of hiz.comp
+const uint32_t HIZ_MAX_LEVELS = 16;
+const uint32_t OCCLUSION_CULL_GROUP_SIZE = 64;		// local_size_x of occlusion_cull.comp
+
+/* storage buffers, in binding order of occlusion_cull.comp */
+enum OcclusionBuffer {
+	OCCLUSION_BUFFER_PARAMS,
+	OCCLUSION_BUFFER_OBJECTS,
+	OCCLUSION_BUFFER_DRAWS,
+	OCCLUSION_BUFFER_COUNT
+};
+
+/* an object to cull and the indexed draw to write for it if visible */
+struct CullObject {
+	glm::vec4 sphere;		// xyz world centre, w radius
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
+struct OcclusionParams {
+	glm::mat4 viewProjection;	// of the frame the pyramid is built from
+	uint32_t objectCount;
+	uint32_t padding[3];
+};
+
+/* push constants of hiz.comp, one dispatch per level */
+struct HiZParams {
+	glm::ivec2 srcSize;		// the level below, or the depth buffer
+	glm::ivec2 dstSize;
+	uint32_t level;
+};
+
+static_assert(sizeof(CullObject) == 32, "CullObject must match the shaders");
+static_assert(sizeof(OcclusionParams) == 80, "OcclusionParams must match the shaders");
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _PACING_H
+#define _PACING_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+enum LatencyMode {
+	LATENCY_MODE_LOW_LATENCY,	// newest frame wins, CPU work starts just in time
+	LATENCY_MODE_THROUGHPUT		// vsync'd, frames queue up to keep the GPU busy
+};
+
+/*
+ * What a latency mode turns into for a given surface: the present mode, how
+ * many swapchain images to ask for and how many frames the CPU may have in
+ * flight before it waits on the GPU
+ */
+struct PresentPolicy {
+	VkPresentModeKHR presentMode;
+	uint32_t imageCount;
+	uint32_t framesInFlight;
+};
+
+bool parseLatencyMode(const char *name, LatencyMode &mode);
+const char *latencyModeName(LatencyMode mode);
+const char *presentModeName(VkPresentModeKHR presentMode);
+
+PresentPolicy selectPresentPolicy(
+		LatencyMode mode,
+		const std::vector<VkPresentModeKHR> &availablePresentModes,
+		const VkSurfaceCapabilitiesKHR &surfaceCapabilities
+		);
+
+/**
+ * decides when the CPU starts building a frame. In low-latency mode the start
+ * is delayed so that the frame is submitted just as the GPU runs out of work,
+ * using smoothed CPU and GPU frame times, and frames are never started faster
+ * than the display refreshes. In throughput mode it never sleeps and the
+ * frames-in-flight fences alone bound how far the CPU runs ahead
+ */
+class FramePacer {
+public:
+	void init(LatencyMode mode);
+
+	/* seconds between vblanks, 0 if unknown */
+	void setRefreshInterval(double seconds);
+
+	/* blocks until the CPU should start the next frame */
+	void waitForFrameStart();
+
+	/* the CPU has finished and submitted the frame */
+	void frameSubmitted();
+
+	/* measured GPU execution time of a completed frame */
+	void gpuFrameCompleted(double seconds);
+
+	double getCpuFrameTime() const { return cpuFrameTime; }
+	double getGpuFrameTime() const { return gpuFrameTime; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	LatencyMode mode = LATENCY_MODE_THROUGHPUT;
+	double refreshInterval = 0.0;
+
+	// exponentially smoothed, in seconds
+	double cpuFrameTime = 0.0;
+	double gpuFrameTime = 0.0;
+
+	Clock::time_point frameStart;
+	Clock::time_point gpuIdle;		// predicted time the GPU finishes submitted work
+	bool started = false;
+};
+
+#endif
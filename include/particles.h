@@ -0,0 +1,77 @@
+#ifndef _PARTICLES_H
+#define _PARTICLES_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/*
+ * GPU particle system. All particle state lives in storage buffers as
+ * structure-of-arrays streams and is only ever touched by the particle_*
+ * shaders; the CPU just decides how many particles to emit each frame.
+ *
+ *   positions   vec4[max]     xyz position, w age in seconds
+ *   velocities  vec4[max]     xyz velocity, w lifetime in seconds
+ *   deadList    uint[max]     indices of free particles, deadCount of them
+ *   aliveLists  uint[2 * max] two halves, one current and one being compacted into
+ *   counters    ParticleCounters
+ *
+ * Each frame: emit pops indices off the dead list and appends them to the
+ * current alive list, simulate integrates every alive particle, compact
+ * appends survivors to the other alive list and pushes the dead back onto the
+ * dead list, and finish swaps the lists. The survivor count doubles as the
+ * instance count of an indirect draw of camera-facing quads.
+ *
+ * The structures below must match the declarations in the shaders.
+ */
+const uint32_t PARTICLE_GROUP_SIZE = 256;	// local_size_x of the particle compute shaders
+
+/* storage buffers, in binding order of the particle compute shaders */
+enum ParticleBuffer {
+	PARTICLE_BUFFER_POSITIONS,
+	PARTICLE_BUFFER_VELOCITIES,
+	PARTICLE_BUFFER_DEAD_LIST,
+	PARTICLE_BUFFER_ALIVE_LISTS,
+	PARTICLE_BUFFER_COUNTERS,
+	PARTICLE_BUFFER_COUNT
+};
+
+const float PARTICLE_MIN_LIFETIME = 2.0f;
+const float PARTICLE_MAX_LIFETIME = 6.0f;
+const float PARTICLE_SIZE = 0.01f;
+
+struct ParticleCounters {
+	// VkDrawIndirectCommand for the survivors of the last compaction
+	uint32_t vertexCount;		// 4, one quad as a triangle strip
+	uint32_t instanceCount;
+	uint32_t firstVertex;
+	uint32_t firstInstance;
+
+	int32_t deadCount;			// signed, emit briefly takes it below zero when the pool runs dry
+	uint32_t aliveCount;		// entries in the current alive list
+	uint32_t current;			// which half of aliveLists is current
+	uint32_t padding;
+};
+
+/* push constants of the particle compute shaders */
+struct ParticleSimulationParams {
+	glm::vec4 emitter;			// xyz position, w radius
+	glm::vec4 gravity;			// xyz acceleration, w time step
+	uint32_t emitCount;
+	uint32_t seed;
+	uint32_t maxParticles;
+	float padding;
+};
+
+/* push constants of the particle vertex shader */
+struct ParticleDrawParams {
+	glm::mat4 viewProjection;
+	glm::vec4 cameraRight;		// w is the particle size
+	glm::vec4 cameraUp;
+	uint32_t maxParticles;
+};
+
+static_assert(sizeof(ParticleCounters) == 32, "ParticleCounters must match the shaders");
+static_assert(sizeof(ParticleSimulationParams) == 48, "ParticleSimulationParams must match the shaders");
+static_assert(sizeof(ParticleDrawParams) <= 128, "ParticleDrawParams exceeds the guaranteed push constant size");
+
+#endif
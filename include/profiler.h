@@ -0,0 +1,108 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * CPU and GPU zone profiler. PROFILE_ZONE("name") times the rest of the
+ * enclosing scope. Each thread records its zones into its own ring of
+ * PROFILE_RING_SIZE events: only the owning thread writes a ring and it
+ * publishes its head with a release store, so recording never locks (a
+ * mutex is only taken once per thread, to register its ring). When a ring
+ * is full the oldest zones are overwritten.
+ *
+ * GPU zones are recorded with timestamps already converted to the CPU clock
+ * (see ProfilerGpuClock) into one more ring, written by the thread that reads
+ * the queries back.
+ *
+ * profilerWriteChromeTrace merges every ring into a Chrome trace event file,
+ * for chrome://tracing or ui.perfetto.dev.
+ *
+ * The macros only record when built with PROFILE defined (make PROFILE=1);
+ * otherwise they compile to nothing.
+ */
+const uint32_t PROFILE_RING_SIZE = 1 << 16;		// events per thread, a power of two
+const uint32_t PROFILE_NAME_SIZE = 32;
+
+struct ProfileEvent {
+	const char *name;	// must outlive the profiler, e.g. a string literal
+	uint64_t start;		// nanoseconds on the profiler clock
+	uint64_t end;
+};
+
+struct ProfileRing {
+	ProfileEvent events[PROFILE_RING_SIZE];
+	std::atomic<uint64_t> head;		// events ever written; the newest is at (head - 1) % size
+	uint32_t threadId;
+	char threadName[PROFILE_NAME_SIZE];
+};
+
+/* nanoseconds on a steady clock shared by all threads */
+uint64_t profilerNow();
+
+/* records a finished zone on the calling thread */
+void profilerRecord(const char *name, uint64_t start, uint64_t end);
+
+/* records a GPU zone whose timestamps are on the profiler clock */
+void profilerRecordGpu(const char *name, uint64_t start, uint64_t end);
+
+/* names the calling thread's track in the trace */
+void profilerSetThreadName(const char *name);
+
+/**
+ * writes every zone still in the rings as Chrome trace JSON. Zones that a
+ * thread overwrites while the file is written may come out torn, so call it
+ * once the recording threads are idle
+ */
+bool profilerWriteChromeTrace(const char *path);
+
+/*
+ * Maps GPU timestamps onto the profiler clock. Every readback gives an upper
+ * bound on the offset between the clocks, since the GPU finished before the
+ * CPU saw the result; the smallest bound seen so far is kept.
+ */
+class ProfilerGpuClock {
+public:
+	void init(double nanosecondsPerTick) { this->nanosecondsPerTick = nanosecondsPerTick; calibrated = false; }
+
+	/* a timestamp the GPU wrote before the CPU read it back at cpuTime */
+	void observe(uint64_t gpuTicks, uint64_t cpuTime);
+
+	uint64_t toCpuTime(uint64_t gpuTicks) const;
+
+private:
+	double nanosecondsPerTick = 1.0;
+	int64_t offset = 0;		// CPU minus GPU nanoseconds
+	bool calibrated = false;
+};
+
+class ProfileZone {
+public:
+	explicit ProfileZone(const char *name) : name(name), start(profilerNow()) {}
+	~ProfileZone() { profilerRecord(name, start, profilerNow()); }
+
+	ProfileZone(const ProfileZone &) = delete;
+	ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+	const char *name;
+	uint64_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#if defined(PROFILE)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#define PROFILE_THREAD(name) profilerSetThreadName(name)
+#define PROFILE_GPU_ZONE(name, start, end) profilerRecordGpu(name, start, end)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(name)
+#define PROFILE_GPU_ZONE(name, start, end)
+#endif
+
+#endif
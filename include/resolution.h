@@ -0,0 +1,75 @@
+#ifndef _RESOLUTION_H
+#define _RESOLUTION_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/*
+ * Dynamic resolution. The main pass renders into the top-left corner of an
+ * offscreen colour target the size of the swapchain, at a scale of it the
+ * ResolutionController picks, and upscale.comp resamples that corner to the
+ * full size:
+ *
+ *   binding 0  output  rgba16f storage image, blitted to the swapchain image
+ *   binding 1  scene   the colour target, sampled bilinearly
+ *
+ * The structure below must match the declaration in the shader.
+ */
+const uint32_t UPSCALE_GROUP_SIZE = 8;		// local_size_x and _y of upscale.comp
+
+// smallest scale of each side, a quarter of the pixels
+const float RESOLUTION_MIN_SCALE = 0.5f;
+
+// the scale moves in steps of this, so noise in the frame time does not
+// re-record command buffers every frame
+const float RESOLUTION_SCALE_STEP = 0.05f;
+
+// sharpening applied at the smallest scale, none at full resolution
+const float UPSCALE_SHARPNESS = 0.25f;
+
+/* push constants of upscale.comp */
+struct UpscaleParams {
+	glm::ivec2 srcSize;		// rendered area of the scene target
+	glm::ivec2 dstSize;
+	float sharpness;
+};
+
+/**
+ * picks the render scale that holds the GPU frame time at a target. Each
+ * completed frame's time is split into the part that scales with the pixel
+ * count (the main pass) and the part that does not (shadows, the upscale);
+ * the first is normalised to full resolution and both are smoothed. The scale
+ * is the largest step whose predicted time fits the target with some headroom.
+ * It drops as soon as the prediction is over budget but only rises a step at a
+ * time, and holds for a few frames after each change
+ */
+class ResolutionController {
+public:
+	void init(double targetSeconds, float minScale = RESOLUTION_MIN_SCALE);
+
+	/* holds scale regardless of frame times */
+	void initFixed(float scale);
+
+	/* GPU times of a completed frame that was rendered at renderScale */
+	void gpuFrameCompleted(double fixedSeconds, double scaledSeconds, float renderScale);
+
+	float getScale() const { return scale; }
+
+private:
+	double target = 0.0;
+	float minScale = RESOLUTION_MIN_SCALE;
+	float scale = 1.0f;
+
+	// the scale is steps below full resolution, floored at minScale
+	uint32_t steps = 0;
+	uint32_t maxSteps = 0;
+
+	// exponentially smoothed, in seconds; scaledTime is at full resolution
+	double fixedTime = 0.0;
+	double scaledTime = 0.0;
+	bool started = false;
+
+	uint32_t framesSinceChange = 0;
+};
+
+#endif
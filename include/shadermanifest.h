@@ -0,0 +1,86 @@
+#ifndef _SHADERMANIFEST_H
+#define _SHADERMANIFEST_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * What each built shader expects of its pipeline, reflected from its SPIR-V
+ * by tools/reflect.cpp as part of the shader build. It goes two places:
+ * spirv/manifest.txt, which the runtime loads to find the shaders and check
+ * the layouts it builds,
+ * and generated/shaders.h, which holds the same layouts as constants for the
+ * engine's own constants to be checked against when it is compiled.
+ *
+ * The manifest has a line per shader, fields separated by spaces:
+ *
+ *   name stage localX localY localZ pushConstantBytes [binding:type]... [spec:id]...
+ *
+ * stage is vertex, fragment or compute, and type is uniform, storage (buffer),
+ * image (storage image) or sampler (combined image sampler). Only descriptor
+ * set 0 is used.
+ */
+const uint32_t SHADER_MAX_BINDINGS = 16;
+const uint32_t SHADER_MAX_SPEC_CONSTANTS = 8;
+
+enum ShaderStage : uint32_t {
+	SHADER_STAGE_VERTEX,
+	SHADER_STAGE_FRAGMENT,
+	SHADER_STAGE_COMPUTE,
+	SHADER_STAGE_COUNT
+};
+
+enum ShaderBindingType : uint32_t {
+	SHADER_BINDING_UNIFORM_BUFFER,
+	SHADER_BINDING_STORAGE_BUFFER,
+	SHADER_BINDING_STORAGE_IMAGE,
+	SHADER_BINDING_SAMPLED_IMAGE,
+	SHADER_BINDING_TYPE_COUNT
+};
+
+struct ShaderBinding {
+	uint32_t binding;
+	ShaderBindingType type;
+};
+
+struct ShaderLayout {
+	ShaderStage stage;
+	uint32_t localSize[3];			// 1, 1, 1 unless compute
+	uint32_t pushConstantSize;		// bytes of the push constant block, 0 without one
+
+	uint32_t bindingCount;
+	ShaderBinding bindings[SHADER_MAX_BINDINGS];	// in binding order
+
+	uint32_t specConstantCount;
+	uint32_t specConstantIds[SHADER_MAX_SPEC_CONSTANTS];
+};
+
+/* the binding of the layout with that number; nullptr if the shader has none */
+const ShaderBinding *findShaderBinding(const ShaderLayout &layout, uint32_t binding);
+
+bool hasSpecConstant(const ShaderLayout &layout, uint32_t id);
+
+class ShaderManifest {
+public:
+	/* false if the file cannot be read or has a malformed line */
+	bool load(const char *path);
+
+	/* by file name, without directory; nullptr if not listed */
+	const ShaderLayout *find(const std::string &name) const;
+
+	bool empty() const { return layouts.empty(); }
+
+	/* every listed shader, variants included, in no particular order */
+	std::vector<std::string> getNames() const;
+
+	static void writeLine(FILE *file, const std::string &name, const ShaderLayout &layout);
+	static bool parseLine(const std::string &line, std::string &name, ShaderLayout &layout);
+
+private:
+	std::unordered_map<std::string, ShaderLayout> layouts;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef _SHADINGRATE_H
+#define _SHADINGRATE_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/*
+ * Variable-rate shading through VK_KHR_fragment_shading_rate. Three rates are
+ * combined, the coarsest winning where the device allows it:
+ *
+ *   pipeline    particles are shaded at 2x2, everything else at 1x1
+ *   primitive   test_rate.vert shades triangles far from the camera at 2x2
+ *   attachment  shading_rate.comp writes a rate per tile of the main pass
+ *
+ * The attachment rate is built from the previous frame's scene target: tiles
+ * toward the edges of the screen are shaded at 2x2, and so is any tile whose
+ * colour barely changes across it; one that is flat along one axis only is
+ * shaded 2x1 or 1x2. shading_rate.comp reads
+ *
+ *   binding 0  rates  r8ui storage image, a texel per tile
+ *   binding 1  scene  the scene target, as the previous frame left it
+ *
+ * Rates are encoded as in the extension, log2 of the width shifted left by two
+ * or'ed with log2 of the height; only rates up to 2x2 are written, which every
+ * implementation supports.
+ *
+ * The structures below must match the declarations in the shader.
+ */
+const uint32_t SHADING_RATE_GROUP_SIZE = 8;		// local_size_x and _y of shading_rate.comp
+
+// pixels per rate texel, if the device allows it
+const uint32_t SHADING_RATE_TILE_SIZE = 16;
+
+// render scale without the extension: everything is shaded at reduced
+// resolution and upscaled instead
+const float SHADING_RATE_FALLBACK_SCALE = 0.75f;
+
+/* push constants of shading_rate.comp */
+struct ShadingRateParams {
+	glm::ivec2 rateSize;		// rate texels covering this frame's render area
+	glm::ivec2 tileSize;		// pixels per rate texel
+	glm::vec2 renderSize;		// this frame's render area
+	glm::vec2 previousSize;		// the area of the scene target the previous frame rendered
+};
+
+/* specialisation constants of shading_rate.comp, constant_id 0 and 1 */
+struct ShadingRateConstants {
+	float flatContrast;			// largest luminance step that still reads as flat
+	float periphery;			// fraction of the half-diagonal where the periphery starts
+};
+
+const ShadingRateConstants SHADING_RATE_CONSTANTS = { 0.02f, 0.8f };
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _SHADOWS_H
+#define _SHADOWS_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+/*
+ * Cascaded shadow maps for the sun. The camera frustum is split in depth into
+ * SHADOW_CASCADE_COUNT slices, each covered by its own orthographic light
+ * projection, and every cascade is one layer of a single depth array image.
+ * All layers are rendered in one multiview pass: each draw carries the mask
+ * of cascades it is visible in as its first instance, and shadow.vert clips
+ * it away in the others.
+ *
+ * ShadowParams must match the declarations in the shaders.
+ */
+const uint32_t SHADOW_CASCADE_COUNT = 4;
+const uint32_t SHADOW_MAP_SIZE = 2048;
+
+const float SHADOW_DISTANCE = 10.0f;		// view depth covered by the last cascade
+const float SHADOW_SPLIT_LAMBDA = 0.75f;	// 0 uniform splits, 1 logarithmic
+const float SHADOW_CASTER_MARGIN = 10.0f;	// how far behind a cascade casters are still caught
+
+struct ShadowParams {
+	glm::mat4 cascadeViewProjections[SHADOW_CASCADE_COUNT];	// world to cascade clip space
+	glm::mat4 viewToCascades[SHADOW_CASCADE_COUNT];			// camera view space to cascade clip space
+	glm::vec4 splitDepths;		// view depth at the far end of each cascade
+	glm::vec4 lightDirection;	// view space, pointing towards the light
+};
+
+static_assert(SHADOW_CASCADE_COUNT == 4, "splitDepths holds one depth per cascade");
+static_assert(sizeof(ShadowParams) == 544, "ShadowParams must match the shaders");
+
+/**
+ * fits a cascade around each depth slice of the camera frustum. Cascades are
+ * fitted to bounding spheres and snapped to whole shadow map texels, so they
+ * do not shimmer as the camera moves
+ */
+void computeShadowCascades(
+		const glm::mat4 &view,
+		float fovY,
+		float aspect,
+		float near,
+		glm::vec3 lightDirection,
+		ShadowParams &params);
+
+/**
+ * bit i is set if a bounding sphere may cast a shadow into cascade i
+ */
+uint32_t getCascadeMask(const ShadowParams &params, glm::vec3 center, float radius);
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef _SKELETON_H
+#define _SKELETON_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "vertex.h"
+
+/* joint indices are packed into 8 bits in VertexSkin */
+const uint32_t MAX_JOINTS = 256;
+
+const uint32_t SKINNING_GROUP_SIZE = 64;	// local_size_x of skin.comp
+
+/* push constants of skin.comp; one invocation per vertex (x) and instance (y) */
+struct SkinningParams {
+	uint32_t vertexCount;
+	uint32_t jointCount;
+	uint32_t instanceCount;
+};
+
+static_assert(sizeof(Vertex) == 32, "skin.comp reads and writes Vertex as eight floats");
+
+/*
+ * Local transform of one joint relative to its parent. Both members are one
+ * SIMD register wide so poses can be blended four floats at a time.
+ */
+struct alignas(16) JointPose {
+	glm::quat rotation;
+	glm::vec4 translation;	// w is a uniform scale
+};
+
+/*
+ * Keyframes sampled at a fixed rate, one pose per joint per frame:
+ * poses[frame * jointCount + joint]
+ */
+struct AnimationClip {
+	float frameRate;
+	uint32_t frameCount;
+	uint32_t jointCount;
+	std::vector<JointPose> poses;
+
+	float getDuration() const { return frameCount / frameRate; }
+};
+
+/*
+ * Joints are stored parents first, so model-space transforms can be built in
+ * a single pass.
+ */
+class Skeleton {
+public:
+	/* parent is -1 for a root; exits past MAX_JOINTS or if parent is not added yet */
+	uint32_t addJoint(int32_t parent, const glm::mat4 &inverseBindMatrix);
+	uint32_t getJointCount() const { return static_cast<uint32_t>(parents.size()); }
+
+	/**
+	 * samples clip at time (looping), blending the two nearest keyframes
+	 */
+	void samplePose(const AnimationClip &clip, float time, JointPose *pose) const;
+
+	/**
+	 * writes model-space joint matrices times the inverse bind matrices, ready
+	 * for the skinning pass, with root applied on top of every joint. Safe to
+	 * call from several threads at once
+	 */
+	void computeSkinningMatrices(const JointPose *pose, const glm::mat4 &root, glm::mat4 *skinningMatrices) const;
+
+private:
+	std::vector<int32_t> parents;
+	std::vector<glm::mat4> inverseBindMatrices;
+};
+
+/**
+ * out = a * (1 - t) + b * t, with rotations taking the shortest path and
+ * renormalised (nlerp)
+ */
+void blendPoses(const JointPose *a, const JointPose *b, float t, JointPose *out, uint32_t jointCount);
+
+/**
+ * builds a test character: a vertical tube around a chain of jointCount
+ * joints, each vertex weighted to its two nearest joints, and a looping clip
+ * that sways the chain
+ */
+void buildSkinnedColumn(
+		uint32_t jointCount,
+		std::vector<Vertex> &vertices,
+		std::vector<VertexSkin> &skins,
+		std::vector<uint32_t> &indices,
+		Skeleton &skeleton,
+		AnimationClip &clip);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef _STAGING_H
+#define _STAGING_H
+
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+/**
+ * ring allocator over a persistently mapped, host-visible staging buffer.
+ * Head and tail only ever increase; an allocation never straddles the end of
+ * the buffer, it skips to the start instead
+ */
+class StagingRing {
+public:
+	void init(VkBuffer buffer, void *mapped, VkDeviceSize capacity);
+
+	/* reserves space in the ring, returns nullptr if it is full */
+	void *allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+
+	/* copies data into the ring and records a copy into dstBuffer */
+	bool upload(VkCommandBuffer commandBuffer, const void *data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset);
+
+	/* everything allocated before head has been consumed by the GPU */
+	void retire(uint64_t head);
+	void reset();
+
+	uint64_t getHead() const { return head; }
+	VkBuffer getBuffer() const { return buffer; }
+	VkDeviceSize getCapacity() const { return capacity; }
+
+private:
+	VkBuffer buffer = VK_NULL_HANDLE;
+	uint8_t *mapped = nullptr;
+	VkDeviceSize capacity = 0;
+
+	uint64_t head = 0;
+	uint64_t tail = 0;
+};
+
+#endif
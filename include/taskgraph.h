@@ -0,0 +1,75 @@
+#ifndef _TASKGRAPH_H
+#define _TASKGRAPH_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <jobs.h>
+
+typedef uint32_t TaskId;
+
+enum TaskFlags {
+	TASK_ANY_THREAD  = 0,
+	TASK_MAIN_THREAD = 1 << 0,	// e.g. windowing calls that must stay on the main thread
+};
+
+/**
+ * runs a fixed set of tasks once, each as soon as the tasks it depends on
+ * have finished, as jobs on the job system's workers. Tasks are added in
+ * dependency order (a task may only depend on tasks added before it), and
+ * each one's start and finish are kept for the report
+ */
+class TaskGraph {
+public:
+	TaskId add(const char *name, std::function<void()> function, std::vector<TaskId> dependencies = {}, uint32_t flags = TASK_ANY_THREAD);
+
+	/*
+	 * runs the main-thread tasks on the calling thread, which must be the one
+	 * that initialised jobs, and the others on its workers; blocks until all
+	 * have finished
+	 */
+	void run(JobSystem &jobs);
+
+	/* when each task ran and on which thread, and the chain of tasks that bounded the total */
+	void writeReport(FILE *file) const;
+
+private:
+	struct Task {
+		const char *name;
+		std::function<void()> function;
+		std::vector<TaskId> dependencies;
+		std::vector<TaskId> dependents;
+		uint32_t flags;
+
+		uint32_t pendingCount;	// dependencies not yet finished
+		uint32_t thread;		// the job system's thread index, 0 is the thread that called run
+		double start;			// seconds since run was called
+		double end;
+	};
+
+	void schedule(TaskId id);
+	void execute(TaskId id);
+
+	std::vector<Task> tasks;
+
+	JobSystem *jobs = nullptr;
+	JobCounter scheduledTasks;
+
+	// the calling thread sleeps until a main-thread task is ready or all are done
+	std::mutex mutex;
+	std::condition_variable taskReady;
+	std::deque<TaskId> readyMainTasks;
+	uint32_t unfinishedCount = 0;
+
+	std::chrono::steady_clock::time_point runStart;
+	double runTime = 0.0;
+	uint32_t threadCount = 0;
+};
+
+#endif
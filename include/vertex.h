@@ -7,12 +7,13 @@
 
 class Vertex {
 public:
+	Vertex() = default;
 	Vertex(glm::vec2 position, glm::vec3 color, glm::vec2 texCoord);
+	Vertex(glm::vec3 position, glm::vec3 color, glm::vec2 texCoord);
 
 	static const uint32_t attributeCount = 3;
 
-	// TODO: change to vec3
-	glm::vec2 position;
+	glm::vec3 position;
 	glm::vec3 color;
 	glm::vec2 texCoord;
 
@@ -49,6 +50,32 @@ public:
 		return attributeDescriptions;
 	}
 
+	/* for depth-only pipelines, which fetch nothing but the position */
+	static VkVertexInputAttributeDescription getPositionAttributeDescription() {
+		VkVertexInputAttributeDescription attributeDescription = {};
+		attributeDescription.location = 0;
+		attributeDescription.binding  = 0;
+		attributeDescription.format   = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescription.offset   = offsetof(Vertex, position);
+
+		return attributeDescription;
+	}
+
 };
 
+/*
+ * Skinning stream, parallel to the bind-pose vertices of a skinned mesh. It
+ * is only read by the skinning compute pass, which writes plain Vertex data
+ * that every later pass draws like any other mesh.
+ */
+struct VertexSkin {
+	uint32_t joints;	// four 8-bit joint indices, first in the low byte
+	uint32_t weights;	// four 8-bit unorm weights summing to 255
+};
+
+/**
+ * packs up to four influences, renormalising the weights so they sum to one
+ */
+VertexSkin packVertexSkin(glm::uvec4 joints, glm::vec4 weights);
+
 #endif
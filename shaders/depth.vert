@@ -0,0 +1,18 @@
+#version 450
+
+// depth pre-pass; gl_Position must come out bit for bit as in test.vert, so
+// the opaque pass can test with EQUAL
+
+layout (location = 0) in vec3 inPosition;
+
+layout (binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+} ubo;
+
+invariant gl_Position;
+
+void main() {
+	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPosition, 1.0);
+}
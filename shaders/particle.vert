@@ -0,0 +1,53 @@
+#version 450
+
+// expands each alive particle into a camera-facing quad, drawn as a
+// four-vertex triangle strip per instance
+
+layout (std430, binding = 0) readonly buffer Positions {
+	vec4 positions[];
+};
+
+layout (std430, binding = 1) readonly buffer Velocities {
+	vec4 velocities[];
+};
+
+layout (std430, binding = 2) readonly buffer AliveLists {
+	uint aliveLists[];
+};
+
+layout (std430, binding = 3) readonly buffer Counters {
+	uint vertexCount;
+	uint instanceCount;
+	uint firstVertex;
+	uint firstInstance;
+	int deadCount;
+	uint aliveCount;
+	uint current;
+	uint padding;
+} counters;
+
+layout (push_constant) uniform Params {
+	mat4 viewProjection;
+	vec4 cameraRight;		// w is the particle size
+	vec4 cameraUp;
+	uint maxParticles;
+} params;
+
+layout (location = 0) out vec4 fragColor;
+layout (location = 1) out vec2 fragCorner;
+
+void main() {
+
+	uint index = aliveLists[counters.current * params.maxParticles + gl_InstanceIndex];
+
+	vec4 position = positions[index];
+	float life = position.w / velocities[index].w;
+
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+	vec3 world = position.xyz + (params.cameraRight.xyz * corner.x + params.cameraUp.xyz * corner.y) * params.cameraRight.w;
+
+	gl_Position = params.viewProjection * vec4(world, 1.0);
+
+	fragColor = vec4(mix(vec3(1.0, 0.9, 0.4), vec3(0.8, 0.2, 0.1), life), 1.0 - life);
+	fragCorner = corner;
+}
@@ -0,0 +1,38 @@
+// the particle pool and simulation parameters shared by the particle compute
+// passes; the bindings follow ParticleBuffer and Params follows
+// ParticleSimulationParams, both in particles.h
+
+layout (std430, binding = 0) buffer Positions {
+	vec4 positions[];		// xyz position, w age
+};
+
+layout (std430, binding = 1) buffer Velocities {
+	vec4 velocities[];		// xyz velocity, w lifetime
+};
+
+layout (std430, binding = 2) buffer DeadList {
+	uint deadList[];
+};
+
+layout (std430, binding = 3) buffer AliveLists {
+	uint aliveLists[];		// two halves of maxParticles entries
+};
+
+layout (std430, binding = 4) buffer Counters {
+	uint vertexCount;
+	uint instanceCount;		// survivors of compaction, drawn indirectly
+	uint firstVertex;
+	uint firstInstance;
+	int deadCount;
+	uint aliveCount;
+	uint current;
+	uint padding;
+} counters;
+
+layout (push_constant) uniform Params {
+	vec4 emitter;			// xyz position, w radius
+	vec4 gravity;			// xyz acceleration, w time step
+	uint emitCount;
+	uint seed;
+	uint maxParticles;
+} params;
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_EXT_multiview : enable
+
+// depth-only vertex shader of the shadow pass, run once per cascade by
+// multiview; gl_ViewIndex is the cascade
+
+layout (location = 0) in vec3 inPosition;
+
+layout (binding = 0) uniform ShadowParams {
+	mat4 cascadeViewProjections[4];
+	mat4 viewToCascades[4];
+	vec4 splitDepths;
+	vec4 lightDirection;
+} shadow;
+
+void main() {
+
+	// the draw's first instance is the mask of cascades it is visible in;
+	// outside them every vertex lands behind the near plane and is clipped
+	if ((gl_InstanceIndex & (1 << gl_ViewIndex)) == 0) {
+		gl_Position = vec4(0.0, 0.0, -1.0, 1.0);
+		return;
+	}
+
+	gl_Position = shadow.cascadeViewProjections[gl_ViewIndex] * vec4(inPosition, 1.0);
+}
@@ -1,10 +1,133 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// clustered forward shading: only the lights binned into this fragment's
+// cluster by light_cull.comp are evaluated, on top of a sun with cascaded
+// shadows
+
 layout (location = 0) in vec3 fragColor;
 
 layout (location = 0) out vec4 outColor;
 
+const uint CLUSTER_GRID_X = 16;
+const uint CLUSTER_GRID_Y = 9;
+const uint CLUSTER_GRID_Z = 24;
+const uint MAX_LIGHTS_PER_CLUSTER = 256;
+
+const vec3 AMBIENT = vec3(0.1);
+const vec3 SUN_COLOR = vec3(0.9, 0.85, 0.8);
+const uint SHADOW_CASCADE_COUNT = 4;
+const float SHADOW_BIAS = 0.0005;
+
+struct Light {
+	vec4 position;			// xyz world position, w range
+	vec4 color;				// rgb colour, w cosine of the inner cone angle
+	vec4 direction;			// xyz world direction, w cosine of the outer cone angle
+};
+
+layout (std430, binding = 1) readonly buffer ClusterParams {
+	mat4 view;
+	mat4 inverseProjection;
+	vec4 screen;			// width, height, near plane, far plane
+	uint lightCount;
+} params;
+
+layout (std430, binding = 2) readonly buffer Lights {
+	Light lights[];
+};
+
+layout (std430, binding = 3) readonly buffer ClusterCounts {
+	uint clusterCounts[];
+};
+
+layout (std430, binding = 4) readonly buffer ClusterLights {
+	uint clusterLights[];
+};
+
+layout (binding = 5) uniform ShadowParams {
+	mat4 cascadeViewProjections[SHADOW_CASCADE_COUNT];
+	mat4 viewToCascades[SHADOW_CASCADE_COUNT];
+	vec4 splitDepths;
+	vec4 lightDirection;	// view space, towards the light
+} shadow;
+
+layout (binding = 6) uniform sampler2DArrayShadow shadowMap;
+
+// the area rendered to, the top-left part of the target at reduced resolution
+layout (push_constant) uniform Viewport {
+	vec2 size;
+} viewport;
+
+// fraction of the sun reaching a view-space position, 3x3 PCF in its cascade
+float sunVisibility(vec3 viewPosition) {
+
+	uint cascade = 0;
+	while (cascade < SHADOW_CASCADE_COUNT && -viewPosition.z > shadow.splitDepths[cascade])
+		cascade++;
+
+	// beyond the shadow distance
+	if (cascade == SHADOW_CASCADE_COUNT)
+		return 1.0;
+
+	vec4 position = shadow.viewToCascades[cascade] * vec4(viewPosition, 1.0);
+	vec2 uv = position.xy * 0.5 + 0.5;
+	vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+
+	// explicit gradients, the cascade may differ between neighbouring fragments
+	float visibility = 0.0;
+	for (int y = -1; y <= 1; y++)
+		for (int x = -1; x <= 1; x++)
+			visibility += textureGrad(shadowMap, vec4(uv + vec2(x, y) * texelSize, cascade, position.z - SHADOW_BIAS), vec2(0.0), vec2(0.0));
+
+	return visibility / 9.0;
+}
+
 void main() {
-	outColor = vec4(fragColor, 1.0);
+
+	vec2 screenPosition = gl_FragCoord.xy / viewport.size;
+
+	vec4 viewPosition = params.inverseProjection * vec4(screenPosition * 2.0 - 1.0, gl_FragCoord.z, 1.0);
+	viewPosition /= viewPosition.w;
+
+	// the vertex format has no normals, use the facet normal
+	vec3 normal = normalize(cross(dFdy(viewPosition.xyz), dFdx(viewPosition.xyz)));
+
+	vec3 lighting = AMBIENT + SUN_COLOR * max(dot(normal, shadow.lightDirection.xyz), 0.0) * sunVisibility(viewPosition.xyz);
+
+	// the light lists are only built when there are lights
+	if (params.lightCount == 0) {
+		outColor = vec4(fragColor * lighting, 1.0);
+		return;
+	}
+
+	float near = params.screen.z;
+	float far = params.screen.w;
+
+	uvec3 cluster;
+	cluster.xy = min(uvec2(screenPosition * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y)), uvec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+	cluster.z = min(uint(max(log(-viewPosition.z / near) / log(far / near), 0.0) * CLUSTER_GRID_Z), CLUSTER_GRID_Z - 1);
+
+	uint clusterIndex = cluster.x + cluster.y * CLUSTER_GRID_X + cluster.z * CLUSTER_GRID_X * CLUSTER_GRID_Y;
+	uint count = clusterCounts[clusterIndex];
+
+	for (uint i = 0; i < count; i++) {
+
+		Light light = lights[clusterLights[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]];
+
+		vec3 toLight = (params.view * vec4(light.position.xyz, 1.0)).xyz - viewPosition.xyz;
+		float distance = length(toLight);
+
+		if (distance >= light.position.w)
+			continue;
+
+		vec3 l = toLight / distance;
+		vec3 spotDirection = (params.view * vec4(light.direction.xyz, 0.0)).xyz;
+
+		float falloff = 1.0 - distance / light.position.w;
+		float cone = smoothstep(light.direction.w, light.color.w, dot(-l, spotDirection));
+
+		lighting += light.color.rgb * max(dot(normal, l), 0.0) * falloff * falloff * cone;
+	}
+
+	outColor = vec4(fragColor * lighting, 1.0);
 }
@@ -1,10 +1,19 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout (location = 0) in vec2 inPosition;
+// built a second time as test_rate.vert (see variants.txt), also shading
+// triangles far from the camera at 2x2
+#ifdef PRIMITIVE_SHADING_RATE
+#extension GL_EXT_fragment_shading_rate : enable
+
+// view-space distance beyond which detail is too small to shade per pixel
+const float COARSE_DISTANCE = 8.0;
+#endif
+
+layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec3 inColor;
 
-1ayout (location = 0) out vec3 fragColor;
+layout (location = 0) out vec3 fragColor;
 
 layout (binding = 0) uniform UniformBufferObject {
 	mat4 model;
@@ -12,7 +21,19 @@ layout (binding = 0) uniform UniformBufferObject {
 	mat4 projection;
 } ubo;
 
+// matches the depth pre-pass in depth.vert
+invariant gl_Position;
+
 void main() {
 	fragColor = inColor;
-	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPosition, 1.0);
+
+#ifdef PRIMITIVE_SHADING_RATE
+	vec4 viewPosition = ubo.view * ubo.model * vec4(inPosition, 1.0);
+
+	// taken from the provoking vertex
+	gl_PrimitiveShadingRateEXT = -viewPosition.z > COARSE_DISTANCE
+		? gl_ShadingRateFlag2HorizontalPixelsEXT | gl_ShadingRateFlag2VerticalPixelsEXT
+		: 0;
+#endif
 }
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <arena.h>
+
+static size_t alignUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void LinearArena::init(size_t capacity) {
+
+	block.reset(new uint8_t[capacity]);
+	this->capacity = capacity;
+	used = 0;
+
+	overflowBlocks.clear();
+	overflowUsed = 0;
+	highWater = 0;
+	growCount = 0;
+}
+
+void *LinearArena::allocate(size_t size, size_t alignment) {
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(block.get());
+	size_t offset = alignUp(base + used, alignment) - base;
+
+	if (offset + size <= capacity) {
+		used = offset + size;
+		return block.get() + offset;
+	}
+
+	// out of room until the next reset; spill into a block of its own
+	overflowBlocks.emplace_back(new uint8_t[size + alignment]);
+	overflowUsed += size + alignment;
+
+	uintptr_t address = reinterpret_cast<uintptr_t>(overflowBlocks.back().get());
+	return reinterpret_cast<void *>(alignUp(address, alignment));
+}
+
+void LinearArena::reset() {
+
+	size_t cycleUsed = used + overflowUsed;
+	highWater = std::max(highWater, cycleUsed);
+
+	if (!overflowBlocks.empty()) {
+
+		overflowBlocks.clear();
+		overflowUsed = 0;
+
+		// half again over the high-water mark, so small variations fit
+		capacity = highWater + highWater / 2;
+		block.reset(new uint8_t[capacity]);
+		growCount++;
+	}
+
+	used = 0;
+}
+
+/*
+ * The global operator new is replaced to count allocations, so the frame
+ * allocation check (--bench-allocations) can tell whether steady-state frames
+ * touch the heap. Counting is one relaxed increment.
+ */
+static std::atomic<uint64_t> heapAllocationCount{0};
+
+uint64_t getHeapAllocationCount() {
+	return heapAllocationCount.load(std::memory_order_relaxed);
+}
+
+void *operator new(size_t size) {
+
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	if (void *memory = malloc(size ? size : 1))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	// aligned_alloc wants the size to be a multiple of the alignment
+	size_t align = static_cast<size_t>(alignment);
+
+	if (void *memory = aligned_alloc(align, alignUp(size ? size : 1, align)))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+	free(memory);
+}
+
+void operator delete(void *memory, size_t, std::align_val_t) noexcept {
+	free(memory);
+}
@@ -0,0 +1,247 @@
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <asset.h>
+
+AssetFile::~AssetFile() {
+	close();
+}
+
+bool AssetFile::open(const char *path) {
+
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+
+	if (fd < 0) {
+		fprintf(stderr, "Could not open asset %s\n", path);
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(AssetHeader))) {
+		fprintf(stderr, "Asset %s is truncated\n", path);
+		::close(fd);
+		return false;
+	}
+
+	void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (mapping == MAP_FAILED) {
+		fprintf(stderr, "Could not map asset %s\n", path);
+		return false;
+	}
+
+	// the whole file is about to be copied into staging front to back
+	madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+	madvise(mapping, st.st_size, MADV_WILLNEED);
+
+	data = static_cast<const uint8_t *>(mapping);
+	length = st.st_size;
+
+	const AssetHeader *header = reinterpret_cast<const AssetHeader *>(data);
+
+	if (header->magic != ASSET_MAGIC) {
+		fprintf(stderr, "%s is not a spock asset\n", path);
+		close();
+		return false;
+	}
+
+	if (header->version != ASSET_VERSION) {
+		fprintf(stderr, "Asset %s has version %u, expected %u (re-cook it)\n", path, header->version, ASSET_VERSION);
+		close();
+		return false;
+	}
+
+	sectionCount = header->sectionCount;
+	sections = reinterpret_cast<const AssetSection *>(data + sizeof(AssetHeader));
+
+	if (sizeof(AssetHeader) + sectionCount * sizeof(AssetSection) > length) {
+		fprintf(stderr, "Asset %s has a truncated section table\n", path);
+		close();
+		return false;
+	}
+
+	for (uint32_t i = 0; i < sectionCount; i++) {
+
+		const AssetSection &section = sections[i];
+
+		if (section.offset % ASSET_ALIGNMENT != 0 || section.offset > length || section.size > length - section.offset) {
+			fprintf(stderr, "Asset %s has a malformed section %u\n", path, i);
+			close();
+			return false;
+		}
+	}
+
+	if (!validate(path)) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+/* bytes per element of each table section; 0 for untyped payloads */
+static uint64_t getElementSize(uint32_t type) {
+
+	switch (type) {
+	case ASSET_SECTION_VERTICES:	return sizeof(Vertex);
+	case ASSET_SECTION_INDICES:		return sizeof(uint32_t);
+	case ASSET_SECTION_MESHES:		return sizeof(AssetMesh);
+	case ASSET_SECTION_TEXTURES:	return sizeof(AssetTexture);
+	default:						return 0;
+	}
+}
+
+bool AssetFile::validate(const char *path) const {
+
+	// counts are 32-bit and element sizes small, so the products cannot overflow
+	for (uint32_t i = 0; i < sectionCount; i++) {
+
+		uint64_t elementSize = getElementSize(sections[i].type);
+
+		if (static_cast<uint64_t>(sections[i].count) * elementSize > sections[i].size) {
+			fprintf(stderr, "Asset %s has more elements in section %u than fit in it\n", path, i);
+			return false;
+		}
+	}
+
+	uint32_t vertexCount, indexCount, meshCount, textureCount;
+	uint64_t textureDataSize;
+
+	getSection(ASSET_SECTION_VERTICES, nullptr, &vertexCount);
+	const uint32_t *indices = static_cast<const uint32_t *>(getSection(ASSET_SECTION_INDICES, nullptr, &indexCount));
+	const AssetMesh *assetMeshes = static_cast<const AssetMesh *>(getSection(ASSET_SECTION_MESHES, nullptr, &meshCount));
+	const AssetTexture *assetTextures = static_cast<const AssetTexture *>(getSection(ASSET_SECTION_TEXTURES, nullptr, &textureCount));
+	getSection(ASSET_SECTION_TEXTURE_DATA, &textureDataSize);
+
+	for (uint32_t i = 0; i < meshCount; i++) {
+
+		const AssetMesh &mesh = assetMeshes[i];
+
+		if (mesh.lodCount == 0 || mesh.lodCount > MAX_MESH_LODS || mesh.vertexOffset < 0 ||
+				static_cast<uint64_t>(mesh.vertexOffset) + mesh.vertexCount > vertexCount) {
+			fprintf(stderr, "Asset %s has a malformed mesh %u\n", path, i);
+			return false;
+		}
+
+		for (uint32_t l = 0; l < mesh.lodCount; l++) {
+
+			const AssetMeshLod &lod = mesh.lods[l];
+
+			if (static_cast<uint64_t>(lod.firstIndex) + lod.indexCount > indexCount) {
+				fprintf(stderr, "Asset %s has LOD %u of mesh %u outside the indices\n", path, l, i);
+				return false;
+			}
+
+			// indices are local to the mesh
+			for (uint32_t j = 0; j < lod.indexCount; j++) {
+				if (indices[lod.firstIndex + j] >= mesh.vertexCount) {
+					fprintf(stderr, "Asset %s has LOD %u of mesh %u indexing past its vertices\n", path, l, i);
+					return false;
+				}
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < textureCount; i++) {
+
+		const AssetTexture &texture = assetTextures[i];
+
+		VkFormat format = static_cast<VkFormat>(texture.format);
+
+		if (format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB) {
+			fprintf(stderr, "Asset %s has texture %u in unsupported format %u\n", path, i, texture.format);
+			return false;
+		}
+
+		// the payload must be exactly the one level, 4 bytes a texel
+		if (texture.width == 0 || texture.height == 0 || texture.mipLevels != 1 ||
+				texture.dataSize != static_cast<uint64_t>(texture.width) * texture.height * 4) {
+			fprintf(stderr, "Asset %s has texture %u with the wrong size\n", path, i);
+			return false;
+		}
+
+		if (texture.dataOffset > textureDataSize || texture.dataSize > textureDataSize - texture.dataOffset) {
+			fprintf(stderr, "Asset %s has texture %u outside the texture data\n", path, i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void AssetFile::close() {
+
+	if (data)
+		munmap(const_cast<uint8_t *>(data), length);
+
+	data = nullptr;
+	length = 0;
+	sections = nullptr;
+	sectionCount = 0;
+}
+
+const void *AssetFile::getSection(AssetSectionType type, uint64_t *size, uint32_t *count) const {
+
+	for (uint32_t i = 0; i < sectionCount; i++) {
+
+		if (sections[i].type != type)
+			continue;
+
+		if (size)
+			*size = sections[i].size;
+		if (count)
+			*count = sections[i].count;
+
+		return data + sections[i].offset;
+	}
+
+	if (size)
+		*size = 0;
+	if (count)
+		*count = 0;
+
+	return nullptr;
+}
+
+uint32_t AssetFile::getMeshCount() const {
+
+	uint32_t count;
+	getSection(ASSET_SECTION_MESHES, nullptr, &count);
+
+	return count;
+}
+
+Mesh AssetFile::getMesh(uint32_t index) const {
+
+	uint32_t count;
+	const AssetMesh *assetMeshes = static_cast<const AssetMesh *>(getSection(ASSET_SECTION_MESHES, nullptr, &count));
+
+	Mesh mesh = {};
+
+	if (index >= count)
+		return mesh;
+
+	const AssetMesh &assetMesh = assetMeshes[index];
+
+	mesh.vertexOffset = assetMesh.vertexOffset;
+	mesh.vertexCount  = assetMesh.vertexCount;
+	mesh.center       = glm::vec3(assetMesh.center[0], assetMesh.center[1], assetMesh.center[2]);
+	mesh.radius       = assetMesh.radius;
+	mesh.lodCount     = assetMesh.lodCount;
+
+	for (uint32_t i = 0; i < assetMesh.lodCount && i < MAX_MESH_LODS; i++) {
+		mesh.lods[i].firstIndex = assetMesh.lods[i].firstIndex;
+		mesh.lods[i].indexCount = assetMesh.lods[i].indexCount;
+		mesh.lods[i].error      = assetMesh.lods[i].error;
+	}
+
+	return mesh;
+}
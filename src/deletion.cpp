@@ -0,0 +1,26 @@
+#include <deletion.h>
+
+void DeletionQueue::push(uint64_t lastUse, std::function<void()> deleter) {
+	entries.push_back({ lastUse, std::move(deleter) });
+}
+
+void DeletionQueue::collect(uint64_t completed) {
+
+	while (!entries.empty() && entries.front().lastUse <= completed) {
+		std::function<void()> deleter = std::move(entries.front().deleter);
+		entries.pop_front();
+		deleter();
+	}
+
+}
+
+void DeletionQueue::flush() {
+
+	// deleters run oldest first, as they would have been collected
+	while (!entries.empty()) {
+		std::function<void()> deleter = std::move(entries.front().deleter);
+		entries.pop_front();
+		deleter();
+	}
+
+}
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cstring>
+
+#include <devicecaps.h>
+
+void DeviceCapabilities::init(VkInstance instance, VkPhysicalDevice device, uint32_t instanceApiVersion, bool properties2Supported,
+		bool externalMemoryCapabilities) {
+
+	physicalDevice = device;
+
+	vkGetPhysicalDeviceProperties(device, &properties);
+	vkGetPhysicalDeviceFeatures(device, &features);
+
+	features11 = {};
+	features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+	features12 = {};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features13 = {};
+	features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+	uint32_t apiVersion = std::min(instanceApiVersion, properties.apiVersion);
+
+	if (apiVersion >= VK_API_VERSION_1_2) {
+
+		auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+				vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2"));
+
+		if (getFeatures2) {
+			features11.pNext = &features12;
+			features12.pNext = apiVersion >= VK_API_VERSION_1_3 ? &features13 : nullptr;
+
+			VkPhysicalDeviceFeatures2 features2 = {};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features2.pNext = &features11;
+
+			getFeatures2(device, &features2);
+
+			features11.pNext = nullptr;
+			features12.pNext = nullptr;
+		}
+	}
+
+	uuidValid = false;
+
+	// the ID properties are core in 1.1; before that they come with the
+	// external memory capabilities extension
+	if (properties2Supported && (apiVersion >= VK_API_VERSION_1_1 || externalMemoryCapabilities)) {
+
+		auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+				vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+
+		if (getProperties2) {
+			VkPhysicalDeviceIDPropertiesKHR idProperties = {};
+			idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES_KHR;
+
+			VkPhysicalDeviceProperties2KHR properties2 = {};
+			properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+			properties2.pNext = &idProperties;
+
+			getProperties2(device, &properties2);
+
+			memcpy(deviceUUID, idProperties.deviceUUID, VK_UUID_SIZE);
+			uuidValid = true;
+		}
+	}
+
+	vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+
+	deviceLocalHeapSize = 0;
+
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			deviceLocalHeapSize = std::max(deviceLocalHeapSize, memoryProperties.memoryHeaps[i].size);
+	}
+
+	uint32_t queueFamilyCount;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+	queueFamilies.resize(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	extensions.resize(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+	fragmentShadingRateFeatures = {};
+	fragmentShadingRateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
+	fragmentShadingRateProperties = {};
+	fragmentShadingRateProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_PROPERTIES_KHR;
+
+	if (properties2Supported && extensionSupported(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME)) {
+
+		auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+				vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+		auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+				vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+
+		if (getFeatures2 && getProperties2) {
+			VkPhysicalDeviceFeatures2KHR features2 = {};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			features2.pNext = &fragmentShadingRateFeatures;
+
+			getFeatures2(device, &features2);
+
+			VkPhysicalDeviceProperties2KHR properties2 = {};
+			properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+			properties2.pNext = &fragmentShadingRateProperties;
+
+			getProperties2(device, &properties2);
+
+			fragmentShadingRateFeatures.pNext = nullptr;
+			fragmentShadingRateProperties.pNext = nullptr;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(formatMutex);
+	formatProperties.clear();
+}
+
+DeviceCapabilities &DeviceCapabilities::operator=(DeviceCapabilities &&other) {
+
+	physicalDevice = other.physicalDevice;
+
+	properties = other.properties;
+	features = other.features;
+	features11 = other.features11;
+	features12 = other.features12;
+	features13 = other.features13;
+
+	fragmentShadingRateFeatures = other.fragmentShadingRateFeatures;
+	fragmentShadingRateProperties = other.fragmentShadingRateProperties;
+
+	memoryProperties = other.memoryProperties;
+	deviceLocalHeapSize = other.deviceLocalHeapSize;
+
+	queueFamilies = std::move(other.queueFamilies);
+	extensions = std::move(other.extensions);
+
+	uuidValid = other.uuidValid;
+	memcpy(deviceUUID, other.deviceUUID, VK_UUID_SIZE);
+
+	formatProperties = std::move(other.formatProperties);
+
+	return *this;
+}
+
+bool DeviceCapabilities::extensionSupported(const char *name) const {
+
+	for (const VkExtensionProperties &extension : extensions) {
+		if (strcmp(name, extension.extensionName) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+int DeviceCapabilities::findQueueFamily(VkQueueFlags queueBits, VkQueueFlags excludedBits) const {
+
+	for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+
+		if (queueFamilies[i].queueCount > 0 && (flags & queueBits) == queueBits && !(flags & excludedBits))
+			return i;
+	}
+
+	return -1;
+}
+
+int DeviceCapabilities::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags desiredProperties) const {
+
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((typeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & desiredProperties) == desiredProperties)
+			return i;
+	}
+
+	return -1;
+}
+
+const VkFormatProperties &DeviceCapabilities::getFormatProperties(VkFormat format) const {
+
+	std::lock_guard<std::mutex> lock(formatMutex);
+
+	auto it = formatProperties.find(static_cast<uint32_t>(format));
+
+	if (it == formatProperties.end()) {
+		it = formatProperties.emplace(static_cast<uint32_t>(format), VkFormatProperties()).first;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &it->second);
+	}
+
+	// elements of an unordered_map stay put as others are added
+	return it->second;
+}
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstring>
+
+#include <drawqueue.h>
+
+static uint64_t field(uint64_t value, uint32_t bits) {
+	return value & ((1ull << bits) - 1);
+}
+
+uint64_t DrawQueue::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint16_t depth) {
+
+	uint64_t key = 0;
+
+	key = (key << DRAW_KEY_PASS_BITS)     | field(pass, DRAW_KEY_PASS_BITS);
+	key = (key << DRAW_KEY_PIPELINE_BITS) | field(pipeline, DRAW_KEY_PIPELINE_BITS);
+	key = (key << DRAW_KEY_MATERIAL_BITS) | field(material, DRAW_KEY_MATERIAL_BITS);
+	key = (key << DRAW_KEY_MESH_BITS)     | field(mesh, DRAW_KEY_MESH_BITS);
+	key = (key << DRAW_KEY_DEPTH_BITS)    | field(depth, DRAW_KEY_DEPTH_BITS);
+
+	return key;
+}
+
+/**
+ * maps a view-space depth in [near, far] onto the 16-bit depth field; opaque
+ * draws sort front-to-back, transparent draws want back-to-front
+ */
+uint16_t DrawQueue::quantiseDepth(float viewDepth, float nearPlane, float farPlane, bool backToFront) {
+
+	float t = (viewDepth - nearPlane) / (farPlane - nearPlane);
+	t = std::min(std::max(t, 0.0f), 1.0f);
+
+	if (backToFront)
+		t = 1.0f - t;
+
+	return static_cast<uint16_t>(t * 65535.0f);
+}
+
+void DrawQueue::clear() {
+	draws.clear();
+	order.clear();
+}
+
+void DrawQueue::push(const DrawCommand &draw) {
+	order.push_back({ draw.key, static_cast<uint32_t>(draws.size()) });
+	draws.push_back(draw);
+}
+
+/**
+ * LSD radix sort over the 8 bytes of the key. All histograms are built in one
+ * pass over the keys, and any byte that is identical across every key (e.g.
+ * the pass field when there is only one pass) is skipped entirely
+ */
+void DrawQueue::sort() {
+
+	const size_t n = order.size();
+
+	if (n < 2)
+		return;
+
+	uint32_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+
+	for (const SortEntry &entry : order) {
+		for (uint32_t byte = 0; byte < 8; byte++)
+			histograms[byte][(entry.key >> (byte * 8)) & 0xff]++;
+	}
+
+	scratch.resize(n);
+
+	SortEntry *src = order.data();
+	SortEntry *dst = scratch.data();
+
+	for (uint32_t byte = 0; byte < 8; byte++) {
+
+		uint32_t *histogram = histograms[byte];
+
+		// every key has the same value for this byte, nothing to do
+		if (histogram[(src[0].key >> (byte * 8)) & 0xff] == n)
+			continue;
+
+		uint32_t offsets[256];
+		uint32_t sum = 0;
+		for (uint32_t i = 0; i < 256; i++) {
+			offsets[i] = sum;
+			sum += histogram[i];
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			uint32_t bucket = (src[i].key >> (byte * 8)) & 0xff;
+			dst[offsets[bucket]++] = src[i];
+		}
+
+		std::swap(src, dst);
+	}
+
+	// odd number of passes leaves the result in the scratch buffer
+	if (src != order.data())
+		order.swap(scratch);
+}
+
+void DrawQueue::record(VkCommandBuffer commandBuffer) {
+
+	stats = {};
+
+	// bound state does not carry over between command buffers
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+	VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+
+	for (const SortEntry &entry : order) {
+
+		const DrawCommand &draw = draws[entry.index];
+
+		if (draw.pipeline != boundPipeline) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+			boundPipeline = draw.pipeline;
+
+			// a new pipeline may use an incompatible layout, so rebind the set
+			boundDescriptorSet = VK_NULL_HANDLE;
+			stats.pipelineBinds++;
+		} else {
+			stats.skippedBinds++;
+		}
+
+		if (draw.descriptorSet != VK_NULL_HANDLE) {
+			if (draw.descriptorSet != boundDescriptorSet) {
+				vkCmdBindDescriptorSets(
+						commandBuffer,
+						VK_PIPELINE_BIND_POINT_GRAPHICS,
+						draw.pipelineLayout,
+						0,
+						1,
+						&draw.descriptorSet,
+						0,
+						nullptr
+					);
+				boundDescriptorSet = draw.descriptorSet;
+				stats.descriptorSetBinds++;
+			} else {
+				stats.skippedBinds++;
+			}
+		}
+
+		if (draw.vertexBuffer != boundVertexBuffer) {
+			VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &draw.vertexBuffer, &offset);
+			boundVertexBuffer = draw.vertexBuffer;
+			stats.vertexBufferBinds++;
+		} else {
+			stats.skippedBinds++;
+		}
+
+		if (draw.indexBuffer != VK_NULL_HANDLE) {
+
+			if (draw.indexBuffer != boundIndexBuffer) {
+				vkCmdBindIndexBuffer(commandBuffer, draw.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+				boundIndexBuffer = draw.indexBuffer;
+				stats.indexBufferBinds++;
+			} else {
+				stats.skippedBinds++;
+			}
+
+			if (draw.indirectBuffer != VK_NULL_HANDLE)
+				vkCmdDrawIndexedIndirect(commandBuffer, draw.indirectBuffer, draw.indirectOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+			else
+				vkCmdDrawIndexed(commandBuffer, draw.count, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+
+		} else {
+
+			if (draw.indirectBuffer != VK_NULL_HANDLE)
+				vkCmdDrawIndirect(commandBuffer, draw.indirectBuffer, draw.indirectOffset, 1, sizeof(VkDrawIndirectCommand));
+			else
+				vkCmdDraw(commandBuffer, draw.count, draw.instanceCount, draw.firstIndex, draw.firstInstance);
+		}
+
+		stats.draws++;
+	}
+
+}
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <iterator>
+
+#include <geometrypool.h>
+
+void RangeAllocator::init(uint32_t capacity) {
+
+	this->capacity = capacity;
+	used = 0;
+
+	freeRanges.clear();
+
+	if (capacity > 0)
+		freeRanges.push_back({ 0, capacity });
+}
+
+bool RangeAllocator::allocate(uint32_t count, uint32_t &offset) {
+
+	if (count == 0) {
+		offset = 0;
+		return true;
+	}
+
+	for (size_t i = 0; i < freeRanges.size(); i++) {
+
+		Range &range = freeRanges[i];
+
+		if (range.count < count)
+			continue;
+
+		offset = range.offset;
+
+		range.offset += count;
+		range.count -= count;
+
+		if (range.count == 0)
+			freeRanges.erase(freeRanges.begin() + i);
+
+		used += count;
+		return true;
+	}
+
+	return false;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t count) {
+
+	if (count == 0)
+		return;
+
+	// first free range after the returned one
+	auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset,
+			[](const Range &range, uint32_t offset) { return range.offset < offset; });
+
+	bool joinsPrevious = next != freeRanges.begin() && std::prev(next)->offset + std::prev(next)->count == offset;
+	bool joinsNext = next != freeRanges.end() && offset + count == next->offset;
+
+	if (joinsPrevious && joinsNext) {
+		std::prev(next)->count += count + next->count;
+		freeRanges.erase(next);
+	} else if (joinsPrevious) {
+		std::prev(next)->count += count;
+	} else if (joinsNext) {
+		next->offset = offset;
+		next->count += count;
+	} else {
+		freeRanges.insert(next, { offset, count });
+	}
+
+	used -= count;
+}
+
+void GeometryPool::init(uint32_t vertexCapacity, uint32_t indexCapacity) {
+	vertices.init(vertexCapacity);
+	indices.init(indexCapacity);
+}
+
+bool GeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount, GeometryAllocation &allocation) {
+
+	allocation.vertexCount = vertexCount;
+	allocation.indexCount = indexCount;
+
+	if (!vertices.allocate(vertexCount, allocation.vertexOffset))
+		return false;
+
+	if (!indices.allocate(indexCount, allocation.firstIndex)) {
+		vertices.free(allocation.vertexOffset, vertexCount);
+		return false;
+	}
+
+	return true;
+}
+
+void GeometryPool::free(const GeometryAllocation &allocation) {
+	vertices.free(allocation.vertexOffset, allocation.vertexCount);
+	indices.free(allocation.firstIndex, allocation.indexCount);
+}
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <jobs.h>
+#include <profiler.h>
+
+static thread_local uint32_t threadIndex = 0;
+
+JobSystem::~JobSystem() {
+
+	// only reached with workers still running when the program exits without
+	// shutting down, e.g. on a fatal error, possibly from a worker itself
+	for (std::thread &worker : workers)
+		worker.detach();
+
+}
+
+void JobSystem::init(uint32_t workerCount, bool pinWorkers) {
+
+	threadIndex = 0;
+	running = true;
+
+	for (uint32_t i = 0; i <= workerCount; i++)
+		deques.push_back(std::make_unique<Deque>());
+
+	uint32_t coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (uint32_t i = 1; i <= workerCount; i++) {
+
+		workers.emplace_back(&JobSystem::work, this, i);
+
+#if defined(__linux__)
+		if (pinWorkers) {
+			// the thread that called init keeps core 0 to itself when there are enough
+			cpu_set_t cores;
+			CPU_ZERO(&cores);
+			CPU_SET(i % coreCount, &cores);
+
+			if (pthread_setaffinity_np(workers.back().native_handle(), sizeof(cores), &cores) != 0)
+				fprintf(stderr, "Could not pin job worker %u to core %u\n", i, i % coreCount);
+		}
+#else
+		(void) pinWorkers;
+		(void) coreCount;
+#endif
+	}
+
+}
+
+void JobSystem::shutdown() {
+
+	while (queuedJobs > 0)
+		runOne(threadIndex);
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+
+	jobQueued.notify_all();
+
+	for (std::thread &worker : workers)
+		worker.join();
+
+	workers.clear();
+	deques.clear();
+}
+
+uint32_t JobSystem::getThreadIndex() {
+	return threadIndex;
+}
+
+void JobSystem::schedule(const Job &job) {
+
+	job.counter->pending.fetch_add(1);
+
+	Deque &deque = *deques[threadIndex];
+	bool queued = false;
+
+	{
+		std::lock_guard<std::mutex> lock(deque.mutex);
+
+		if (deque.back - deque.front < JOB_DEQUE_CAPACITY) {
+			deque.jobs[deque.back++ % JOB_DEQUE_CAPACITY] = job;
+			queuedJobs++;
+			queued = true;
+		}
+	}
+
+	// full: nobody is keeping up, so there is nothing to lose by running it here
+	if (!queued) {
+		job.function(job.data, job.begin, job.end);
+		job.counter->pending.fetch_sub(1);
+		return;
+	}
+
+	// pairs with the worker raising sleepingWorkers before it checks queuedJobs,
+	// so either the worker sees the job or this sees the worker
+	if (sleepingWorkers > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		jobQueued.notify_one();
+	}
+
+}
+
+void JobSystem::wait(JobCounter &counter) {
+
+	uint32_t thread = threadIndex;
+
+	while (counter.pending > 0) {
+		if (!runOne(thread))
+			std::this_thread::yield();
+	}
+
+}
+
+bool JobSystem::pop(uint32_t thread, Job &job) {
+
+	Deque &deque = *deques[thread];
+	std::lock_guard<std::mutex> lock(deque.mutex);
+
+	if (deque.front == deque.back)
+		return false;
+
+	job = deque.jobs[--deque.back % JOB_DEQUE_CAPACITY];
+	queuedJobs--;
+
+	return true;
+}
+
+bool JobSystem::steal(uint32_t thread, Job &job) {
+
+	uint32_t threadCount = getThreadCount();
+
+	for (uint32_t i = 1; i < threadCount; i++) {
+
+		Deque &deque = *deques[(thread + i) % threadCount];
+		std::lock_guard<std::mutex> lock(deque.mutex);
+
+		if (deque.front == deque.back)
+			continue;
+
+		job = deque.jobs[deque.front++ % JOB_DEQUE_CAPACITY];
+		queuedJobs--;
+
+		return true;
+	}
+
+	return false;
+}
+
+bool JobSystem::runOne(uint32_t thread) {
+
+	Job job;
+
+	if (!pop(thread, job) && !steal(thread, job))
+		return false;
+
+	job.function(job.data, job.begin, job.end);
+	job.counter->pending.fetch_sub(1);
+
+	return true;
+}
+
+void JobSystem::work(uint32_t thread) {
+
+	threadIndex = thread;
+
+	char name[32];
+	snprintf(name, sizeof(name), "job worker %u", thread);
+	PROFILE_THREAD(name);
+
+	while (true) {
+
+		if (runOne(thread))
+			continue;
+
+		sleepingWorkers++;
+
+		{
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			jobQueued.wait(lock, [this] { return queuedJobs > 0 || !running; });
+
+			if (!running && queuedJobs == 0) {
+				sleepingWorkers--;
+				return;
+			}
+		}
+
+		sleepingWorkers--;
+	}
+
+}
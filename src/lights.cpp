@@ -0,0 +1,52 @@
+#include <cmath>
+#include <random>
+
+#include <lights.h>
+
+Light makePointLight(glm::vec3 position, float range, glm::vec3 color) {
+
+	Light light;
+	light.position  = glm::vec4(position, range);
+	light.color     = glm::vec4(color, -1.0f);
+	light.direction = glm::vec4(0.0f, -1.0f, 0.0f, -2.0f);
+
+	return light;
+}
+
+Light makeSpotLight(glm::vec3 position, glm::vec3 direction, float range, float innerAngle, float outerAngle, glm::vec3 color) {
+
+	Light light;
+	light.position  = glm::vec4(position, range);
+	light.color     = glm::vec4(color, std::cos(innerAngle));
+	light.direction = glm::vec4(glm::normalize(direction), std::cos(outerAngle));
+
+	return light;
+}
+
+std::vector<Light> scatterLights(uint32_t count, glm::vec3 min, glm::vec3 max, uint32_t seed) {
+
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<Light> lights;
+	lights.reserve(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		glm::vec3 position(
+				min.x + (max.x - min.x) * unit(generator),
+				min.y + (max.y - min.y) * unit(generator),
+				min.z + (max.z - min.z) * unit(generator)
+				);
+
+		float range = 0.2f + 0.3f * unit(generator);
+		glm::vec3 color(unit(generator), unit(generator), unit(generator));
+
+		if (i % 4 == 3)
+			lights.push_back(makeSpotLight(position, glm::vec3(0.0f, -1.0f, 0.0f), range, 0.3f, 0.5f, color));
+		else
+			lights.push_back(makePointLight(position, range, color));
+	}
+
+	return lights;
+}
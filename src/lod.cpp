@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iterator>
+#include <queue>
+
+#include <lod.h>
+
+/**
+ * symmetric 4x4 error quadric, stored as its upper triangle, plus the total
+ * area weight so that evaluated errors come out as mean squared distances
+ */
+struct Quadric {
+	double a00, a01, a02, a03;
+	double a11, a12, a13;
+	double a22, a23;
+	double a33;
+	double weight;
+};
+
+static Quadric planeQuadric(glm::vec3 normal, float d, float weight) {
+
+	double a = normal.x, b = normal.y, c = normal.z;
+
+	Quadric q;
+	q.a00 = weight * a * a; q.a01 = weight * a * b; q.a02 = weight * a * c; q.a03 = weight * a * d;
+	q.a11 = weight * b * b; q.a12 = weight * b * c; q.a13 = weight * b * d;
+	q.a22 = weight * c * c; q.a23 = weight * c * d;
+	q.a33 = weight * d * d;
+	q.weight = weight;
+
+	return q;
+}
+
+static void addQuadric(Quadric &q, const Quadric &r) {
+	q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02; q.a03 += r.a03;
+	q.a11 += r.a11; q.a12 += r.a12; q.a13 += r.a13;
+	q.a22 += r.a22; q.a23 += r.a23;
+	q.a33 += r.a33;
+	q.weight += r.weight;
+}
+
+static double evaluateQuadric(const Quadric &q, glm::vec3 p) {
+
+	double x = p.x, y = p.y, z = p.z;
+
+	double error =
+		q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x +
+		q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y +
+		q.a22 * z * z + 2.0 * q.a23 * z +
+		q.a33;
+
+	return q.weight > 0.0 ? std::fabs(error) / q.weight : 0.0;
+}
+
+struct Collapse {
+	double cost;
+	uint32_t from, to;
+	uint32_t fromVersion, toVersion;
+
+	bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+/*
+ * Half-edge collapse: a vertex is always collapsed onto one of its
+ * neighbours, never onto a new position, so the vertex buffer is shared by
+ * every LOD and only the index list changes. Border vertices (which includes
+ * either side of an attribute seam, since seams are unwelded) are never
+ * collapsed away, so silhouettes and UV seams stay intact.
+ */
+std::vector<uint32_t> simplifyMesh(
+		const std::vector<Vertex> &vertices,
+		const std::vector<uint32_t> &indices,
+		size_t targetIndexCount,
+		float *error) {
+
+	const size_t vertexCount = vertices.size();
+	const size_t triangleCount = indices.size() / 3;
+
+	std::vector<uint32_t> triangles(indices.begin(), indices.begin() + triangleCount * 3);
+	std::vector<bool> triangleAlive(triangleCount, true);
+	size_t aliveCount = triangleCount;
+
+	std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+	std::vector<Quadric> quadrics(vertexCount, Quadric {});
+
+	for (uint32_t t = 0; t < triangleCount; t++) {
+
+		glm::vec3 p0 = vertices[triangles[t * 3 + 0]].position;
+		glm::vec3 p1 = vertices[triangles[t * 3 + 1]].position;
+		glm::vec3 p2 = vertices[triangles[t * 3 + 2]].position;
+
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float area = glm::length(n);
+
+		if (area > 0.0f)
+			n = n / area;
+
+		Quadric q = planeQuadric(n, -glm::dot(n, p0), area);
+
+		for (uint32_t k = 0; k < 3; k++) {
+			addQuadric(quadrics[triangles[t * 3 + k]], q);
+			vertexTriangles[triangles[t * 3 + k]].push_back(t);
+		}
+	}
+
+	// an edge used by exactly one triangle lies on a border
+	std::vector<std::pair<uint32_t, uint32_t>> edges;
+	edges.reserve(triangleCount * 3);
+
+	for (uint32_t t = 0; t < triangleCount; t++) {
+		for (uint32_t k = 0; k < 3; k++) {
+			uint32_t a = triangles[t * 3 + k];
+			uint32_t b = triangles[t * 3 + (k + 1) % 3];
+			edges.push_back({ std::min(a, b), std::max(a, b) });
+		}
+	}
+
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<bool> border(vertexCount, false);
+
+	for (size_t i = 0; i < edges.size(); ) {
+		size_t j = i;
+		while (j < edges.size() && edges[j] == edges[i])
+			j++;
+
+		if (j - i == 1)
+			border[edges[i].first] = border[edges[i].second] = true;
+
+		i = j;
+	}
+
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+	std::vector<uint32_t> versions(vertexCount, 0);
+	std::vector<bool> removed(vertexCount, false);
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+	auto pushCollapse = [&](uint32_t from, uint32_t to) {
+
+		if (border[from])
+			return;
+
+		Quadric q = quadrics[from];
+		addQuadric(q, quadrics[to]);
+
+		heap.push({ evaluateQuadric(q, vertices[to].position), from, to, versions[from], versions[to] });
+	};
+
+	for (const std::pair<uint32_t, uint32_t> &edge : edges) {
+		pushCollapse(edge.first, edge.second);
+		pushCollapse(edge.second, edge.first);
+	}
+
+	auto neighbours = [&](uint32_t v) {
+
+		std::vector<uint32_t> result;
+
+		for (uint32_t t : vertexTriangles[v]) {
+			if (!triangleAlive[t])
+				continue;
+
+			for (uint32_t k = 0; k < 3; k++) {
+				if (triangles[t * 3 + k] != v)
+					result.push_back(triangles[t * 3 + k]);
+			}
+		}
+
+		std::sort(result.begin(), result.end());
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+
+		return result;
+	};
+
+	const size_t targetTriangleCount = targetIndexCount / 3;
+	double maxCost = 0.0;
+
+	while (aliveCount > targetTriangleCount && !heap.empty()) {
+
+		Collapse collapse = heap.top();
+		heap.pop();
+
+		uint32_t u = collapse.from, v = collapse.to;
+
+		// stale entry: an endpoint has moved on since this was queued
+		if (removed[u] || removed[v] || versions[u] != collapse.fromVersion || versions[v] != collapse.toVersion)
+			continue;
+
+		// link condition: u and v may only share the vertices opposite the
+		// edge, otherwise the collapse pinches the surface
+		std::vector<uint32_t> nu = neighbours(u), nv = neighbours(v), shared;
+		std::set_intersection(nu.begin(), nu.end(), nv.begin(), nv.end(), std::back_inserter(shared));
+
+		uint32_t edgeTriangles = 0;
+		for (uint32_t t : vertexTriangles[u]) {
+			if (triangleAlive[t] && (triangles[t * 3] == v || triangles[t * 3 + 1] == v || triangles[t * 3 + 2] == v))
+				edgeTriangles++;
+		}
+
+		if (shared.size() > edgeTriangles)
+			continue;
+
+		// reject collapses that flip, or fold into slivers, any of the
+		// surviving triangles (normal turns by more than ~75 degrees)
+		bool flips = false;
+
+		for (uint32_t t : vertexTriangles[u]) {
+
+			if (!triangleAlive[t])
+				continue;
+
+			uint32_t *tri = &triangles[t * 3];
+
+			if (tri[0] == v || tri[1] == v || tri[2] == v)
+				continue;
+
+			glm::vec3 before[3], after[3];
+			for (uint32_t k = 0; k < 3; k++) {
+				before[k] = vertices[tri[k]].position;
+				after[k] = tri[k] == u ? vertices[v].position : before[k];
+			}
+
+			glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+			if (glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1)) {
+				flips = true;
+				break;
+			}
+		}
+
+		if (flips)
+			continue;
+
+		// perform the collapse
+		for (uint32_t t : vertexTriangles[u]) {
+
+			if (!triangleAlive[t])
+				continue;
+
+			uint32_t *tri = &triangles[t * 3];
+
+			if (tri[0] == v || tri[1] == v || tri[2] == v) {
+				triangleAlive[t] = false;
+				aliveCount--;
+				continue;
+			}
+
+			for (uint32_t k = 0; k < 3; k++) {
+				if (tri[k] == u)
+					tri[k] = v;
+			}
+
+			vertexTriangles[v].push_back(t);
+		}
+
+		addQuadric(quadrics[v], quadrics[u]);
+		removed[u] = true;
+		versions[v]++;
+
+		maxCost = std::max(maxCost, collapse.cost);
+
+		for (uint32_t w : neighbours(v)) {
+			pushCollapse(v, w);
+			pushCollapse(w, v);
+		}
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(aliveCount * 3);
+
+	for (uint32_t t = 0; t < triangleCount; t++) {
+		if (triangleAlive[t])
+			result.insert(result.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+	}
+
+	if (error)
+		*error = static_cast<float>(std::sqrt(maxCost));
+
+	return result;
+}
+
+Mesh importMesh(
+		const std::vector<Vertex> &vertices,
+		const std::vector<uint32_t> &indices,
+		std::vector<Vertex> &sharedVertices,
+		std::vector<uint32_t> &sharedIndices) {
+
+	Mesh mesh = {};
+	mesh.vertexOffset = static_cast<int32_t>(sharedVertices.size());
+	mesh.vertexCount  = static_cast<uint32_t>(vertices.size());
+
+	// bounding sphere around the centre of the AABB
+	glm::vec3 lower(FLT_MAX), upper(-FLT_MAX);
+	for (const Vertex &vertex : vertices) {
+		lower = glm::min(lower, vertex.position);
+		upper = glm::max(upper, vertex.position);
+	}
+
+	mesh.center = (lower + upper) * 0.5f;
+	mesh.radius = 0.0f;
+	for (const Vertex &vertex : vertices)
+		mesh.radius = std::max(mesh.radius, glm::length(vertex.position - mesh.center));
+
+	sharedVertices.insert(sharedVertices.end(), vertices.begin(), vertices.end());
+
+	// LOD 0 is the source mesh; each further LOD aims for half the triangles
+	std::vector<uint32_t> lodIndices = indices;
+	float lodError = 0.0f;
+
+	while (mesh.lodCount < MAX_MESH_LODS) {
+
+		MeshLod &lod = mesh.lods[mesh.lodCount++];
+		lod.firstIndex = static_cast<uint32_t>(sharedIndices.size());
+		lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+		lod.error      = lodError;
+
+		sharedIndices.insert(sharedIndices.end(), lodIndices.begin(), lodIndices.end());
+
+		size_t target = (lodIndices.size() / 6) * 3;
+		if (target < 3)
+			break;
+
+		std::vector<uint32_t> simplified = simplifyMesh(vertices, indices, target, &lodError);
+
+		// stop once the simplifier can no longer make meaningful progress
+		if (simplified.empty() || simplified.size() * 10 > lodIndices.size() * 9)
+			break;
+
+		lodIndices.swap(simplified);
+	}
+
+	return mesh;
+}
+
+float projectedSize(const Mesh &mesh, float distance, float fovY, float viewportHeight) {
+
+	if (distance <= mesh.radius)
+		return FLT_MAX;
+
+	return mesh.radius * viewportHeight / (distance * std::tan(fovY * 0.5f));
+}
+
+static uint32_t lodForSize(const Mesh &mesh, float size) {
+
+	uint32_t lod = 0;
+	float threshold = LOD_FULL_DETAIL_SIZE;
+
+	while (lod + 1 < mesh.lodCount && size < threshold) {
+		lod++;
+		threshold *= 0.5f;
+	}
+
+	return lod;
+}
+
+uint32_t selectLod(const Mesh &mesh, float projectedSize, uint32_t currentLod) {
+
+	// finest and coarsest LODs that are acceptable within the hysteresis band
+	uint32_t finest = lodForSize(mesh, projectedSize * (1.0f + LOD_HYSTERESIS));
+	uint32_t coarsest = lodForSize(mesh, projectedSize * (1.0f - LOD_HYSTERESIS));
+
+	if (currentLod < finest)
+		return finest;
+
+	if (currentLod > coarsest)
+		return coarsest;
+
+	return currentLod;
+}
@@ -1,6 +1,17 @@
 #include <algorithm>
+#include <cstddef>
+#include <chrono>
 #include <cstdio>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #if !defined(USE_NULLWS)
@@ -9,11 +20,73 @@
 #endif
 
 #include <vulkan/vulkan.hpp>
-
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "arena.h"
+#include "asset.h"
+#include "deletion.h"
+#include "devicecaps.h"
+#include "drawqueue.h"
+#include "geometrypool.h"
+#include "jobs.h"
+#include "lights.h"
+#include "lod.h"
+#include "memorybudget.h"
+#include "occlusion.h"
+#include "pacing.h"
+#include "particles.h"
+#include "profiler.h"
+#include "resolution.h"
+#include "shadermanifest.h"
+#include "shadingrate.h"
+#include "shadows.h"
+#include "skeleton.h"
+#include "staging.h"
+#include "taskgraph.h"
 #include "vertex.h"
 
 bool validationEnabled = true;
 
+/* command-line options */
+const char *assetPath = nullptr;
+const char *gpuOverride = nullptr;	// --gpu or SPOCK_GPU: index, UUID or name
+const char *presentOverride = nullptr;	// --present or SPOCK_PRESENT: low-latency or throughput
+uint32_t benchReduceCount = 0;			// --bench-reduce: run the reduction benchmark and exit
+uint32_t particleCount = 0;				// --particles: size of the particle pool, 0 disables it
+uint32_t characterCount = 0;			// --characters: number of skinned test characters
+uint32_t lightCount = 0;				// --lights: number of scattered point and spot lights
+bool depthPrepass = false;				// --depth-prepass: lay down depth first, shade only visible fragments
+bool occlusionCulling = false;			// --occlusion-cull: cull against the previous frame's depth pyramid
+bool dynamicRenderingRequested = false;	// --dynamic-rendering: use the Vulkan 1.3 path if the device has it
+float dynamicResolutionTarget = 0.0f;	// --dynamic-resolution: GPU frame time in ms to hold by lowering the render resolution, 0 for off
+bool variableRateShading = false;		// --variable-rate-shading: shade coarsely where it goes unnoticed
+const char *tracePath = nullptr;		// --trace: write a Chrome trace of the run here on exit (PROFILE builds)
+uint32_t memoryReportInterval = 0;		// --memory-report: seconds between memory reports on stderr, 0 for none
+const char *memoryJsonPath = nullptr;	// --memory-json: rewrite this file with each memory report, as JSON
+bool startupReport = false;				// --startup-report: print what each startup task cost and the time to the first frame
+bool pinWorkers = false;				// --pin-workers: keep each job worker on its own core
+uint32_t benchJobsCount = 0;			// --bench-jobs: run the job system benchmark and exit
+uint32_t benchAllocationFrames = 0;		// --bench-allocations: count heap allocations over this many steady frames and exit
+const char *capturePath = nullptr;		// --capture: write the last counted frame here as a PPM, rendered at a fixed time step
+
+uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+bool physicalDeviceProperties2Supported = false;
+bool externalMemoryCapabilitiesSupported = false;	// device UUIDs can be read on a 1.0 instance
+bool multiviewSupported = false;
+bool memoryBudgetSupported = false;
+bool headlessSurfaceSupported = false;	// NullWS presents to VK_EXT_headless_surface if the instance has it, else to a display
+
+/*
+ * Vulkan 1.3 path: the main pass is begun with vkCmdBeginRendering, so there
+ * is no render pass or framebuffers to rebuild on resize, and barriers go
+ * through vkCmdPipelineBarrier2 with its finer stages and accesses. Without
+ * it everything falls back to 1.0 render passes and barriers.
+ */
+bool dynamicRenderingEnabled = false;
+PFN_vkCmdBeginRendering cmdBeginRendering = nullptr;
+PFN_vkCmdEndRendering cmdEndRendering = nullptr;
+PFN_vkCmdPipelineBarrier2 cmdPipelineBarrier2 = nullptr;
+
 /* global variables (to be put as class members) */
 #if !defined(USE_NULLWS)
 GLFWwindow *window;
@@ -21,34 +94,366 @@ GLFWwindow *window;
 
 VkInstance instance;
 VkPhysicalDevice physicalDevice;
+DeviceCapabilities deviceCapabilities;	// of physicalDevice, kept from selecting it
 VkSurfaceKHR surface;
 VkDevice logicalDevice;
-VkQueue graphicsQueue, presentQueue;
-uint32_t graphicsFamilyIndex, presentFamilyIndex, transferFamilyIndex;
+VkQueue graphicsQueue, presentQueue, computeQueue, transferQueue;
+uint32_t graphicsFamilyIndex, presentFamilyIndex, computeFamilyIndex, transferFamilyIndex;
 
 VkSwapchainKHR swapchain;
 VkExtent2D swapchainExtent;
 VkSurfaceFormatKHR swapchainFormat;
 VkPresentModeKHR swapchainPresentMode;
+std::vector<VkImage> swapchainImages;
 std::vector<VkImageView> swapchainImageViews;
-std::vector<VkFramebuffer> swapchainFramebuffers;
+std::vector<VkFramebuffer> swapchainFramebuffers;	// empty with dynamic rendering
+std::vector<VkSemaphore> renderFinishedSemaphores;	// one per swapchain image
 
-VkRenderPass renderpass;
+VkRenderPass renderpass = VK_NULL_HANDLE;	// VK_NULL_HANDLE with dynamic rendering
 
 VkDescriptorSetLayout descriptorSetLayout;
+VkDescriptorPool descriptorPool;
+std::vector<VkDescriptorSet> descriptorSets;
+
+VkBuffer uniformBuffer;
+VkDeviceMemory uniformBufferMemory;
+
+/*
+ * Static geometry, see geometrypool.h. Every mesh's vertices and LOD indices
+ * sit in sub-ranges of one vertex and one index buffer, and so do the
+ * characters' indices; their skinned vertices are rewritten each frame and
+ * keep a buffer of their own.
+ */
+struct StaticGeometry {
+	GeometryPool pool;
+	VkBuffer vertexBuffer;
+	VkDeviceMemory vertexBufferMemory;
+	VkBuffer indexBuffer;
+	VkDeviceMemory indexBufferMemory;
+};
+
+StaticGeometry geometry = {};
 
-VkBuffer vertexBuffer;
-VkDeviceMemory vertexBufferMemory;
+const VkDeviceSize STAGING_RING_SIZE = 16 * 1024 * 1024;
 
-VkBuffer indexBuffer;
-VkDeviceMemory indexBufferMemory;
+VkBuffer stagingBuffer;
+VkDeviceMemory stagingBufferMemory;
+StagingRing stagingRing;
+
+struct Texture {
+	VkImage image;
+	VkDeviceMemory memory;
+	VkImageView view;
+};
+
+std::vector<Texture> textures;
 
 VkPipelineLayout pipelineLayout;
 VkPipeline graphicsPipeline;
+VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;
+
+/*
+ * A compute pipeline and the descriptor set layout it was built with.
+ * Bindings 0 .. storageBufferCount - 1 are storage buffers, the storage
+ * images follow them, then the combined image samplers. Sets come from a
+ * pool owned by the pipeline.
+ */
+struct ComputePipeline {
+	VkPipeline pipeline;
+	VkPipelineLayout layout;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	uint32_t storageBufferCount;
+	uint32_t storageImageCount;
+	uint32_t sampledImageCount;
+	uint32_t pushConstantSize;
+};
+
+/* GPU particle state and the pipelines that update and draw it, see particles.h */
+struct ParticleSystem {
+	uint32_t maxParticles;		// 0 if the particle system is disabled
+	float emitRate;				// particles per second
+	float emitAccumulator;		// fractional particles carried over to the next frame
+	uint32_t seed;
+	glm::vec4 emitter;
+	glm::vec4 gravity;
+
+	std::array<VkBuffer, PARTICLE_BUFFER_COUNT> buffers;
+	std::array<VkDeviceMemory, PARTICLE_BUFFER_COUNT> memory;
+
+	// emit, simulate, compact, finish
+	std::array<ComputePipeline, 4> computePipelines;
+	std::array<VkDescriptorSet, 4> computeDescriptorSets;
+
+	VkDescriptorSetLayout drawDescriptorSetLayout;
+	VkDescriptorPool drawDescriptorPool;
+	VkDescriptorSet drawDescriptorSet;
+	VkPipelineLayout drawPipelineLayout;
+	VkPipeline drawPipeline;
+	ParticleDrawParams drawParams;
+};
+
+ParticleSystem particles = {};
+
+/*
+ * Instances of one skinned mesh. Poses are evaluated on the CPU, then
+ * skin.comp skins every instance once per frame into skinnedBuffer, which
+ * every pass binds as an ordinary vertex buffer at vertexCount * instance.
+ */
+struct SkinnedCharacters {
+	uint32_t count;				// 0 if there are no characters
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	float time;
+
+	Skeleton skeleton;
+	AnimationClip clip;
+	std::vector<glm::vec3> positions;
+
+	VkBuffer bindPoseBuffer;
+	VkDeviceMemory bindPoseBufferMemory;
+	VkBuffer skinBuffer;
+	VkDeviceMemory skinBufferMemory;
+	uint32_t firstIndex;		// of the shared index list, in the geometry pool
+	VkBuffer skinnedBuffer;
+	VkDeviceMemory skinnedBufferMemory;
+
+	// persistently mapped, one slot of count * jointCount matrices per frame in flight
+	VkBuffer jointBuffer;
+	VkDeviceMemory jointBufferMemory;
+	uint8_t *jointMatrices;
+	VkDeviceSize jointSlotSize;
+
+	ComputePipeline skinningPipeline;
+	std::vector<VkDescriptorSet> descriptorSets;	// one per joint slot
+};
+
+SkinnedCharacters characters = {};
+
+/* lights and the cluster grid they are binned into, see lights.h */
+struct LightGrid {
+	uint32_t lightCount;
+
+	std::array<VkBuffer, LIGHT_BUFFER_COUNT> buffers;
+	std::array<VkDeviceMemory, LIGHT_BUFFER_COUNT> memory;
+	ClusterParams *params;		// persistently mapped
+
+	ComputePipeline cullPipeline;
+	VkDescriptorSet cullDescriptorSet;
+};
+
+LightGrid lightGrid = {};
+
+/* the sun's cascaded shadow map, see shadows.h */
+struct ShadowMap {
+	bool enabled;				// false without multiview: the map stays cleared and nothing is shadowed
+	VkFormat format;
+
+	VkImage image;				// one layer per cascade
+	VkDeviceMemory memory;
+	VkImageView view;
+	VkSampler sampler;
+
+	VkRenderPass renderpass;
+	VkFramebuffer framebuffer;
+
+	ShadowParams cascades;		// CPU copy, for culling
+	VkBuffer paramsBuffer;
+	VkDeviceMemory paramsBufferMemory;
+	ShadowParams *params;		// persistently mapped
+
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSet;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+};
+
+ShadowMap shadows = {};
+
+/*
+ * Objects drawn by the main pass, the hierarchical-Z pyramid of the previous
+ * frame's depth buffer and the pass culling the objects against it, see
+ * occlusion.h. The pyramid follows the swapchain extent.
+ */
+struct OcclusionCuller {
+	uint32_t objectCount;		// meshes, then characters
+
+	std::array<VkBuffer, OCCLUSION_BUFFER_COUNT> buffers;
+	std::array<VkDeviceMemory, OCCLUSION_BUFFER_COUNT> memory;
+	OcclusionParams *params;	// persistently mapped
+	CullObject *objects;		// persistently mapped
+
+	VkImage pyramid;
+	VkDeviceMemory pyramidMemory;
+	VkImageView pyramidView;				// every level, sampled by the cull pass
+	std::vector<VkImageView> levelViews;	// one per level, written by the reduction
+	uint32_t levelCount;
+	VkSampler sampler;			// nearest, for the depth buffer and the pyramid
+
+	ComputePipeline reducePipeline;
+	std::vector<VkDescriptorSet> reduceDescriptorSets;	// one per level
+	ComputePipeline cullPipeline;
+	VkDescriptorSet cullDescriptorSet;
+};
+
+OcclusionCuller occlusion = {};
+
+/*
+ * Dynamic resolution, see resolution.h. The scene target and the upscaled
+ * image follow the swapchain extent; each image's command buffer is
+ * re-recorded when the scale it was recorded at goes out of date.
+ */
+struct DynamicResolution {
+	bool enabled;
+	ResolutionController controller;
+	std::vector<float> imageScales;		// scale each swapchain image's command buffer renders at
+
+	VkImage sceneColor;					// swapchain format, so the main pipelines render to it unchanged
+	VkDeviceMemory sceneColorMemory;
+	VkImageView sceneColorView;
+	VkImage upscaled;					// full size, stays in VK_IMAGE_LAYOUT_GENERAL
+	VkDeviceMemory upscaledMemory;
+	VkImageView upscaledView;
+	VkSampler sampler;					// bilinear, clamped
+
+	ComputePipeline upscalePipeline;
+	VkDescriptorSet descriptorSet;
+};
+
+DynamicResolution resolution = {};
+
+/*
+ * Variable-rate shading, see shadingrate.h. The rate image covers the
+ * swapchain extent and is rewritten by each frame's work ahead of the main
+ * pass; it is only bound on the 1.3 path.
+ */
+struct VariableRateShading {
+	bool enabled;				// VK_KHR_fragment_shading_rate is on, so pipeline rates at least
+	bool primitiveRate;			// the main pipeline uses test_rate.vert
+	bool attachmentRate;		// the main pass reads the rate image
+	VkFragmentShadingRateCombinerOpKHR combinerOp;	// MAX where supported, else REPLACE
+
+	VkExtent2D texelSize;		// pixels per rate texel
+	VkImage image;				// VK_FORMAT_R8_UINT, stays in VK_IMAGE_LAYOUT_GENERAL
+	VkDeviceMemory memory;
+	VkImageView view;
+	float previousScale;		// render scale the scene target was last rendered at
+
+	ComputePipeline ratePipeline;
+	VkDescriptorSet descriptorSet;
+};
+
+VariableRateShading shadingRate = {};
 
 VkCommandPool commandPool;
+VkCommandPool computeCommandPool;
+VkCommandPool transferCommandPool;
 std::vector<VkCommandBuffer> commandBuffers;
 
+/* synchronisation for each frame the CPU may have in flight */
+struct FrameSync {
+	VkSemaphore imageAvailable;
+	VkFence inFlight;
+	VkCommandBuffer commandBuffer;		// per-frame work recorded fresh each frame
+	uint32_t imageIndex;
+	bool timestampsWritten;
+	uint64_t frameNumber;				// of the last frame submitted with it, 0 if none
+	float renderScale;					// of the image it last rendered
+	std::vector<LinearArena> arenas;	// one per job-system thread, reset once inFlight has signalled
+};
+
+std::vector<FrameSync> frames;
+std::vector<VkFence> imagesInFlight;	// fence of the frame last rendering to each image
+uint32_t currentFrame = 0;
+
+// initial size of each frame arena; one that runs out grows at its next reset
+const size_t FRAME_ARENA_SIZE = 64 * 1024;
+
+// --bench-allocations counts from this many cycles of the frame slots on, once
+// the arenas have grown to the working set
+const uint64_t ALLOCATION_WARMUP_CYCLES = 4;
+uint64_t warmupAllocationCount = 0;
+uint64_t steadyFrameAllocations = 0;
+
+// CPU time of each counted frame, reserved up front so recording it does not
+// allocate
+std::vector<double> steadyFrameTimes;
+std::chrono::steady_clock::time_point lastCountedFrame;
+
+// --capture advances the simulation by this much per frame, not by the time
+// that passed, so the captured frame is the same on every run
+const float CAPTURE_TIME_STEP = 1.0f / 60.0f;
+
+/*
+ * For --capture: the frame that ends the --bench-allocations count is copied
+ * out of its swapchain image, at the end of its own submission, and written
+ * as a binary PPM once the device is idle.
+ */
+struct FrameCapture {
+	uint64_t frameNumber;		// 0 if not capturing
+	VkCommandBuffer commandBuffer;
+	VkBuffer buffer;			// tightly packed texels of the swapchain image, host visible
+	VkDeviceMemory memory;
+	VkExtent2D extent;			// of the image when it was copied
+	bool copied;
+};
+
+FrameCapture capture;
+
+// frames are numbered from 1 as they are submitted; released objects wait in
+// the deletion queue until the frames that may use them have completed
+uint64_t submittedFrames = 0;
+uint64_t completedFrames = 0;
+DeletionQueue deletionQueue;
+std::chrono::steady_clock::time_point lastFrameTime;
+bool framebufferResized = false;
+
+LatencyMode latencyMode = LATENCY_MODE_LOW_LATENCY;
+PresentPolicy presentPolicy;
+FramePacer framePacer;
+
+// start of each image's command buffer, end of its shadow pass, end of its
+// main pass and its end
+const uint32_t TIMESTAMPS_PER_IMAGE = 4;
+
+VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+double timestampPeriod;		// seconds per timestamp tick
+ProfilerGpuClock gpuClock;
+
+// driver budgets are queried this often (seconds), and on every report
+const double MEMORY_BUDGET_INTERVAL = 0.5;
+
+MemoryBudget memoryBudget;
+PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+std::chrono::steady_clock::time_point lastMemoryBudgetUpdate;
+std::chrono::steady_clock::time_point lastMemoryReport;
+
+DrawQueue drawQueue;
+DrawQueue shadowDrawQueue;
+
+JobSystem jobs;
+
+// startup runs as a task graph; shaders are read and the scene decoded while
+// the device and swapchain are being created
+std::chrono::steady_clock::time_point startupTime;
+std::unordered_map<std::string, std::string> spirvBinaries;	// by path, filled before any pipeline is created
+ShaderManifest shaderManifest;		// layouts reflected from spirv/ by the shader build
+AssetFile sceneAsset;
+
+/* every mesh's vertices and LOD index lists, packed for the shared buffers */
+std::vector<Vertex> sceneVertices;
+std::vector<uint32_t> sceneIndices;
+std::vector<Mesh> meshes;
+std::vector<uint32_t> meshLods;
+
+glm::vec3 cameraPosition = { 0.0f, 0.0f, 2.0f };
+float cameraFovY = glm::radians(45.0f);
+float cameraNear = 0.1f;
+float cameraFar = 100.0f;
+
+glm::vec3 sunDirection = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+
 VkImage depthBuffer;
 VkDeviceMemory depthBufferMemory;
 VkImageView depthBufferView;
@@ -68,6 +473,10 @@ void keyboard(GLFWwindow *window, int k, int scancode, int action, int mods) {
 		break;
 	}
 }
+
+void framebufferResize(GLFWwindow *window, int width, int height) {
+	framebufferResized = true;
+}
 #endif
 
 const std::vector<Vertex> vertices = {
@@ -76,6 +485,10 @@ const std::vector<Vertex> vertices = {
     { Vertex({-0.5f,  0.5f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}) }
 };
 
+const std::vector<uint32_t> indices = {
+	0, 1, 2
+};
+
 /**
  * prints supported instance layers
  */
@@ -210,9 +623,21 @@ std::vector<const char *> initInstanceExtensions() {
 	std::vector<const char *> instanceExtensions;
 
 #if defined(USE_NULLWS)
+	uint32_t headlessExtensionCount;
+	vkEnumerateInstanceExtensionProperties(nullptr, &headlessExtensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> headlessExtensions(headlessExtensionCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &headlessExtensionCount, headlessExtensions.data());
+
+	// software drivers such as lavapipe have no displays, only headless surfaces
+	for (VkExtensionProperties properties : headlessExtensions) {
+		if (strcmp(properties.extensionName, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME) == 0)
+			headlessSurfaceSupported = true;
+	}
+
 	instanceExtensions = {
 		VK_KHR_SURFACE_EXTENSION_NAME,
-		VK_KHR_DISPLAY_EXTENSION_NAME
+		headlessSurfaceSupported ? VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME : VK_KHR_DISPLAY_EXTENSION_NAME
 	};
 #else
 	uint32_t glfwExtensionCount;
@@ -222,6 +647,27 @@ std::vector<const char *> initInstanceExtensions() {
 		instanceExtensions.push_back(glfwExtensions[i]);
 #endif
 
+	// both needed to read device UUIDs on a 1.0 instance
+	uint32_t supportedExtensionCount;
+	vkEnumerateInstanceExtensionProperties(nullptr, &supportedExtensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> supportedExtensions(supportedExtensionCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &supportedExtensionCount, supportedExtensions.data());
+
+	for (VkExtensionProperties properties : supportedExtensions) {
+		if (strcmp(properties.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+			instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+			physicalDeviceProperties2Supported = true;
+		}
+	}
+
+	for (VkExtensionProperties properties : supportedExtensions) {
+		if (physicalDeviceProperties2Supported && strcmp(properties.extensionName, VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME) == 0) {
+			instanceExtensions.push_back(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME);
+			externalMemoryCapabilitiesSupported = true;
+		}
+	}
+
 	return instanceExtensions;
 }
 
@@ -247,11 +693,29 @@ GLFWwindow *createWindow(int width, int height, const char *title) {
 	window = glfwCreateWindow(width, height, title, nullptr, nullptr);
 
 	glfwSetKeyCallback(window, keyboard);
+	glfwSetFramebufferSizeCallback(window, framebufferResize);
 
 	return window;
 }
 #endif
 
+/**
+ * the highest instance version the loader supports; 1.0 loaders do not have
+ * vkEnumerateInstanceVersion at all
+ */
+uint32_t getLoaderApiVersion() {
+
+	auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+			vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+
+	uint32_t version = VK_API_VERSION_1_0;
+
+	if (enumerateInstanceVersion && enumerateInstanceVersion(&version) != VK_SUCCESS)
+		version = VK_API_VERSION_1_0;
+
+	return version;
+}
+
 VkInstance createInstance(
 		const char *name,
 		std::vector<const char *> instanceLayers,
@@ -265,7 +729,7 @@ VkInstance createInstance(
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName        = "spock";
 	appInfo.engineVersion      = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion         = VK_API_VERSION_1_0;
+	appInfo.apiVersion         = instanceApiVersion;
 
 	VkInstanceCreateInfo instanceCI = {};
 	instanceCI.sType                   = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -300,17 +764,28 @@ std::vector<VkPhysicalDevice> queryPhysicalDevices() {
 	return physicalDevices;
 }
 
-// TODO : other way to select physical device?
-VkPhysicalDevice selectPhysicalDevice(std::vector<VkPhysicalDevice> devices) {
-	return devices[0];
-}
-
 VkSurfaceKHR createSurface() {
 
 	VkSurfaceKHR surface;
 
 #if defined(USE_NULLWS)
 
+	if (headlessSurfaceSupported) {
+
+		auto createHeadlessSurface = reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>(
+				vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT"));
+
+		VkHeadlessSurfaceCreateInfoEXT headlessSurfaceCI = {};
+		headlessSurfaceCI.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+		if (!createHeadlessSurface || createHeadlessSurface(instance, &headlessSurfaceCI, nullptr, &surface) != VK_SUCCESS) {
+			fputs("Could not create headless surface\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+
+		return surface;
+	}
+
 	uint32_t propertiesCount;
 	vkGetPhysicalDeviceDisplayPropertiesKHR(physicalDevice, &propertiesCount, nullptr);
 
@@ -351,14 +826,68 @@ VkSurfaceKHR createSurface() {
 		
 }
 
-void printGPUInfo(VkPhysicalDevice device) {
+/**
+ * returns list of supported device features
+ */
+VkPhysicalDeviceFeatures getSupportedFeatures() {
+	return deviceCapabilities.features;
+}
+
+/**
+ * get the index of a queue family capable of presenting swapchain images
+ */
+int getPresentationCapableQueueFamilyIndex(VkSurfaceKHR surface) {
+
+	// depends on the surface, so it is not part of the capabilities
+	for (uint32_t i = 0; i < deviceCapabilities.queueFamilies.size(); i++) {
+
+		VkBool32 presentationSupport = VK_FALSE;
+		vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentationSupport);
+
+		if (presentationSupport == VK_TRUE)
+			return i;
+
+	}
+
+	return -1;
+}
+
+const char *physicalDeviceTypeName(VkPhysicalDeviceType type) {
+
+	switch (type) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		return "discrete";
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		return "integrated";
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		return "virtual";
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		return "cpu";
+	default:
+		return "other";
+	}
+
+}
+
+/**
+ * whether the device can take the Vulkan 1.3 path: dynamic rendering and
+ * synchronization2, on an instance created for 1.3
+ */
+bool vulkan13PathSupported(const DeviceCapabilities &capabilities) {
+
+	// the 1.3 features are only filled in if the instance and device are both 1.3
+	return capabilities.features13.dynamicRendering && capabilities.features13.synchronization2;
+}
+
+void printGPUInfo(const DeviceCapabilities &capabilities) {
 
-	VkPhysicalDeviceProperties deviceProperties;
-	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+	const VkPhysicalDeviceProperties &deviceProperties = capabilities.properties;
 
 	fprintf(stdout,
-			"%s (supports API version %u.%u.%u)\n",
+			"%s (%s, %llu MiB device-local, supports API version %u.%u.%u)\n",
 			deviceProperties.deviceName,
+			physicalDeviceTypeName(deviceProperties.deviceType),
+			static_cast<unsigned long long>(capabilities.deviceLocalHeapSize >> 20),
 			VK_VERSION_MAJOR(deviceProperties.apiVersion),
 			VK_VERSION_MINOR(deviceProperties.apiVersion),
 			VK_VERSION_PATCH(deviceProperties.apiVersion)
@@ -366,78 +895,294 @@ void printGPUInfo(VkPhysicalDevice device) {
 
 }
 
+bool deviceExtensionsSupported(const DeviceCapabilities &capabilities, const std::vector<const char *> &deviceExtensions) {
+
+	for (const char *extension : deviceExtensions) {
+		if (!capabilities.extensionSupported(extension))
+			return false;
+	}
+
+	return true;
+}
+
 /**
- * returns list of supported device features
+ * whether a queue family can present, checked before a surface exists
  */
-VkPhysicalDeviceFeatures getSupportedFeatures() {
-	VkPhysicalDeviceFeatures supportedFeatures = {};
-	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+bool queueFamilySupportsPresentation(VkPhysicalDevice device, uint32_t queueFamilyIndex) {
+#if defined(USE_NULLWS)
+	// a headless surface can be presented to from any family
+	if (headlessSurfaceSupported)
+		return true;
 
-	return supportedFeatures;
+	uint32_t displayCount = 0;
+	vkGetPhysicalDeviceDisplayPropertiesKHR(device, &displayCount, nullptr);
+
+	return displayCount > 0;
+#else
+	return glfwGetPhysicalDevicePresentationSupport(instance, device, queueFamilyIndex) == GLFW_TRUE;
+#endif
 }
 
 /**
- * get the index of a queue family supporting the appropriate flags
+ * ranks a physical device; -1 means it cannot run the engine at all
  */
-int getQueueFamilyIndex(VkPhysicalDevice device, VkQueueFlagBits queueBits) {
+int64_t scorePhysicalDevice(const DeviceCapabilities &capabilities, const std::vector<const char *> &deviceExtensions) {
 
-	uint32_t queueFamilyCount;
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+	if (!deviceExtensionsSupported(capabilities, deviceExtensions))
+		return -1;
 
-	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+	const std::vector<VkQueueFamilyProperties> &queueFamilies = capabilities.queueFamilies;
 
-	for (uint32_t i = 0; i < queueFamilyCount; i++) {
+	bool hasGraphics = false, hasPresent = false, hasAsyncCompute = false, hasTransfer = false;
 
-		// TODO : if we want queues with priorities, need >= 2 queues
-		if (queueFamilies[i].queueCount > 0 && queueFamilies[i].queueFlags & queueBits)
-			return i;
+	for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+
+		if (queueFamilies[i].queueCount == 0)
+			continue;
 
+		hasGraphics |= (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		hasPresent |= queueFamilySupportsPresentation(capabilities.physicalDevice, i);
+		hasAsyncCompute |= (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT);
+		hasTransfer |= (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
 	}
 
-	return -1;
+	if (!hasGraphics || !hasPresent)
+		return -1;
+
+	const VkPhysicalDeviceProperties &properties = capabilities.properties;
+	const VkPhysicalDeviceFeatures &features = capabilities.features;
+
+	int64_t score = 0;
+
+	// device type dominates: a small discrete GPU still beats a big iGPU
+	switch (properties.deviceType) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		score += 100000;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		score += 50000;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		score += 20000;
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		score += 1000;
+		break;
+	default:
+		break;
+	}
+
+	// then memory, in 64 MiB steps
+	score += static_cast<int64_t>(capabilities.deviceLocalHeapSize >> 26);
+
+	// then optional features and queues we make use of
+	if (features.samplerAnisotropy)
+		score += 100;
+	if (features.fillModeNonSolid)
+		score += 50;
+	if (hasAsyncCompute)
+		score += 200;
+	if (hasTransfer)
+		score += 200;
+
+	return score;
 }
 
 /**
- * get the index of a queue family capable of presenting swapchain images
+ * matches the --gpu / SPOCK_GPU override against a device: an index into
+ * the enumerated devices, a device UUID (dashes optional), or a
+ * case-insensitive substring of the device name
  */
-int getPresentationCapableQueueFamilyIndex(VkPhysicalDevice device, VkSurfaceKHR surface) {
+bool physicalDeviceMatches(const DeviceCapabilities &capabilities, uint32_t index, const char *selector) {
 
-	uint32_t queueFamilyCount;
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+	char *end;
+	unsigned long selectedIndex = strtoul(selector, &end, 10);
 
-	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+	if (*selector != '\0' && *end == '\0')
+		return selectedIndex == index;
 
-	for (uint32_t i = 0; i < queueFamilyCount; i++) {
+	if (capabilities.uuidValid) {
 
-		VkBool32 presentationSupport = VK_FALSE;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentationSupport);
+		char uuidString[VK_UUID_SIZE * 2 + 1];
+		for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+			snprintf(&uuidString[i * 2], 3, "%02x", capabilities.deviceUUID[i]);
 
-		if (presentationSupport == VK_TRUE)
-			return i;
+		std::string hex;
+		for (const char *c = selector; *c; c++) {
+			if (*c != '-')
+				hex += static_cast<char>(tolower(*c));
+		}
 
+		if (hex == uuidString)
+			return true;
 	}
 
-	return -1;
+	std::string name = capabilities.properties.deviceName, wanted = selector;
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+	std::transform(wanted.begin(), wanted.end(), wanted.begin(), ::tolower);
+
+	return name.find(wanted) != std::string::npos;
+}
+
+/**
+ * picks the device named by --gpu or SPOCK_GPU, or else the highest scoring
+ * one, and keeps the capabilities queried to score it in deviceCapabilities
+ */
+VkPhysicalDevice selectPhysicalDevice(std::vector<VkPhysicalDevice> devices, const std::vector<const char *> &deviceExtensions) {
+
+	const char *selector = gpuOverride ? gpuOverride : getenv("SPOCK_GPU");
+
+	int64_t bestScore = -1;
+	uint32_t best = 0;
+
+	std::vector<DeviceCapabilities> candidates(devices.size());
+
+	fputs("Physical devices:\n", stdout);
+
+	for (uint32_t i = 0; i < devices.size(); i++) {
+
+		candidates[i].init(instance, devices[i], instanceApiVersion, physicalDeviceProperties2Supported, externalMemoryCapabilitiesSupported);
+
+		int64_t score = scorePhysicalDevice(candidates[i], deviceExtensions);
+
+		fprintf(stdout, "  [%u] score %lld: ", i, static_cast<long long>(score));
+		printGPUInfo(candidates[i]);
+
+		if (score > bestScore) {
+			bestScore = score;
+			best = i;
+		}
+	}
+
+	if (selector) {
+		for (uint32_t i = 0; i < devices.size(); i++) {
+
+			if (!physicalDeviceMatches(candidates[i], i, selector))
+				continue;
+
+			if (scorePhysicalDevice(candidates[i], deviceExtensions) < 0) {
+				fprintf(stderr, "GPU override '%s' matches device %u, but it cannot run spock\n", selector, i);
+				break;
+			}
+
+			fprintf(stdout, "Selected device %u (override '%s'): ", i, selector);
+			printGPUInfo(candidates[i]);
+
+			deviceCapabilities = std::move(candidates[i]);
+
+			return devices[i];
+		}
+
+		fprintf(stderr, "GPU override '%s' did not select a usable device, falling back to scoring\n", selector);
+	}
+
+	if (bestScore < 0) {
+		fputs("No physical device supports the required extensions and queues\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(stdout, "Selected device %u (highest score): ", best);
+	printGPUInfo(candidates[best]);
+
+	deviceCapabilities = std::move(candidates[best]);
+
+	return devices[best];
+}
+
+/**
+ * turns on what the device supports of VK_KHR_fragment_shading_rate, adding
+ * it to deviceExtensions. Its dependencies are core from Vulkan 1.2; before
+ * that they are VK_KHR_create_renderpass2, which needs VK_KHR_multiview and
+ * VK_KHR_maintenance2 in turn
+ */
+void enableVariableRateShading(std::vector<const char *> &deviceExtensions) {
+
+	const VkPhysicalDeviceFragmentShadingRateFeaturesKHR &features = deviceCapabilities.fragmentShadingRateFeatures;
+	const VkPhysicalDeviceFragmentShadingRatePropertiesKHR &properties = deviceCapabilities.fragmentShadingRateProperties;
+
+	std::vector<const char *> extensions = { VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME };
+
+	bool core12 = std::min(instanceApiVersion, deviceCapabilities.properties.apiVersion) >= VK_API_VERSION_1_2;
+
+	if (!core12) {
+		extensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+		extensions.push_back(VK_KHR_MAINTENANCE2_EXTENSION_NAME);
+	}
+
+	if (!features.pipelineFragmentShadingRate || !deviceExtensionsSupported(deviceCapabilities, extensions) || (!core12 && !multiviewSupported)) {
+		fputs("VK_KHR_fragment_shading_rate not supported, rendering at reduced resolution instead\n", stderr);
+		return;
+	}
+
+	deviceExtensions.insert(deviceExtensions.end(), extensions.begin(), extensions.end());
+
+	shadingRate.enabled = true;
+	shadingRate.primitiveRate = features.primitiveFragmentShadingRate;
+
+	// the rate image is only bound through vkCmdBeginRendering; render passes
+	// would have to be created through vkCreateRenderPass2 to take it
+	const VkFormatFeatureFlags rateImageFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR;
+
+	shadingRate.attachmentRate = features.attachmentFragmentShadingRate && dynamicRenderingEnabled
+		&& deviceCapabilities.features.shaderStorageImageExtendedFormats
+		&& (deviceCapabilities.getFormatProperties(VK_FORMAT_R8_UINT).optimalTilingFeatures & rateImageFeatures) == rateImageFeatures;
+
+	// texel sizes are powers of two
+	shadingRate.texelSize = {
+		std::clamp(SHADING_RATE_TILE_SIZE, properties.minFragmentShadingRateAttachmentTexelSize.width, properties.maxFragmentShadingRateAttachmentTexelSize.width),
+		std::clamp(SHADING_RATE_TILE_SIZE, properties.minFragmentShadingRateAttachmentTexelSize.height, properties.maxFragmentShadingRateAttachmentTexelSize.height)
+	};
+
+	// the coarsest rate wins; without other combiner ops, the later rate replaces the earlier
+	shadingRate.combinerOp = properties.fragmentShadingRateNonTrivialCombinerOps
+		? VK_FRAGMENT_SHADING_RATE_COMBINER_OP_MAX_KHR
+		: VK_FRAGMENT_SHADING_RATE_COMBINER_OP_REPLACE_KHR;
 }
 
 VkDevice createLogicalDevice(std::vector<const char *> deviceExtensions) {
 
 	// get index of graphics queue family
-	graphicsFamilyIndex = getQueueFamilyIndex(physicalDevice, VK_QUEUE_GRAPHICS_BIT);
+	graphicsFamilyIndex = deviceCapabilities.findQueueFamily(VK_QUEUE_GRAPHICS_BIT);
 
 	// get index of presentation-capable queue family
-	presentFamilyIndex = getPresentationCapableQueueFamilyIndex(physicalDevice, surface);
+	presentFamilyIndex = getPresentationCapableQueueFamilyIndex(surface);
+
+	// async compute and transfer-only families if the device has them,
+	// otherwise that work shares the graphics family
+	int dedicatedCompute = deviceCapabilities.findQueueFamily(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+	int dedicatedTransfer = deviceCapabilities.findQueueFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+
+	computeFamilyIndex = dedicatedCompute >= 0 ? dedicatedCompute : graphicsFamilyIndex;
+	transferFamilyIndex = dedicatedTransfer >= 0 ? dedicatedTransfer : graphicsFamilyIndex;
+
+#if defined(DEBUG)
+	fprintf(stdout, "queue families: graphics %u, present %u, compute %u, transfer %u\n",
+			graphicsFamilyIndex, presentFamilyIndex, computeFamilyIndex, transferFamilyIndex);
+#endif
 
-	float queuePriorities[] = { 0.0f };
+	std::vector<uint32_t> queueFamilies = {
+		graphicsFamilyIndex, presentFamilyIndex, computeFamilyIndex, transferFamilyIndex
+	};
+
+	std::sort(queueFamilies.begin(), queueFamilies.end());
+	queueFamilies.erase(std::unique(queueFamilies.begin(), queueFamilies.end()), queueFamilies.end());
+
+	float queuePriorities[] = { 1.0f };
+
+	// initialise one queue per distinct family
+	std::vector<VkDeviceQueueCreateInfo> deviceQueueCIs;
 
-	// initialise queues
-	VkDeviceQueueCreateInfo deviceQueueCI = {};
-	deviceQueueCI.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	deviceQueueCI.queueFamilyIndex = graphicsFamilyIndex;
-	deviceQueueCI.queueCount       = 1;
-	deviceQueueCI.pQueuePriorities = queuePriorities;	// default priorities
+	for (uint32_t queueFamilyIndex : queueFamilies) {
+		VkDeviceQueueCreateInfo deviceQueueCI = {};
+		deviceQueueCI.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		deviceQueueCI.queueFamilyIndex = queueFamilyIndex;
+		deviceQueueCI.queueCount       = 1;
+		deviceQueueCI.pQueuePriorities = queuePriorities;
+
+		deviceQueueCIs.push_back(deviceQueueCI);
+	}
 
 	// turn on the appropriate (supported) device features
 	VkPhysicalDeviceFeatures supportedFeatures = getSupportedFeatures();
@@ -445,10 +1190,47 @@ VkDevice createLogicalDevice(std::vector<const char *> deviceExtensions) {
 	deviceFeatures.fillModeNonSolid = supportedFeatures.fillModeNonSolid;
 	deviceFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
 
+	// the rate image is r8ui, written by a compute pass
+	deviceFeatures.shaderStorageImageExtendedFormats = shadingRate.attachmentRate ? VK_TRUE : VK_FALSE;
+
+	// optional features, chained onto the create info as they are enabled
+	void *enabledFeatures = nullptr;
+
+	VkPhysicalDeviceVulkan13Features vulkan13Features = {};
+	vulkan13Features.sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	vulkan13Features.dynamicRendering = VK_TRUE;
+	vulkan13Features.synchronization2 = VK_TRUE;
+
+	if (dynamicRenderingEnabled) {
+		vulkan13Features.pNext = enabledFeatures;
+		enabledFeatures = &vulkan13Features;
+	}
+
+	VkPhysicalDeviceMultiviewFeaturesKHR multiviewFeatures = {};
+	multiviewFeatures.sType     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+	multiviewFeatures.multiview = VK_TRUE;
+
+	if (multiviewSupported) {
+		multiviewFeatures.pNext = enabledFeatures;
+		enabledFeatures = &multiviewFeatures;
+	}
+
+	VkPhysicalDeviceFragmentShadingRateFeaturesKHR shadingRateFeatures = {};
+	shadingRateFeatures.sType                         = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
+	shadingRateFeatures.pipelineFragmentShadingRate   = VK_TRUE;
+	shadingRateFeatures.primitiveFragmentShadingRate  = shadingRate.primitiveRate ? VK_TRUE : VK_FALSE;
+	shadingRateFeatures.attachmentFragmentShadingRate = shadingRate.attachmentRate ? VK_TRUE : VK_FALSE;
+
+	if (shadingRate.enabled) {
+		shadingRateFeatures.pNext = enabledFeatures;
+		enabledFeatures = &shadingRateFeatures;
+	}
+
 	VkDeviceCreateInfo deviceCI = {};
 	deviceCI.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceCI.queueCreateInfoCount    = 1;
-	deviceCI.pQueueCreateInfos       = &deviceQueueCI;
+	deviceCI.pNext                   = enabledFeatures;
+	deviceCI.queueCreateInfoCount    = static_cast<uint32_t>(deviceQueueCIs.size());
+	deviceCI.pQueueCreateInfos       = deviceQueueCIs.data();
 	deviceCI.enabledLayerCount       = 0;
 	deviceCI.ppEnabledLayerNames     = nullptr;
 	deviceCI.enabledExtensionCount   = static_cast<uint32_t>(deviceExtensions.size());
@@ -464,6 +1246,20 @@ VkDevice createLogicalDevice(std::vector<const char *> deviceExtensions) {
 
 	vkGetDeviceQueue(logicalDevice, graphicsFamilyIndex, 0, &graphicsQueue);
 	vkGetDeviceQueue(logicalDevice, presentFamilyIndex, 0, &presentQueue);
+	vkGetDeviceQueue(logicalDevice, computeFamilyIndex, 0, &computeQueue);
+	vkGetDeviceQueue(logicalDevice, transferFamilyIndex, 0, &transferQueue);
+
+	// core in 1.3, but the loader we link against may predate it
+	if (dynamicRenderingEnabled) {
+		cmdBeginRendering   = reinterpret_cast<PFN_vkCmdBeginRendering>(vkGetDeviceProcAddr(logicalDevice, "vkCmdBeginRendering"));
+		cmdEndRendering     = reinterpret_cast<PFN_vkCmdEndRendering>(vkGetDeviceProcAddr(logicalDevice, "vkCmdEndRendering"));
+		cmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2>(vkGetDeviceProcAddr(logicalDevice, "vkCmdPipelineBarrier2"));
+
+		if (!cmdBeginRendering || !cmdEndRendering || !cmdPipelineBarrier2) {
+			fputs("Could not load Vulkan 1.3 device functions\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
 
 	return logicalDevice;
 }
@@ -510,27 +1306,18 @@ VkSurfaceFormatKHR selectSurfaceFormat(VkPhysicalDevice device, VkSurfaceKHR sur
 	return availableFormats[0];
 }
 
-VkPresentModeKHR selectPresentMode(VkPhysicalDevice device, VkSurfaceKHR surface, VkPresentModeKHR desiredPresentMode) {
-
-	std::vector<VkPresentModeKHR> availablePresentModes = getSurfacePresentModes(device, surface);
-
-	for (VkPresentModeKHR presentMode : availablePresentModes) {
-		if (presentMode == desiredPresentMode) {
-			return presentMode;
-		}
-	}
-
-	return VK_PRESENT_MODE_FIFO_KHR;
-}
-
 #if defined(USE_NULLWS)
+const uint32_t NULLWS_WIDTH = 640;
+const uint32_t NULLWS_HEIGHT = 480;
+
 VkExtent2D getSwapchainExtent(VkSurfaceCapabilitiesKHR surfaceCapabilities) {
 
 	if (surfaceCapabilities.currentExtent.width == std::numeric_limits<uint32_t>::max() || surfaceCapabilities.currentExtent.height == std::numeric_limits<uint32_t>::min()) {
 		
+		// headless surfaces leave the size to the swapchain; that of the window
 		VkExtent2D swapchainExtent = {
-			.width = static_cast<uint32_t>(0),
-			.height = static_cast<uint32_t>(0)
+			.width = NULLWS_WIDTH,
+			.height = NULLWS_HEIGHT
 		};
 
 		VkExtent2D extent = swapchainExtent;
@@ -606,20 +1393,26 @@ bool surfaceTransformSupported(VkSurfaceTransformFlagBitsKHR desiredTransform, V
 VkSurfaceTransformFlagBitsKHR getSupportedSurfaceTransform(VkSurfaceCapabilitiesKHR surfaceCapabilities) {
 }
 
-VkSwapchainKHR createSwapchain() {
+VkSwapchainKHR createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE) {
 
 	VkSurfaceCapabilitiesKHR surfaceCapabilities = getSurfaceCapabilities(physicalDevice, surface);
 
 	VkSurfaceFormatKHR surfaceFormat = selectSurfaceFormat(physicalDevice, surface, VK_FORMAT_B8G8R8A8_UNORM);
-	VkPresentModeKHR surfacePresentMode = selectPresentMode(physicalDevice, surface, VK_PRESENT_MODE_MAILBOX_KHR);
+
+	// present mode and image count follow from the latency mode
+	presentPolicy = selectPresentPolicy(latencyMode, getSurfacePresentModes(physicalDevice, surface), surfaceCapabilities);
 
 	swapchainFormat = surfaceFormat;
-	swapchainPresentMode = surfacePresentMode;
+	swapchainPresentMode = presentPolicy.presentMode;
+
+	fprintf(stdout, "present mode: %s, %u images, %u frames in flight (%s)\n",
+			presentModeName(presentPolicy.presentMode), presentPolicy.imageCount,
+			presentPolicy.framesInFlight, latencyModeName(latencyMode));
 
 	VkSwapchainCreateInfoKHR swapchainCI = {};
 	swapchainCI.sType            = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	swapchainCI.surface          = surface;
-	swapchainCI.minImageCount    = std::max<uint32_t>(surfaceCapabilities.minImageCount, 3);
+	swapchainCI.minImageCount    = presentPolicy.imageCount;
 	swapchainCI.imageFormat      = swapchainFormat.format;
 	swapchainCI.imageColorSpace  = swapchainFormat.colorSpace;
 
@@ -632,8 +1425,30 @@ VkSwapchainKHR createSwapchain() {
 
 	swapchainCI.imageExtent = swapchainExtent;
 
+	// dynamic resolution blits the upscaled frame into the image; the render
+	// pass is built for one or the other, so this is only decided once
+	if (resolution.enabled && oldSwapchain == VK_NULL_HANDLE) {
+
+		VkFormatProperties formatProperties = deviceCapabilities.getFormatProperties(swapchainFormat.format);
+
+		if (!imageUsageSupported(VK_IMAGE_USAGE_TRANSFER_DST_BIT, surfaceCapabilities) || !(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
+			fputs("Swapchain images cannot be blitted to, dynamic resolution disabled\n", stderr);
+			resolution.enabled = false;
+		}
+	}
+
 	swapchainCI.imageArrayLayers = 1;
-	swapchainCI.imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	swapchainCI.imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (resolution.enabled ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0);
+
+	if (capturePath) {
+
+		if (!imageUsageSupported(VK_IMAGE_USAGE_TRANSFER_SRC_BIT, surfaceCapabilities)) {
+			fputs("Swapchain images cannot be copied from, --capture is not possible\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+
+		swapchainCI.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
 
 	if (graphicsFamilyIndex == presentFamilyIndex) {
 		swapchainCI.imageSharingMode      = VK_SHARING_MODE_EXCLUSIVE;
@@ -652,9 +1467,9 @@ VkSwapchainKHR createSwapchain() {
 
 	// TODO : check for support on this?
 	swapchainCI.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-	swapchainCI.presentMode    = surfacePresentMode;
+	swapchainCI.presentMode    = swapchainPresentMode;
 	swapchainCI.clipped        = VK_TRUE;
-	swapchainCI.oldSwapchain   = VK_NULL_HANDLE;
+	swapchainCI.oldSwapchain   = oldSwapchain;
 
 	VkSwapchainKHR swapchain;
 
@@ -666,12 +1481,19 @@ VkSwapchainKHR createSwapchain() {
 	return swapchain;
 }
 
-VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectMask) {
+VkImageView createImageView(
+		VkImage image,
+		VkFormat format,
+		VkImageAspectFlags aspectMask,
+		VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D,
+		uint32_t layerCount = 1,
+		uint32_t baseMipLevel = 0,
+		uint32_t levelCount = 1) {
 
 	VkImageViewCreateInfo imageViewCI = {};
 	imageViewCI.sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	imageViewCI.image    = image;
-	imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCI.viewType = viewType;
 	imageViewCI.format   = format;
 	imageViewCI.components = {
 		.r = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -681,10 +1503,10 @@ VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags a
 	};
 	imageViewCI.subresourceRange = {
 		.aspectMask = aspectMask,
-		.baseMipLevel = 0,
-		.levelCount = 1,
+		.baseMipLevel = baseMipLevel,
+		.levelCount = levelCount,
 		.baseArrayLayer = 0,
-		.layerCount = 1
+		.layerCount = layerCount
 	};
 
 	VkImageView imageView;
@@ -699,7 +1521,7 @@ std::vector<VkImageView> createSwapchainImageViews() {
 	uint32_t swapchainImageCount;
 	vkGetSwapchainImagesKHR(logicalDevice, swapchain, &swapchainImageCount, nullptr);
 
-	std::vector<VkImage> swapchainImages(swapchainImageCount);
+	swapchainImages.resize(swapchainImageCount);
 	vkGetSwapchainImagesKHR(logicalDevice, swapchain, &swapchainImageCount, swapchainImages.data());
 
 	std::vector<VkImageView> swapchainImageViews(swapchainImageCount);
@@ -713,12 +1535,11 @@ std::vector<VkImageView> createSwapchainImageViews() {
 	return swapchainImageViews;
 }
 
-VkFormat selectImageFormat(VkPhysicalDevice device, std::vector<VkFormat> desiredFormats, VkImageTiling tiling, VkFormatFeatureFlags features) {
+VkFormat selectImageFormat(std::initializer_list<VkFormat> desiredFormats, VkImageTiling tiling, VkFormatFeatureFlags features) {
 
 	for (VkFormat format : desiredFormats) {
 
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(device, format, &formatProperties);
+		const VkFormatProperties &formatProperties = deviceCapabilities.getFormatProperties(format);
 
 		if (tiling == VK_IMAGE_TILING_LINEAR && (formatProperties.linearTilingFeatures & features) == features)
 			return format;
@@ -730,31 +1551,124 @@ VkFormat selectImageFormat(VkPhysicalDevice device, std::vector<VkFormat> desire
 	exit(EXIT_FAILURE);
 }
 
-VkFormat selectDepthFormat(VkPhysicalDevice device) {
+bool hasStencilComponent(VkFormat format) {
+	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+VkFormat selectDepthFormat() {
 
-	std::vector<VkFormat> candidateDepthFormats = {
+	std::initializer_list<VkFormat> candidateDepthFormats = {
 		VK_FORMAT_D32_SFLOAT,
 		VK_FORMAT_D32_SFLOAT_S8_UINT,
 		VK_FORMAT_D24_UNORM_S8_UINT
 	};
 	
-	return selectImageFormat(device, candidateDepthFormats, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+	// the occlusion pyramid is built by sampling the depth buffer
+	VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	if (occlusionCulling)
+		features |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+	return selectImageFormat(candidateDepthFormats, VK_IMAGE_TILING_OPTIMAL, features);
 }
 
-uint32_t getMemoryType(VkPhysicalDevice device, uint32_t typeBits, VkMemoryPropertyFlags desiredProperties) {
+uint32_t getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags desiredProperties) {
 
-	VkPhysicalDeviceMemoryProperties memoryProperties;
-	vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+	int memoryType = deviceCapabilities.findMemoryType(typeBits, desiredProperties);
 
-	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+	if (memoryType >= 0)
+		return memoryType;
 
-		if ((typeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & desiredProperties) == desiredProperties)
-			return i;
+	fputs("Unable to find an associated memory type for the desired memory properties\n", stderr);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * refreshes the driver's per-heap usage and budget, if VK_EXT_memory_budget
+ * is enabled
+ */
+void updateMemoryBudget() {
+
+	if (!memoryBudgetSupported)
+		return;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2KHR memoryProperties2 = {};
+	memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+	memoryProperties2.pNext = &budgetProperties;
+
+	getMemoryProperties2(physicalDevice, &memoryProperties2);
+
+	memoryBudget.setDriverBudget(budgetProperties.heapBudget, budgetProperties.heapUsage);
+	lastMemoryBudgetUpdate = std::chrono::steady_clock::now();
+}
+
+/**
+ * prints what is resident in each heap, and rewrites the JSON report if one
+ * was asked for
+ */
+void reportMemory() {
+
+	updateMemoryBudget();
+	memoryBudget.writeReport(stderr);
+
+	if (memoryJsonPath) {
 
+		FILE *file = fopen(memoryJsonPath, "w");
+
+		if (!file) {
+			fprintf(stderr, "Could not write memory report to %s\n", memoryJsonPath);
+			return;
+		}
+
+		memoryBudget.writeJson(file);
+		fclose(file);
 	}
 
-	fputs("Unable to find an associated memory type for the desired memory properties\n", stderr);
-	exit(EXIT_FAILURE);
+}
+
+/**
+ * allocates device memory and accounts it to category; usedBytes is what the
+ * resource itself needs, the allocation may be larger
+ */
+VkDeviceMemory allocateMemory(VkMemoryRequirements memoryRequirements, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize usedBytes, MemoryCategory category) {
+
+	VkMemoryAllocateInfo memoryAI = {};
+	memoryAI.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAI.allocationSize  = memoryRequirements.size;
+	memoryAI.memoryTypeIndex = getMemoryType(memoryRequirements.memoryTypeBits, memoryPropertyFlags);
+
+	VkDeviceMemory memory;
+	VkResult result = vkAllocateMemory(logicalDevice, &memoryAI, nullptr, &memory);
+
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Unable to allocate %llu bytes of %s memory\n",
+				static_cast<unsigned long long>(memoryRequirements.size), memoryCategoryName(category));
+
+		if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY)
+			reportMemory();
+
+		exit(EXIT_FAILURE);
+	}
+
+	memoryBudget.allocated(memory, memoryAI.memoryTypeIndex, memoryRequirements.size, usedBytes, category);
+
+	return memory;
+}
+
+void freeMemory(VkDeviceMemory memory) {
+	memoryBudget.freed(memory);
+	vkFreeMemory(logicalDevice, memory, nullptr);
+}
+
+/**
+ * runs deleter once every frame submitted so far, and the one being
+ * recorded, has completed; the deleter must capture the handles it destroys
+ * by value
+ */
+void deferDeletion(std::function<void()> deleter) {
+	deletionQueue.push(submittedFrames + 1, std::move(deleter));
 }
 
 void createImage(
@@ -765,7 +1679,10 @@ void createImage(
 		VkFormat format,
 		VkImageTiling tiling,
 		VkImageUsageFlags usage,
-		VkMemoryPropertyFlags memoryPropertyFlags) {
+		VkMemoryPropertyFlags memoryPropertyFlags,
+		uint32_t arrayLayers = 1,
+		uint32_t mipLevels = 1,
+		MemoryCategory category = MEMORY_CATEGORY_IMAGE) {
 
 	VkImageCreateInfo imageCI = {};
 	imageCI.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -774,8 +1691,8 @@ void createImage(
 	imageCI.extent.width  = width;
 	imageCI.extent.height = height;
 	imageCI.extent.depth  = 1;
-	imageCI.mipLevels     = 1;
-	imageCI.arrayLayers   = 1;
+	imageCI.mipLevels     = mipLevels;
+	imageCI.arrayLayers   = arrayLayers;
 	imageCI.samples       = VK_SAMPLE_COUNT_1_BIT;
 	imageCI.tiling        = tiling;
 	imageCI.usage         = usage;
@@ -792,20 +1709,38 @@ void createImage(
 		exit(EXIT_FAILURE);
 	}
 
-	// now allocate the memory for the depth buffer image
+	// an image's layout is opaque, so all of its requirement counts as used
 	VkMemoryRequirements memoryRequirements;
 	vkGetImageMemoryRequirements(logicalDevice, image, &memoryRequirements);
 
-	VkMemoryAllocateInfo memoryAI = {};
-	memoryAI.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAI.allocationSize  = memoryRequirements.size;
-	memoryAI.memoryTypeIndex = getMemoryType(physicalDevice, memoryRequirements.memoryTypeBits, memoryPropertyFlags);
+	imageMemory = allocateMemory(memoryRequirements, memoryPropertyFlags, memoryRequirements.size, category);
+}
 
-	if (vkAllocateMemory(logicalDevice, &memoryAI, nullptr, &imageMemory) != VK_SUCCESS) {
-		fputs("Unable to allocate memory for depth buffer\n", stderr);
+void createBuffer(
+		VkBuffer &buffer,
+		VkDeviceMemory &bufferMemory,
+		VkDeviceSize size,
+		VkBufferUsageFlags usage,
+		VkMemoryPropertyFlags memoryPropertyFlags,
+		MemoryCategory category = MEMORY_CATEGORY_BUFFER) {
+
+	VkBufferCreateInfo bufferCI = {};
+	bufferCI.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCI.size        = size;
+	bufferCI.usage       = usage;
+	bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(logicalDevice, &bufferCI, nullptr, &buffer) != VK_SUCCESS) {
+		fputs("Failed to create buffer\n", stderr);
 		exit(EXIT_FAILURE);
 	}
 
+	VkMemoryRequirements memoryRequirements;
+	vkGetBufferMemoryRequirements(logicalDevice, buffer, &memoryRequirements);
+
+	bufferMemory = allocateMemory(memoryRequirements, memoryPropertyFlags, size, category);
+
+	vkBindBufferMemory(logicalDevice, buffer, bufferMemory, 0);
 }
 
 VkCommandPool createCommandPool(uint32_t queueFamilyIndex) {
@@ -825,27 +1760,61 @@ VkCommandPool createCommandPool(uint32_t queueFamilyIndex) {
 	return commandPool;
 }
 
-// TODO: allocate memory for vertex buffer
+/**
+ * creates the geometry pool's buffers, with room for vertexCapacity vertices
+ * and indexCapacity indices
+ */
+void createGeometryPool(uint32_t vertexCapacity, uint32_t indexCapacity) {
+
+	geometry.pool.init(vertexCapacity, indexCapacity);
 
-VkBuffer createVertexBuffer() {
+	createBuffer(
+			geometry.vertexBuffer, geometry.vertexBufferMemory,
+			sizeof(Vertex) * static_cast<VkDeviceSize>(vertexCapacity),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			);
 
-	VkBufferCreateInfo vertexBufferCI = {};
-	vertexBufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	vertexBufferCI.size = sizeof(vertices[0]) * vertices.size();
-	vertexBufferCI.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-	vertexBufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	createBuffer(
+			geometry.indexBuffer, geometry.indexBufferMemory,
+			sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCapacity),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			);
+}
 
-	if (vkCreateBuffer(logicalDevice, &vertexBufferCI, nullptr, &vertexBuffer) != VK_SUCCESS) {
-		fputs("Unable to create vertex buffer\n", stderr);
-		exit(EXIT_FAILURE);
+glm::mat4 getViewMatrix() {
+	return glm::lookAt(cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+glm::mat4 getProjectionMatrix() {
+
+	glm::mat4 projection = glm::perspectiveRH_ZO(cameraFovY, swapchainExtent.width / static_cast<float>(swapchainExtent.height), cameraNear, cameraFar);
+	projection[1][1] *= -1.0f;	// Vulkan's clip space y points down
+
+	return projection;
+}
+
+/**
+ * picks each mesh's LOD from its projected size on screen
+ */
+void selectMeshLods() {
+
+	PROFILE_FUNCTION();
+
+	for (uint32_t i = 0; i < meshes.size(); i++) {
+
+		float distance = glm::length(meshes[i].center - cameraPosition);
+		float size = projectedSize(meshes[i], distance, cameraFovY, static_cast<float>(swapchainExtent.height));
+
+		meshLods[i] = selectLod(meshes[i], size, meshLods[i]);
 	}
 
-	return vertexBuffer;
 }
 
 std::vector<VkCommandBuffer> createCommandBuffers(VkCommandPool commandPool) {
 
-	std::vector<VkCommandBuffer> commandBuffers(swapchainFramebuffers.size());
+	std::vector<VkCommandBuffer> commandBuffers(swapchainImageViews.size());
 
 	VkCommandBufferAllocateInfo commandBufferAI = {};
 	commandBufferAI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -861,20 +1830,67 @@ std::vector<VkCommandBuffer> createCommandBuffers(VkCommandPool commandPool) {
 	return commandBuffers;
 }
 
-VkDescriptorSetLayout createDescriptorSetLayout() {
+/**
+ * set 0 of the scene pipelines, which share one layout
+ */
+std::array<VkDescriptorSetLayoutBinding, 7> getSceneDescriptorBindings() {
+
+	std::array<VkDescriptorSetLayoutBinding, 7> descriptorSetLayoutBindings = {};
 
 	/* Uniform Buffer Object layout */
-	VkDescriptorSetLayoutBinding descriptorSetLayoutBinding = {};
-	descriptorSetLayoutBinding.binding            = 0;
-	descriptorSetLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	descriptorSetLayoutBinding.descriptorCount    = 1;
-	descriptorSetLayoutBinding.stageFlags         = VK_SHADER_STAGE_VERTEX_BIT;
-	descriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+	descriptorSetLayoutBindings[0].binding            = 0;
+	descriptorSetLayoutBindings[0].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorSetLayoutBindings[0].descriptorCount    = 1;
+	descriptorSetLayoutBindings[0].stageFlags         = VK_SHADER_STAGE_VERTEX_BIT;
+	descriptorSetLayoutBindings[0].pImmutableSamplers = nullptr;
+
+	/* cluster parameters, lights and the light grid, in LightBuffer order */
+	for (uint32_t i = 1; i <= LIGHT_BUFFER_COUNT; i++) {
+		descriptorSetLayoutBindings[i].binding            = i;
+		descriptorSetLayoutBindings[i].descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorSetLayoutBindings[i].descriptorCount    = 1;
+		descriptorSetLayoutBindings[i].stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;
+		descriptorSetLayoutBindings[i].pImmutableSamplers = nullptr;
+	}
+
+	/* shadow cascades and the shadow map */
+	descriptorSetLayoutBindings[5].binding            = 5;
+	descriptorSetLayoutBindings[5].descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorSetLayoutBindings[5].descriptorCount    = 1;
+	descriptorSetLayoutBindings[5].stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;
+	descriptorSetLayoutBindings[5].pImmutableSamplers = nullptr;
+
+	descriptorSetLayoutBindings[6].binding            = 6;
+	descriptorSetLayoutBindings[6].descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorSetLayoutBindings[6].descriptorCount    = 1;
+	descriptorSetLayoutBindings[6].stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;
+	descriptorSetLayoutBindings[6].pImmutableSamplers = nullptr;
+
+	return descriptorSetLayoutBindings;
+}
+
+/**
+ * the push constants of the scene pipelines: the size of the area rendered
+ * to, which dynamic resolution changes without rebuilding the light grid
+ */
+VkPushConstantRange getScenePushConstantRange() {
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.offset     = 0;
+	pushConstantRange.size       = sizeof(glm::vec2);
+
+	return pushConstantRange;
+}
+
+VkDescriptorSetLayout createDescriptorSetLayout() {
+
+	std::array<VkDescriptorSetLayoutBinding, 7> descriptorSetLayoutBindings = getSceneDescriptorBindings();
 
 	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = {};
 	descriptorSetLayoutCI.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	descriptorSetLayoutCI.bindingCount = 1;
-	descriptorSetLayoutCI.pBindings    = &descriptorSetLayoutBinding;
+	descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(descriptorSetLayoutBindings.size());
+	descriptorSetLayoutCI.pBindings    = descriptorSetLayoutBindings.data();
 
 	if (vkCreateDescriptorSetLayout(logicalDevice, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
 		fputs("Failed to create descriptor set layout\n", stderr);
@@ -884,65 +1900,362 @@ VkDescriptorSetLayout createDescriptorSetLayout() {
 	return descriptorSetLayout;
 }
 
+/**
+ * a pool for one descriptor set per swapchain image
+ */
 void createDescriptorPool() {
-	std::array<VkDescriptorPoolSize, 2> descriptorPoolSizes = {};
+
+	uint32_t setCount = static_cast<uint32_t>(swapchainImageViews.size());
+
+	std::array<VkDescriptorPoolSize, 3> descriptorPoolSizes = {};
+	descriptorPoolSizes[0].type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorPoolSizes[0].descriptorCount = setCount * 2;
+	descriptorPoolSizes[1].type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorPoolSizes[1].descriptorCount = setCount * LIGHT_BUFFER_COUNT;
+	descriptorPoolSizes[2].type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorPoolSizes[2].descriptorCount = setCount;
+
+	VkDescriptorPoolCreateInfo descriptorPoolCI = {};
+	descriptorPoolCI.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCI.maxSets       = setCount;
+	descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());
+	descriptorPoolCI.pPoolSizes    = descriptorPoolSizes.data();
+
+	if (vkCreateDescriptorPool(logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool) != VK_SUCCESS) {
+		fputs("Failed to create descriptor pool\n", stderr);
+		exit(EXIT_FAILURE);
+	}
 
 }
 
+/**
+ * points every swapchain image's descriptor set at the uniform buffer, the
+ * light grid and the shadow map
+ */
 void createDescriptorSets() {
 
-}
+	std::vector<VkDescriptorSetLayout> layouts(swapchainImageViews.size(), descriptorSetLayout);
 
-void recordRenderpasses() {
+	VkDescriptorSetAllocateInfo descriptorSetAI = {};
+	descriptorSetAI.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAI.descriptorPool     = descriptorPool;
+	descriptorSetAI.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+	descriptorSetAI.pSetLayouts        = layouts.data();
 
-	for (uint32_t i = 0; i < commandBuffers.size(); i++) {
+	descriptorSets.resize(layouts.size());
 
-		VkCommandBufferBeginInfo commandBufferBI = {};
-		commandBufferBI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		commandBufferBI.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	if (vkAllocateDescriptorSets(logicalDevice, &descriptorSetAI, descriptorSets.data()) != VK_SUCCESS) {
+		fputs("Could not allocate descriptor sets\n", stderr);
+		exit(EXIT_FAILURE);
+	}
 
-		if (vkBeginCommandBuffer(commandBuffers[i], &commandBufferBI) != VK_SUCCESS) {
-			fputs("Unable to begin command buffer\n", stderr);
+	std::array<VkDescriptorBufferInfo, 2 + LIGHT_BUFFER_COUNT> descriptorBufferIs = {};
+
+	descriptorBufferIs[0].buffer = uniformBuffer;
+	descriptorBufferIs[0].offset = 0;
+	descriptorBufferIs[0].range  = sizeof(UniformBufferObject);
+
+	for (uint32_t i = 0; i < LIGHT_BUFFER_COUNT; i++) {
+		descriptorBufferIs[1 + i].buffer = lightGrid.buffers[i];
+		descriptorBufferIs[1 + i].offset = 0;
+		descriptorBufferIs[1 + i].range  = VK_WHOLE_SIZE;
+	}
+
+	descriptorBufferIs[5].buffer = shadows.paramsBuffer;
+	descriptorBufferIs[5].offset = 0;
+	descriptorBufferIs[5].range  = sizeof(ShadowParams);
+
+	VkDescriptorImageInfo descriptorImageI = {};
+	descriptorImageI.sampler     = shadows.sampler;
+	descriptorImageI.imageView   = shadows.view;
+	descriptorImageI.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	for (VkDescriptorSet descriptorSet : descriptorSets) {
+
+		std::array<VkWriteDescriptorSet, 3 + LIGHT_BUFFER_COUNT> writeDescriptorSets = {};
+
+		for (uint32_t i = 0; i < descriptorBufferIs.size(); i++) {
+			writeDescriptorSets[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDescriptorSets[i].dstSet          = descriptorSet;
+			writeDescriptorSets[i].dstBinding      = i;
+			writeDescriptorSets[i].descriptorCount = 1;
+			writeDescriptorSets[i].descriptorType  = i == 0 || i == 5 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writeDescriptorSets[i].pBufferInfo     = &descriptorBufferIs[i];
 		}
 
-		std::array<VkClearValue, 2> clearColors = {};
-		clearColors[0].color = { 0.3f, 0.3f, 0.3f, 1.0f };
-		clearColors[1].depthStencil = { 1.0f, 0 };
+		writeDescriptorSets[6].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writeDescriptorSets[6].dstSet          = descriptorSet;
+		writeDescriptorSets[6].dstBinding      = 6;
+		writeDescriptorSets[6].descriptorCount = 1;
+		writeDescriptorSets[6].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writeDescriptorSets[6].pImageInfo      = &descriptorImageI;
+
+		vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+}
+
+/**
+ * records the shadow pass: every caster drawn once, into the cascades its
+ * bounds overlap
+ */
+void recordShadowPass(VkCommandBuffer commandBuffer) {
+
+	PROFILE_FUNCTION();
+
+	shadowDrawQueue.clear();
+
+	for (uint32_t m = 0; m < meshes.size(); m++) {
+
+		const Mesh &mesh = meshes[m];
+		const MeshLod &lod = mesh.lods[meshLods[m]];
+
+		uint32_t cascadeMask = getCascadeMask(shadows.cascades, mesh.center, mesh.radius);
+		if (cascadeMask == 0)
+			continue;
+
+		DrawCommand draw = {};
+		draw.key            = DrawQueue::makeKey(0, 0, 0, m, 0);
+		draw.pipeline       = shadows.pipeline;
+		draw.pipelineLayout = shadows.pipelineLayout;
+		draw.descriptorSet  = shadows.descriptorSet;
+		draw.vertexBuffer   = geometry.vertexBuffer;
+		draw.indexBuffer    = geometry.indexBuffer;
+		draw.count          = lod.indexCount;
+		draw.instanceCount  = 1;
+		draw.firstIndex     = lod.firstIndex;
+		draw.vertexOffset   = mesh.vertexOffset;
+		draw.firstInstance  = cascadeMask;
+		shadowDrawQueue.push(draw);
+	}
+
+	// the skinned vertices, so characters are not skinned again per cascade
+	for (uint32_t c = 0; c < characters.count; c++) {
+
+		uint32_t cascadeMask = getCascadeMask(shadows.cascades, characters.positions[c] + glm::vec3(0.0f, 0.5f, 0.0f), 0.75f);
+		if (cascadeMask == 0)
+			continue;
+
+		DrawCommand draw = {};
+		draw.key            = DrawQueue::makeKey(0, 0, 0, static_cast<uint32_t>(meshes.size()), 0);
+		draw.pipeline       = shadows.pipeline;
+		draw.pipelineLayout = shadows.pipelineLayout;
+		draw.descriptorSet  = shadows.descriptorSet;
+		draw.vertexBuffer   = characters.skinnedBuffer;
+		draw.indexBuffer    = geometry.indexBuffer;
+		draw.count          = characters.indexCount;
+		draw.instanceCount  = 1;
+		draw.firstIndex     = characters.firstIndex;
+		draw.vertexOffset   = static_cast<int32_t>(c * characters.vertexCount);
+		draw.firstInstance  = cascadeMask;
+		shadowDrawQueue.push(draw);
+	}
+
+	shadowDrawQueue.sort();
+
+	VkClearValue clearValue = {};
+	clearValue.depthStencil = { 1.0f, 0 };
+
+	VkRenderPassBeginInfo renderpassBI = {};
+	renderpassBI.sType             = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderpassBI.renderPass        = shadows.renderpass;
+	renderpassBI.framebuffer       = shadows.framebuffer;
+	renderpassBI.renderArea.offset = { 0, 0 };
+	renderpassBI.renderArea.extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE };
+	renderpassBI.clearValueCount   = 1;
+	renderpassBI.pClearValues      = &clearValue;
+
+	vkCmdBeginRenderPass(commandBuffer, &renderpassBI, VK_SUBPASS_CONTENTS_INLINE);
+	shadowDrawQueue.record(commandBuffer);
+	vkCmdEndRenderPass(commandBuffer);
+}
+
+/**
+ * begins the main pass on swapchain image i, or on the scene target with
+ * dynamic resolution, clearing colour and depth within extent. On the 1.3
+ * path the attachments are moved into place with explicit barriers and
+ * rendered to without a render pass or framebuffer
+ */
+void beginMainPass(VkCommandBuffer commandBuffer, uint32_t i, VkExtent2D extent) {
+
+	std::array<VkClearValue, 2> clearColors = {};
+	clearColors[0].color = { 0.3f, 0.3f, 0.3f, 1.0f };
+	clearColors[1].depthStencil = { 1.0f, 0 };
+
+	if (!dynamicRenderingEnabled) {
 
 		VkRenderPassBeginInfo renderpassBI = {};
 		renderpassBI.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 		renderpassBI.renderPass = renderpass;
 		renderpassBI.framebuffer = swapchainFramebuffers[i];
 		renderpassBI.renderArea.offset = { 0, 0 };
-		renderpassBI.renderArea.extent = swapchainExtent;
+		renderpassBI.renderArea.extent = extent;
 		renderpassBI.clearValueCount = static_cast<uint32_t>(clearColors.size());
 		renderpassBI.pClearValues = clearColors.data();
 
-		// start of renderpass
-		vkCmdBeginRenderPass(commandBuffers[i], &renderpassBI, VK_SUBPASS_CONTENTS_INLINE);
-			
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-			// TODO: create descriptor sets
-			vkCmdBindDescriptorSets(
-					commandBuffers[i],
-					VK_PIPELINE_BIND_POINT_GRAPHICS,
-					pipelineLayout,
-					0,
-					1,
-					&descriptorSets[i],
-					0,
-					nullptr
-				);
+		vkCmdBeginRenderPass(commandBuffer, &renderpassBI, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+	VkFormat depthFormat = selectDepthFormat();
+
+	std::array<VkImageMemoryBarrier2, 2> imageMemoryBarriers = {};
+
+	// presentation is done with the image once the acquire semaphore, waited
+	// on at colour output, has signalled
+	imageMemoryBarriers[0].sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	imageMemoryBarriers[0].srcStageMask                    = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+	imageMemoryBarriers[0].srcAccessMask                   = 0;
+	imageMemoryBarriers[0].dstStageMask                    = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+	imageMemoryBarriers[0].dstAccessMask                   = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+	imageMemoryBarriers[0].oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemoryBarriers[0].newLayout                       = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	imageMemoryBarriers[0].srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarriers[0].dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarriers[0].image                           = swapchainImages[i];
+	imageMemoryBarriers[0].subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarriers[0].subresourceRange.baseMipLevel   = 0;
+	imageMemoryBarriers[0].subresourceRange.levelCount     = 1;
+	imageMemoryBarriers[0].subresourceRange.baseArrayLayer = 0;
+	imageMemoryBarriers[0].subresourceRange.layerCount     = 1;
+
+	// or the previous frame's upscale is done reading the scene target
+	if (resolution.enabled) {
+		imageMemoryBarriers[0].srcStageMask |= VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		imageMemoryBarriers[0].image         = resolution.sceneColor;
+	}
 
-		vkCmdEndRenderPass(commandBuffers[i]);
+	// the previous frame's depth tests, and its pyramid pass, must be done
+	// with the depth buffer before it is cleared
+	imageMemoryBarriers[1] = imageMemoryBarriers[0];
+	imageMemoryBarriers[1].srcStageMask  = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+	imageMemoryBarriers[1].srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	imageMemoryBarriers[1].dstStageMask  = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+	imageMemoryBarriers[1].dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	imageMemoryBarriers[1].newLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	imageMemoryBarriers[1].image         = depthBuffer;
+
+	imageMemoryBarriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+	if (hasStencilComponent(depthFormat))
+		imageMemoryBarriers[1].subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+	if (occlusionCulling)
+		imageMemoryBarriers[1].srcStageMask |= VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+
+	VkDependencyInfo dependencyI = {};
+	dependencyI.sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyI.imageMemoryBarrierCount = static_cast<uint32_t>(imageMemoryBarriers.size());
+	dependencyI.pImageMemoryBarriers    = imageMemoryBarriers.data();
+
+	cmdPipelineBarrier2(commandBuffer, &dependencyI);
+
+	VkRenderingAttachmentInfo colorAttachment = {};
+	colorAttachment.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+	colorAttachment.imageView   = resolution.enabled ? resolution.sceneColorView : swapchainImageViews[i];
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp      = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp     = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.clearValue  = clearColors[0];
+
+	// the next frame builds its occlusion pyramid from this frame's depth
+	VkRenderingAttachmentInfo depthAttachment = {};
+	depthAttachment.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+	depthAttachment.imageView   = depthBufferView;
+	depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.loadOp      = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp     = occlusionCulling ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.clearValue  = clearColors[1];
+
+	VkRenderingInfo renderingI = {};
+	renderingI.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	renderingI.renderArea.offset    = { 0, 0 };
+	renderingI.renderArea.extent    = extent;
+	renderingI.layerCount           = 1;
+	renderingI.colorAttachmentCount = 1;
+	renderingI.pColorAttachments    = &colorAttachment;
+	renderingI.pDepthAttachment     = &depthAttachment;
+
+	// written by this frame's work, ahead of the pass
+	VkRenderingFragmentShadingRateAttachmentInfoKHR shadingRateAttachment = {};
+	shadingRateAttachment.sType                          = VK_STRUCTURE_TYPE_RENDERING_FRAGMENT_SHADING_RATE_ATTACHMENT_INFO_KHR;
+	shadingRateAttachment.imageView                      = shadingRate.view;
+	shadingRateAttachment.imageLayout                    = VK_IMAGE_LAYOUT_GENERAL;
+	shadingRateAttachment.shadingRateAttachmentTexelSize = shadingRate.texelSize;
+
+	if (shadingRate.attachmentRate)
+		renderingI.pNext = &shadingRateAttachment;
+
+	cmdBeginRendering(commandBuffer, &renderingI);
+}
 
-		if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-			fputs("Failed to end command buffer\n", stderr);
-			exit(EXIT_FAILURE);
-		}
+/**
+ * ends the main pass on swapchain image i, leaving the image ready to present
+ * (or the scene target ready to upscale) and the depth buffer ready for the
+ * next frame's pyramid pass
+ */
+void endMainPass(VkCommandBuffer commandBuffer, uint32_t i) {
 
+	if (!dynamicRenderingEnabled) {
+		vkCmdEndRenderPass(commandBuffer);
+		return;
 	}
-	
+
+	cmdEndRendering(commandBuffer);
+
+	std::array<VkImageMemoryBarrier2, 2> imageMemoryBarriers = {};
+
+	// the present semaphore orders presentation after this
+	imageMemoryBarriers[0].sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	imageMemoryBarriers[0].srcStageMask                    = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+	imageMemoryBarriers[0].srcAccessMask                   = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+	imageMemoryBarriers[0].dstStageMask                    = VK_PIPELINE_STAGE_2_NONE;
+	imageMemoryBarriers[0].dstAccessMask                   = 0;
+	imageMemoryBarriers[0].oldLayout                       = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	imageMemoryBarriers[0].newLayout                       = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	imageMemoryBarriers[0].srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarriers[0].dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarriers[0].image                           = swapchainImages[i];
+	imageMemoryBarriers[0].subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarriers[0].subresourceRange.baseMipLevel   = 0;
+	imageMemoryBarriers[0].subresourceRange.levelCount     = 1;
+	imageMemoryBarriers[0].subresourceRange.baseArrayLayer = 0;
+	imageMemoryBarriers[0].subresourceRange.layerCount     = 1;
+
+	if (resolution.enabled) {
+		imageMemoryBarriers[0].dstStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		imageMemoryBarriers[0].dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+		imageMemoryBarriers[0].newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageMemoryBarriers[0].image         = resolution.sceneColor;
+	}
+
+	uint32_t barrierCount = 1;
+
+	if (occlusionCulling) {
+
+		imageMemoryBarriers[1] = imageMemoryBarriers[0];
+		imageMemoryBarriers[1].srcStageMask  = VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+		imageMemoryBarriers[1].srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		imageMemoryBarriers[1].dstStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		imageMemoryBarriers[1].dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+		imageMemoryBarriers[1].oldLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		imageMemoryBarriers[1].newLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		imageMemoryBarriers[1].image         = depthBuffer;
+
+		imageMemoryBarriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+		if (hasStencilComponent(selectDepthFormat()))
+			imageMemoryBarriers[1].subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+		barrierCount++;
+	}
+
+	VkDependencyInfo dependencyI = {};
+	dependencyI.sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyI.imageMemoryBarrierCount = barrierCount;
+	dependencyI.pImageMemoryBarriers    = imageMemoryBarriers.data();
+
+	cmdPipelineBarrier2(commandBuffer, &dependencyI);
 }
 
 VkCommandBuffer beginCommandRecording(VkCommandPool commandPool) {
@@ -973,10 +2286,17 @@ void submitCommandBuffer(VkCommandPool commandPool, VkCommandBuffer commandBuffe
 	submitI.commandBufferCount = 1;
 	submitI.pCommandBuffers    = &commandBuffer;
 
-	vkQueueSubmit(queue, 1, &submitI, VK_NULL_HANDLE);
+	// waits for this submission only, frames in flight on the queue carry on
+	VkFenceCreateInfo fenceCI = {};
+	fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence fence;
+	vkCreateFence(logicalDevice, &fenceCI, nullptr, &fence);
 
-	// TODO : change when synchronisation implemented
-	vkQueueWaitIdle(queue);
+	vkQueueSubmit(queue, 1, &submitI, fence);
+	vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+
+	vkDestroyFence(logicalDevice, fence, nullptr);
 
 	// TODO : have option to free or just reset command buffer (less $$$)
 	vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
@@ -988,13 +2308,7 @@ void endCommandRecording(VkCommandBuffer commandBuffer) {
 
 }
 
-bool hasStencilComponent(VkFormat format) {
-	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
-}
-
-void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-
-	VkCommandBuffer commandBuffer = beginCommandRecording(commandPool);
+void recordImageLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
 
 	VkImageMemoryBarrier imageMemoryBarrier = {};
 	imageMemoryBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1069,379 +2383,4654 @@ void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayo
 			&imageMemoryBarrier
 		);
 
+}
+
+void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
+
+	VkCommandBuffer commandBuffer = beginCommandRecording(commandPool);
+
+	recordImageLayoutTransition(commandBuffer, image, format, oldLayout, newLayout);
+
 	endCommandRecording(commandBuffer);
 
 	submitCommandBuffer(commandPool, commandBuffer, graphicsQueue);
 }
 
-VkImage createDepthBuffer() {
+/**
+ * the synchronization2 stages as 1.0 stages, widening the split ones to the
+ * stage they were split from
+ */
+VkPipelineStageFlags getLegacyStageMask(VkPipelineStageFlags2 stageMask, VkPipelineStageFlags empty) {
 
-	VkFormat depthFormat = selectDepthFormat(physicalDevice);
+	// the 1.0 stages keep their bits
+	VkPipelineStageFlags legacyStageMask = static_cast<VkPipelineStageFlags>(stageMask & 0xffffffffull);
 
-	createImage(
-			depthBuffer, depthBufferMemory,
-			swapchainExtent.width, swapchainExtent.height, depthFormat,
-			VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-			);
+	if (stageMask & (VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_RESOLVE_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT))
+		legacyStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if (stageMask & (VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT))
+		legacyStageMask |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+	// there are no tessellation or geometry shaders, and their stages may not
+	// be named without the features
+	if (stageMask & VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT)
+		legacyStageMask |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
 
-	vkBindImageMemory(logicalDevice, depthBuffer, depthBufferMemory, 0);
+	return legacyStageMask ? legacyStageMask : empty;
+}
 
-	depthBufferView = createImageView(depthBuffer, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+VkAccessFlags getLegacyAccessMask(VkAccessFlags2 accessMask) {
 
-	transitionImageLayout(depthBuffer, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	VkAccessFlags legacyAccessMask = static_cast<VkAccessFlags>(accessMask & 0xffffffffull);
 
-	return depthBuffer;
+	if (accessMask & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT))
+		legacyAccessMask |= VK_ACCESS_SHADER_READ_BIT;
+	if (accessMask & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+		legacyAccessMask |= VK_ACCESS_SHADER_WRITE_BIT;
+
+	return legacyAccessMask;
 }
 
-VkRenderPass createRenderPass() {
+/**
+ * a global memory barrier, given in synchronization2 terms. On the 1.0 path
+ * it is recorded with the nearest (wider) 1.0 stages and accesses; with no
+ * accesses it is an execution dependency only
+ */
+void recordMemoryBarrier(
+		VkCommandBuffer commandBuffer,
+		VkPipelineStageFlags2 srcStageMask,
+		VkAccessFlags2 srcAccessMask,
+		VkPipelineStageFlags2 dstStageMask,
+		VkAccessFlags2 dstAccessMask) {
+
+	if (dynamicRenderingEnabled) {
+
+		VkMemoryBarrier2 memoryBarrier = {};
+		memoryBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+		memoryBarrier.srcStageMask  = srcStageMask;
+		memoryBarrier.srcAccessMask = srcAccessMask;
+		memoryBarrier.dstStageMask  = dstStageMask;
+		memoryBarrier.dstAccessMask = dstAccessMask;
+
+		VkDependencyInfo dependencyI = {};
+		dependencyI.sType              = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyI.memoryBarrierCount = 1;
+		dependencyI.pMemoryBarriers    = &memoryBarrier;
+
+		cmdPipelineBarrier2(commandBuffer, &dependencyI);
+		return;
+	}
 
-	VkAttachmentDescription colorAttachment = {};
-	colorAttachment.format         = swapchainFormat.format;
-	colorAttachment.samples        = VK_SAMPLE_COUNT_1_BIT;	// TODO : multisampling
-	colorAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = getLegacyAccessMask(srcAccessMask);
+	memoryBarrier.dstAccessMask = getLegacyAccessMask(dstAccessMask);
 
-	VkAttachmentReference colorAttachmentReference = {};
-	colorAttachmentReference.attachment = 0;
-	colorAttachmentReference.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	vkCmdPipelineBarrier(
+			commandBuffer,
+			getLegacyStageMask(srcStageMask, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+			getLegacyStageMask(dstStageMask, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+			0,
+			memoryBarrier.srcAccessMask || memoryBarrier.dstAccessMask ? 1 : 0, &memoryBarrier,
+			0, nullptr,
+			0, nullptr
+		);
 
-	VkAttachmentDescription depthAttachment = {};
-	depthAttachment.format         = selectDepthFormat(physicalDevice);
-	depthAttachment.samples        = VK_SAMPLE_COUNT_1_BIT;	// TODO : multisampling
-	depthAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+}
 
-	VkAttachmentReference depthAttachmentReference = {};
-	depthAttachmentReference.attachment = 1;
-	depthAttachmentReference.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+/**
+ * clears every layer of a depth image to the far plane and leaves it ready
+ * to be sampled, by fragment or compute shaders
+ */
+void clearDepthImage(VkImage image, VkFormat format, uint32_t layerCount) {
 
-	std::array<VkAttachmentDescription, 2> attachments = {
-		colorAttachment, depthAttachment
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask       = 0;
+	imageMemoryBarrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemoryBarrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemoryBarrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image               = image;
+	imageMemoryBarrier.subresourceRange = {
+		.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT,
+		.baseMipLevel   = 0,
+		.levelCount     = 1,
+		.baseArrayLayer = 0,
+		.layerCount     = layerCount
 	};
 
-	VkSubpassDescription subpassDescription = {};
-	subpassDescription.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpassDescription.colorAttachmentCount    = 1;
+	if (hasStencilComponent(format))
+		imageMemoryBarrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+	VkCommandBuffer commandBuffer = beginCommandRecording(commandPool);
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+	VkClearDepthStencilValue clearValue = { 1.0f, 0 };
+	vkCmdClearDepthStencilImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &imageMemoryBarrier.subresourceRange);
+
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageMemoryBarrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageMemoryBarrier.newLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageMemoryBarrier
+		);
+
+	endCommandRecording(commandBuffer);
+	submitCommandBuffer(commandPool, commandBuffer, graphicsQueue);
+}
+
+/*
+ * Queue family ownership transfer of an exclusive resource. The release half
+ * is recorded on a queue of srcFamilyIndex, the acquire half on a queue of
+ * dstFamilyIndex, which must wait on a semaphore signalled after the release.
+ * Both halves carry the same layout transition. When both families are the
+ * same no transfer is needed, and the release becomes an ordinary barrier.
+ */
+struct QueueOwnershipTransfer {
+	uint32_t srcFamilyIndex;
+	uint32_t dstFamilyIndex;
+	VkPipelineStageFlags srcStageMask;
+	VkAccessFlags srcAccessMask;
+	VkPipelineStageFlags dstStageMask;
+	VkAccessFlags dstAccessMask;
+	VkImageLayout oldLayout;	// images only
+	VkImageLayout newLayout;
+};
+
+void releaseBufferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, const QueueOwnershipTransfer &transfer) {
+
+	bool sameFamily = transfer.srcFamilyIndex == transfer.dstFamilyIndex;
+
+	VkBufferMemoryBarrier bufferMemoryBarrier = {};
+	bufferMemoryBarrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferMemoryBarrier.srcAccessMask       = transfer.srcAccessMask;
+	bufferMemoryBarrier.dstAccessMask       = sameFamily ? transfer.dstAccessMask : 0;
+	bufferMemoryBarrier.srcQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.srcFamilyIndex;
+	bufferMemoryBarrier.dstQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.dstFamilyIndex;
+	bufferMemoryBarrier.buffer              = buffer;
+	bufferMemoryBarrier.offset              = 0;
+	bufferMemoryBarrier.size                = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(
+			commandBuffer,
+			transfer.srcStageMask,
+			sameFamily ? transfer.dstStageMask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			1, &bufferMemoryBarrier,
+			0, nullptr
+		);
+
+}
+
+void acquireBufferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, const QueueOwnershipTransfer &transfer) {
+
+	if (transfer.srcFamilyIndex == transfer.dstFamilyIndex)
+		return;
+
+	VkBufferMemoryBarrier bufferMemoryBarrier = {};
+	bufferMemoryBarrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferMemoryBarrier.srcAccessMask       = 0;
+	bufferMemoryBarrier.dstAccessMask       = transfer.dstAccessMask;
+	bufferMemoryBarrier.srcQueueFamilyIndex = transfer.srcFamilyIndex;
+	bufferMemoryBarrier.dstQueueFamilyIndex = transfer.dstFamilyIndex;
+	bufferMemoryBarrier.buffer              = buffer;
+	bufferMemoryBarrier.offset              = 0;
+	bufferMemoryBarrier.size                = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			transfer.dstStageMask,
+			0,
+			0, nullptr,
+			1, &bufferMemoryBarrier,
+			0, nullptr
+		);
+
+}
+
+void releaseImageOwnership(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectMask, const QueueOwnershipTransfer &transfer) {
+
+	bool sameFamily = transfer.srcFamilyIndex == transfer.dstFamilyIndex;
+
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask       = transfer.srcAccessMask;
+	imageMemoryBarrier.dstAccessMask       = sameFamily ? transfer.dstAccessMask : 0;
+	imageMemoryBarrier.oldLayout           = transfer.oldLayout;
+	imageMemoryBarrier.newLayout           = transfer.newLayout;
+	imageMemoryBarrier.srcQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.srcFamilyIndex;
+	imageMemoryBarrier.dstQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : transfer.dstFamilyIndex;
+	imageMemoryBarrier.image               = image;
+	imageMemoryBarrier.subresourceRange = {
+		.aspectMask     = aspectMask,
+		.baseMipLevel   = 0,
+		.levelCount     = VK_REMAINING_MIP_LEVELS,
+		.baseArrayLayer = 0,
+		.layerCount     = VK_REMAINING_ARRAY_LAYERS
+	};
+
+	vkCmdPipelineBarrier(
+			commandBuffer,
+			transfer.srcStageMask,
+			sameFamily ? transfer.dstStageMask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageMemoryBarrier
+		);
+
+}
+
+void acquireImageOwnership(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspectMask, const QueueOwnershipTransfer &transfer) {
+
+	if (transfer.srcFamilyIndex == transfer.dstFamilyIndex)
+		return;
+
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask       = 0;
+	imageMemoryBarrier.dstAccessMask       = transfer.dstAccessMask;
+	imageMemoryBarrier.oldLayout           = transfer.oldLayout;
+	imageMemoryBarrier.newLayout           = transfer.newLayout;
+	imageMemoryBarrier.srcQueueFamilyIndex = transfer.srcFamilyIndex;
+	imageMemoryBarrier.dstQueueFamilyIndex = transfer.dstFamilyIndex;
+	imageMemoryBarrier.image               = image;
+	imageMemoryBarrier.subresourceRange = {
+		.aspectMask     = aspectMask,
+		.baseMipLevel   = 0,
+		.levelCount     = VK_REMAINING_MIP_LEVELS,
+		.baseArrayLayer = 0,
+		.layerCount     = VK_REMAINING_ARRAY_LAYERS
+	};
+
+	vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			transfer.dstStageMask,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageMemoryBarrier
+		);
+
+}
+
+VkImage createDepthBuffer() {
+
+	VkFormat depthFormat = selectDepthFormat();
+
+	createImage(
+			depthBuffer, depthBufferMemory,
+			swapchainExtent.width, swapchainExtent.height, depthFormat,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (occlusionCulling ? VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0),
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			1, 1, MEMORY_CATEGORY_TRANSIENT
+			);
+
+	vkBindImageMemory(logicalDevice, depthBuffer, depthBufferMemory, 0);
+
+	depthBufferView = createImageView(depthBuffer, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+	// the pyramid of the first frame is built before anything is drawn, so
+	// start from an empty depth buffer in the layout the render pass leaves
+	if (occlusionCulling)
+		clearDepthImage(depthBuffer, depthFormat, 1);
+	else
+		transitionImageLayout(depthBuffer, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+	return depthBuffer;
+}
+
+void createStagingRing() {
+
+	createBuffer(
+			stagingBuffer, stagingBufferMemory,
+			STAGING_RING_SIZE,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			MEMORY_CATEGORY_STAGING
+			);
+
+	// stays mapped for the lifetime of the ring
+	void *mapped;
+	vkMapMemory(logicalDevice, stagingBufferMemory, 0, STAGING_RING_SIZE, 0, &mapped);
+
+	stagingRing.init(stagingBuffer, mapped, STAGING_RING_SIZE);
+}
+
+/*
+ * Uploads are recorded on the transfer queue. Every resource they write is
+ * remembered so that, once the batch is finished, its ownership can be
+ * handed over to the graphics queue that will read it.
+ */
+struct PendingUpload {
+	VkBuffer buffer;	// one of buffer or image is set
+	VkImage image;
+	VkPipelineStageFlags dstStageMask;
+	VkAccessFlags dstAccessMask;
+};
+
+struct UploadBatch {
+	VkCommandBuffer commandBuffer;
+	std::vector<PendingUpload> uploads;
+};
+
+UploadBatch beginUploads() {
+
+	UploadBatch batch;
+	batch.commandBuffer = beginCommandRecording(transferCommandPool);
+
+	return batch;
+}
+
+/**
+ * submits the uploads recorded so far, waits for them and starts a new
+ * command buffer, freeing the whole staging ring. Ownership stays with the
+ * transfer queue since the batch may keep writing the same resources
+ */
+void flushUploads(UploadBatch &batch) {
+
+	PROFILE_FUNCTION();
+
+	endCommandRecording(batch.commandBuffer);
+	submitCommandBuffer(transferCommandPool, batch.commandBuffer, transferQueue);
+
+	stagingRing.reset();
+
+	batch.commandBuffer = beginCommandRecording(transferCommandPool);
+}
+
+/**
+ * releases everything the batch wrote to the queue that will use it, which
+ * acquires it after waiting on the transfer submission
+ */
+void finishUploads(UploadBatch &batch, VkQueue dstQueue, uint32_t dstFamilyIndex, VkCommandPool dstCommandPool) {
+
+	PROFILE_FUNCTION();
+
+	std::vector<QueueOwnershipTransfer> transfers;
+	VkPipelineStageFlags waitStageMask = 0;
+
+	for (const PendingUpload &upload : batch.uploads) {
+
+		QueueOwnershipTransfer transfer = {};
+		transfer.srcFamilyIndex = transferFamilyIndex;
+		transfer.dstFamilyIndex = dstFamilyIndex;
+		transfer.srcStageMask   = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		transfer.srcAccessMask  = VK_ACCESS_TRANSFER_WRITE_BIT;
+		transfer.dstStageMask   = upload.dstStageMask;
+		transfer.dstAccessMask  = upload.dstAccessMask;
+		transfer.oldLayout      = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		transfer.newLayout      = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		if (upload.buffer != VK_NULL_HANDLE)
+			releaseBufferOwnership(batch.commandBuffer, upload.buffer, transfer);
+		else
+			releaseImageOwnership(batch.commandBuffer, upload.image, VK_IMAGE_ASPECT_COLOR_BIT, transfer);
+
+		transfers.push_back(transfer);
+		waitStageMask |= upload.dstStageMask;
+	}
+
+	endCommandRecording(batch.commandBuffer);
+
+	if (transferFamilyIndex == dstFamilyIndex) {
+
+		// same queue: the release barriers already made everything visible
+		submitCommandBuffer(transferCommandPool, batch.commandBuffer, transferQueue);
+
+	} else {
+
+		VkSemaphoreCreateInfo semaphoreCI = {};
+		semaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		VkSemaphore uploadSemaphore;
+		vkCreateSemaphore(logicalDevice, &semaphoreCI, nullptr, &uploadSemaphore);
+
+		VkSubmitInfo releaseSubmitI = {};
+		releaseSubmitI.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		releaseSubmitI.commandBufferCount   = 1;
+		releaseSubmitI.pCommandBuffers      = &batch.commandBuffer;
+		releaseSubmitI.signalSemaphoreCount = 1;
+		releaseSubmitI.pSignalSemaphores    = &uploadSemaphore;
+
+		vkQueueSubmit(transferQueue, 1, &releaseSubmitI, VK_NULL_HANDLE);
+
+		VkCommandBuffer acquireCommandBuffer = beginCommandRecording(dstCommandPool);
+
+		for (uint32_t i = 0; i < batch.uploads.size(); i++) {
+			if (batch.uploads[i].buffer != VK_NULL_HANDLE)
+				acquireBufferOwnership(acquireCommandBuffer, batch.uploads[i].buffer, transfers[i]);
+			else
+				acquireImageOwnership(acquireCommandBuffer, batch.uploads[i].image, VK_IMAGE_ASPECT_COLOR_BIT, transfers[i]);
+		}
+
+		endCommandRecording(acquireCommandBuffer);
+
+		if (waitStageMask == 0)
+			waitStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+		VkSubmitInfo acquireSubmitI = {};
+		acquireSubmitI.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireSubmitI.waitSemaphoreCount = 1;
+		acquireSubmitI.pWaitSemaphores    = &uploadSemaphore;
+		acquireSubmitI.pWaitDstStageMask  = &waitStageMask;
+		acquireSubmitI.commandBufferCount = 1;
+		acquireSubmitI.pCommandBuffers    = &acquireCommandBuffer;
+
+		vkQueueSubmit(dstQueue, 1, &acquireSubmitI, VK_NULL_HANDLE);
+
+		// the destination queue waited on the transfer queue, so both are done
+		vkQueueWaitIdle(dstQueue);
+
+		vkFreeCommandBuffers(logicalDevice, transferCommandPool, 1, &batch.commandBuffer);
+		vkFreeCommandBuffers(logicalDevice, dstCommandPool, 1, &acquireCommandBuffer);
+		vkDestroySemaphore(logicalDevice, uploadSemaphore, nullptr);
+	}
+
+	stagingRing.reset();
+	batch.uploads.clear();
+}
+
+void finishUploads(UploadBatch &batch) {
+	finishUploads(batch, graphicsQueue, graphicsFamilyIndex, commandPool);
+}
+
+/**
+ * copies data into a device-local buffer through the staging ring, in pieces
+ * if it is larger than the ring. dstStageMask and dstAccessMask describe how
+ * the destination queue will read the buffer
+ */
+void stageBufferUpload(
+		UploadBatch &batch,
+		const void *data,
+		VkDeviceSize size,
+		VkBuffer dstBuffer,
+		VkDeviceSize dstOffset,
+		VkPipelineStageFlags dstStageMask,
+		VkAccessFlags dstAccessMask) {
+
+	const uint8_t *src = static_cast<const uint8_t *>(data);
+	const VkDeviceSize maxChunk = stagingRing.getCapacity() / 2;
+
+	while (size > 0) {
+
+		VkDeviceSize chunk = std::min(size, maxChunk);
+
+		if (!stagingRing.upload(batch.commandBuffer, src, chunk, dstBuffer, dstOffset)) {
+			flushUploads(batch);
+			continue;
+		}
+
+		src       += chunk;
+		size      -= chunk;
+		dstOffset += chunk;
+	}
+
+	bool pending = false;
+	for (const PendingUpload &upload : batch.uploads)
+		pending |= upload.buffer == dstBuffer;
+
+	if (!pending)
+		batch.uploads.push_back({ dstBuffer, VK_NULL_HANDLE, dstStageMask, dstAccessMask });
+}
+
+/**
+ * copies texels into mip 0 of a freshly created image, which ends up in
+ * SHADER_READ_ONLY_OPTIMAL once the batch is finished
+ */
+void stageImageUpload(UploadBatch &batch, const void *data, VkDeviceSize size, VkImage image, VkFormat format, uint32_t width, uint32_t height) {
+
+	if (size > stagingRing.getCapacity()) {
+		fputs("Texture is larger than the staging ring\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	VkDeviceSize offset;
+	void *dst = stagingRing.allocate(size, 16, offset);
+
+	if (!dst) {
+		flushUploads(batch);
+		dst = stagingRing.allocate(size, 16, offset);
+	}
+
+	memcpy(dst, data, size);
+
+	recordImageLayoutTransition(batch.commandBuffer, image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset      = offset;
+	region.bufferRowLength   = 0;	// tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource  = {
+		.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+		.mipLevel       = 0,
+		.baseArrayLayer = 0,
+		.layerCount     = 1
+	};
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+
+	vkCmdCopyBufferToImage(batch.commandBuffer, stagingRing.getBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	batch.uploads.push_back({ VK_NULL_HANDLE, image, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT });
+}
+
+/**
+ * allocates mesh's ranges in the geometry pool and stages its vertices and
+ * LOD indices into them, moving its offsets from the packed arrays it was
+ * imported into (of vertexCount vertices and indexCount indices) to the
+ * pool's. False if the mesh lies outside the arrays or the pool is full
+ */
+bool uploadMeshGeometry(UploadBatch &batch, Mesh &mesh, const void *vertices, uint64_t vertexCount, const void *indices, uint64_t indexCount) {
+
+	if (mesh.lodCount == 0 || mesh.lodCount > MAX_MESH_LODS || mesh.vertexOffset < 0)
+		return false;
+
+	// a mesh's LOD index lists are packed one after another
+	uint64_t firstIndex = mesh.lods[0].firstIndex;
+	uint64_t endIndex = 0;
+
+	for (uint32_t i = 0; i < mesh.lodCount; i++) {
+		firstIndex = std::min<uint64_t>(firstIndex, mesh.lods[i].firstIndex);
+		endIndex = std::max<uint64_t>(endIndex, static_cast<uint64_t>(mesh.lods[i].firstIndex) + mesh.lods[i].indexCount);
+	}
+
+	if (static_cast<uint64_t>(mesh.vertexOffset) + mesh.vertexCount > vertexCount || endIndex > indexCount)
+		return false;
+
+	GeometryAllocation allocation;
+
+	if (!geometry.pool.allocate(mesh.vertexCount, static_cast<uint32_t>(endIndex - firstIndex), allocation))
+		return false;
+
+	stageBufferUpload(
+			batch,
+			static_cast<const uint8_t *>(vertices) + sizeof(Vertex) * mesh.vertexOffset,
+			sizeof(Vertex) * static_cast<VkDeviceSize>(allocation.vertexCount),
+			geometry.vertexBuffer, sizeof(Vertex) * static_cast<VkDeviceSize>(allocation.vertexOffset),
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+	stageBufferUpload(
+			batch,
+			static_cast<const uint8_t *>(indices) + sizeof(uint32_t) * firstIndex,
+			sizeof(uint32_t) * static_cast<VkDeviceSize>(allocation.indexCount),
+			geometry.indexBuffer, sizeof(uint32_t) * static_cast<VkDeviceSize>(allocation.firstIndex),
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+
+	// indices stay relative to the mesh's first vertex
+	for (uint32_t i = 0; i < mesh.lodCount; i++)
+		mesh.lods[i].firstIndex = mesh.lods[i].firstIndex - static_cast<uint32_t>(firstIndex) + allocation.firstIndex;
+
+	mesh.vertexOffset = static_cast<int32_t>(allocation.vertexOffset);
+
+	return true;
+}
+
+/**
+ * creates the geometry pool and uploads every mesh of the in-memory scene
+ * geometry into it
+ */
+void uploadSceneGeometry() {
+
+	PROFILE_FUNCTION();
+
+	createGeometryPool(
+			static_cast<uint32_t>(sceneVertices.size()) + GEOMETRY_POOL_VERTEX_HEADROOM,
+			static_cast<uint32_t>(sceneIndices.size()) + GEOMETRY_POOL_INDEX_HEADROOM);
+
+	UploadBatch batch = beginUploads();
+
+	for (uint32_t i = 0; i < meshes.size(); i++) {
+		if (!uploadMeshGeometry(batch, meshes[i], sceneVertices.data(), sceneVertices.size(), sceneIndices.data(), sceneIndices.size())) {
+			fprintf(stderr, "Could not place mesh %u in the geometry pool\n", i);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	finishUploads(batch);
+}
+
+/**
+ * maps a cooked asset and checks its sections; the mapping is read ahead in
+ * the background, so this runs early and uploadAsset copies it later
+ */
+bool decodeAsset(const char *path) {
+
+	PROFILE_FUNCTION();
+
+	if (!sceneAsset.open(path))
+		return false;
+
+	// open has checked every table against its section, and what the meshes
+	// and textures point at
+	uint32_t vertexCount, indexCount;
+
+	sceneAsset.getSection(ASSET_SECTION_VERTICES, nullptr, &vertexCount);
+	sceneAsset.getSection(ASSET_SECTION_INDICES, nullptr, &indexCount);
+
+	if (vertexCount == 0 || indexCount == 0) {
+		fprintf(stderr, "Asset %s contains no geometry\n", path);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < sceneAsset.getMeshCount(); i++)
+		meshes.push_back(sceneAsset.getMesh(i));
+
+	return true;
+}
+
+/**
+ * copies the decoded asset's sections straight into the staging ring, each
+ * mesh into its ranges of the geometry pool; the vertex and index payloads
+ * are already in GPU layout
+ */
+void uploadAsset() {
+
+	PROFILE_FUNCTION();
+
+	uint32_t vertexCount, indexCount, textureCount;
+
+	const void *vertexData = sceneAsset.getSection(ASSET_SECTION_VERTICES, nullptr, &vertexCount);
+	const void *indexData = sceneAsset.getSection(ASSET_SECTION_INDICES, nullptr, &indexCount);
+	const AssetTexture *assetTextures = static_cast<const AssetTexture *>(sceneAsset.getSection(ASSET_SECTION_TEXTURES, nullptr, &textureCount));
+	const uint8_t *textureData = static_cast<const uint8_t *>(sceneAsset.getSection(ASSET_SECTION_TEXTURE_DATA, nullptr));
+
+	createGeometryPool(vertexCount + GEOMETRY_POOL_VERTEX_HEADROOM, indexCount + GEOMETRY_POOL_INDEX_HEADROOM);
+
+	UploadBatch batch = beginUploads();
+
+	for (uint32_t i = 0; i < meshes.size(); i++) {
+		if (!uploadMeshGeometry(batch, meshes[i], vertexData, vertexCount, indexData, indexCount)) {
+			fprintf(stderr, "Could not place mesh %u of the asset in the geometry pool\n", i);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (uint32_t i = 0; i < textureCount; i++) {
+
+		const AssetTexture &assetTexture = assetTextures[i];
+		VkFormat format = static_cast<VkFormat>(assetTexture.format);
+
+		Texture texture;
+
+		createImage(
+				texture.image, texture.memory,
+				assetTexture.width, assetTexture.height, format,
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+				);
+
+		vkBindImageMemory(logicalDevice, texture.image, texture.memory, 0);
+
+		stageImageUpload(batch, textureData + assetTexture.dataOffset, assetTexture.dataSize, texture.image, format, assetTexture.width, assetTexture.height);
+
+		texture.view = createImageView(texture.image, format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		textures.push_back(texture);
+	}
+
+	finishUploads(batch);
+
+	sceneAsset.close();
+}
+
+VkRenderPass createRenderPass() {
+
+	VkAttachmentDescription colorAttachment = {};
+	colorAttachment.format         = swapchainFormat.format;
+	colorAttachment.samples        = VK_SAMPLE_COUNT_1_BIT;	// TODO : multisampling
+	colorAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+	colorAttachment.finalLayout    = resolution.enabled ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkAttachmentReference colorAttachmentReference = {};
+	colorAttachmentReference.attachment = 0;
+	colorAttachmentReference.layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentDescription depthAttachment = {};
+	depthAttachment.format         = selectDepthFormat();
+	depthAttachment.samples        = VK_SAMPLE_COUNT_1_BIT;	// TODO : multisampling
+	depthAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	// the next frame builds its occlusion pyramid from this frame's depth
+	if (occlusionCulling) {
+		depthAttachment.storeOp     = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	}
+
+	VkAttachmentReference depthAttachmentReference = {};
+	depthAttachmentReference.attachment = 1;
+	depthAttachmentReference.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	std::array<VkAttachmentDescription, 2> attachments = {
+		colorAttachment, depthAttachment
+	};
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount    = 1;
 	subpassDescription.pColorAttachments       = &colorAttachmentReference;
 	subpassDescription.pDepthStencilAttachment = &depthAttachmentReference;
 
-	VkSubpassDependency subpassDependency = {};
-	subpassDependency.srcSubpass      = VK_SUBPASS_EXTERNAL;
-	subpassDependency.dstSubpass      = 0;
-	subpassDependency.srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependency.dstStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependency.srcAccessMask   = 0;
-	subpassDependency.dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	subpassDependency.dependencyFlags = 0;
+	std::vector<VkSubpassDependency> subpassDependencies(1);
+	subpassDependencies[0].srcSubpass      = VK_SUBPASS_EXTERNAL;
+	subpassDependencies[0].dstSubpass      = 0;
+	subpassDependencies[0].srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	subpassDependencies[0].dstStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	subpassDependencies[0].srcAccessMask   = 0;
+	subpassDependencies[0].dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	subpassDependencies[0].dependencyFlags = 0;
+
+	if (occlusionCulling) {
+
+		// the depth buffer is cleared only once the pyramid pass is done reading it
+		subpassDependencies[0].srcStageMask  |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		subpassDependencies[0].dstStageMask  |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		subpassDependencies[0].dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// and read by it once every depth write has landed
+		VkSubpassDependency depthReadDependency = {};
+		depthReadDependency.srcSubpass    = 0;
+		depthReadDependency.dstSubpass    = VK_SUBPASS_EXTERNAL;
+		depthReadDependency.srcStageMask  = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		depthReadDependency.dstStageMask  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		depthReadDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthReadDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		subpassDependencies.push_back(depthReadDependency);
+	}
+
+	if (resolution.enabled) {
+
+		// the scene target is overwritten once the previous frame's upscale is done reading it
+		subpassDependencies[0].srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		// and this frame's upscale reads it once every colour write has landed
+		VkSubpassDependency upscaleDependency = {};
+		upscaleDependency.srcSubpass    = 0;
+		upscaleDependency.dstSubpass    = VK_SUBPASS_EXTERNAL;
+		upscaleDependency.srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		upscaleDependency.dstStageMask  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		upscaleDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		upscaleDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		subpassDependencies.push_back(upscaleDependency);
+	}
+
+	VkRenderPassCreateInfo renderpassCI = {};
+	renderpassCI.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderpassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderpassCI.pAttachments    = attachments.data();
+	renderpassCI.subpassCount    = 1;
+	renderpassCI.pSubpasses      = &subpassDescription;
+	renderpassCI.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
+	renderpassCI.pDependencies   = subpassDependencies.data();
+
+	VkRenderPass renderpass;
+
+	if (vkCreateRenderPass(logicalDevice, &renderpassCI, nullptr, &renderpass) != VK_SUCCESS) {
+		fputs("Unable to create render pass\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	return renderpass;
+}
+
+std::vector<VkFramebuffer> createFramebuffers() {
+
+	std::vector<VkFramebuffer> swapchainFramebuffers(swapchainImageViews.size());
+
+	for (uint32_t i = 0; i < swapchainFramebuffers.size(); i++) {
+
+		// with dynamic resolution every image renders to the one scene target
+		std::array<VkImageView, 2> framebufferAttachments = {
+			resolution.enabled ? resolution.sceneColorView : swapchainImageViews[i], depthBufferView
+		};
+
+		VkFramebufferCreateInfo framebufferCI = {};
+		framebufferCI.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferCI.renderPass      = renderpass;
+		framebufferCI.attachmentCount = static_cast<uint32_t>(framebufferAttachments.size());
+		framebufferCI.pAttachments    = framebufferAttachments.data();
+		framebufferCI.width           = swapchainExtent.width;
+		framebufferCI.height          = swapchainExtent.height;
+		framebufferCI.layers          = 1;
+
+		if (vkCreateFramebuffer(logicalDevice, &framebufferCI, nullptr, &swapchainFramebuffers[i]) != VK_SUCCESS) {
+			fputs("Unable to create framebuffer\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+
+	}
+
+	return swapchainFramebuffers;
+}
+
+/**
+ * reads a whole file into contents
+ */
+bool readFile(const std::string &filename, std::string &contents) {
+
+	std::ifstream file(filename, std::ios::binary);
+
+	if (!file.is_open())
+		return false;
+
+	file.seekg(0, std::ios::end);
+	size_t length = file.tellg();
+
+	file.seekg(0);
+
+	contents.assign(length, '\0');
+	file.read(contents.data(), length);
+
+	return true;
+}
+
+/**
+ * reads every SPIR-V binary up front, so pipeline creation does no file I/O
+ */
+void loadSpirvBinaries() {
+
+	PROFILE_FUNCTION();
+
+	// the shader build lists every binary it wrote, variants included
+	for (const std::string &name : shaderManifest.getNames()) {
+
+		std::string filename = "spirv/" + name;
+		std::string code;
+
+		// a missing binary is reported when a pipeline asks for it
+		if (readFile(filename, code))
+			spirvBinaries[filename] = std::move(code);
+	}
+
+}
+
+VkShaderModule createShaderModule(const std::string filename) {
+
+	// loadSpirvBinaries has finished before any pipeline is created, so
+	// the cache is only read here
+	auto cached = spirvBinaries.find(filename);
+	std::string uncached;
+
+	if (cached == spirvBinaries.end() && !readFile(filename, uncached)) {
+		fprintf(stderr, "Could not open file %s\n", filename.c_str());
+		return nullptr;
+	}
+
+	const std::string &source = cached != spirvBinaries.end() ? cached->second : uncached;
+
+	VkShaderModuleCreateInfo shaderModuleCI = {};
+	shaderModuleCI.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCI.codeSize = source.length();
+	shaderModuleCI.pCode    = reinterpret_cast<const uint32_t *>(source.data());
+
+	VkShaderModule shaderModule;
+
+	if (vkCreateShaderModule(logicalDevice, &shaderModuleCI, nullptr, &shaderModule) != VK_SUCCESS) {
+		fprintf(stderr, "Could not create shader module for %s\n", filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	return shaderModule;
+}
+
+/**
+ * compares the layout a pipeline is about to be built with against the one
+ * reflected from one of its shaders: the shader must be for stage, every
+ * binding it uses must be in set 0 with the same type and visible to stage,
+ * and a push constant range for stage must cover its block. Bindings and
+ * push constants the shader does not use are allowed, since the optimiser
+ * may have removed them
+ */
+void checkShaderLayout(
+		const std::string &spirvPath,
+		VkShaderStageFlagBits stage,
+		const VkDescriptorSetLayoutBinding *bindings,
+		uint32_t bindingCount,
+		const VkPushConstantRange *pushConstantRanges,
+		uint32_t pushConstantRangeCount) {
+
+	static const VkShaderStageFlagBits stageBits[SHADER_STAGE_COUNT] = {
+		VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT, VK_SHADER_STAGE_COMPUTE_BIT
+	};
+
+	static const VkDescriptorType descriptorTypes[SHADER_BINDING_TYPE_COUNT] = {
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+	};
+
+	std::string name = spirvPath.substr(spirvPath.find_last_of('/') + 1);
+	const ShaderLayout *layout = shaderManifest.find(name);
+
+	if (!layout) {
+		fprintf(stderr, "%s is not in the shader manifest\n", spirvPath.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	if (stageBits[layout->stage] != stage) {
+		fprintf(stderr, "%s is built for another shader stage\n", spirvPath.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint32_t i = 0; i < layout->bindingCount; i++) {
+
+		const ShaderBinding &binding = layout->bindings[i];
+		const VkDescriptorSetLayoutBinding *match = nullptr;
+
+		for (uint32_t b = 0; b < bindingCount; b++) {
+			if (bindings[b].binding == binding.binding)
+				match = &bindings[b];
+		}
+
+		if (!match || match->descriptorType != descriptorTypes[binding.type] || !(match->stageFlags & stage)) {
+			fprintf(stderr, "Pipeline layout for %s does not match binding %u of the shader\n", spirvPath.c_str(), binding.binding);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (layout->pushConstantSize == 0)
+		return;
+
+	for (uint32_t i = 0; i < pushConstantRangeCount; i++) {
+
+		const VkPushConstantRange &range = pushConstantRanges[i];
+
+		// blocks start at offset 0 in every shader here
+		if ((range.stageFlags & stage) && range.offset == 0 && range.size >= layout->pushConstantSize)
+			return;
+	}
+
+	fprintf(stderr, "%s has %u bytes of push constants the pipeline layout does not cover\n", spirvPath.c_str(), layout->pushConstantSize);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * targets a pipeline at the main pass: its render pass, or on the 1.3 path the
+ * attachment formats in renderingCI, which must outlive pipeline creation
+ */
+void setMainPassTarget(VkGraphicsPipelineCreateInfo &graphicsPipelineCI, VkPipelineRenderingCreateInfo &renderingCI) {
+
+	if (!dynamicRenderingEnabled) {
+		graphicsPipelineCI.renderPass = renderpass;
+		return;
+	}
+
+	renderingCI = {};
+	renderingCI.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	renderingCI.colorAttachmentCount    = 1;
+	renderingCI.pColorAttachmentFormats = &swapchainFormat.format;
+	renderingCI.depthAttachmentFormat   = selectDepthFormat();
+	renderingCI.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+	graphicsPipelineCI.pNext      = &renderingCI;
+	graphicsPipelineCI.renderPass = VK_NULL_HANDLE;
+
+	if (shadingRate.attachmentRate)
+		graphicsPipelineCI.flags |= VK_PIPELINE_CREATE_RENDERING_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR;
+}
+
+/**
+ * gives a main pass pipeline its own shading rate, combined with the
+ * attachment rate and, if its vertex shader writes one, the primitive rate;
+ * shadingRateCI must outlive pipeline creation. Nothing without variable-rate
+ * shading
+ */
+void setPipelineShadingRate(VkGraphicsPipelineCreateInfo &graphicsPipelineCI, VkPipelineFragmentShadingRateStateCreateInfoKHR &shadingRateCI, VkExtent2D fragmentSize, bool primitiveRate = false) {
+
+	if (!shadingRate.enabled)
+		return;
+
+	shadingRateCI = {};
+	shadingRateCI.sType          = VK_STRUCTURE_TYPE_PIPELINE_FRAGMENT_SHADING_RATE_STATE_CREATE_INFO_KHR;
+	shadingRateCI.pNext          = graphicsPipelineCI.pNext;
+	shadingRateCI.fragmentSize   = fragmentSize;
+	shadingRateCI.combinerOps[0] = primitiveRate ? shadingRate.combinerOp : VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+	shadingRateCI.combinerOps[1] = shadingRate.attachmentRate ? shadingRate.combinerOp : VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR;
+
+	graphicsPipelineCI.pNext = &shadingRateCI;
+}
+
+// TODO : overloads for different e.g. geometry, etc. shaders?
+VkPipeline createGraphicsPipeline(const std::string vertexShaderPath, const std::string fragmentShaderPath) {
+
+	PROFILE_FUNCTION();
+
+	VkShaderModule vertexShaderModule = createShaderModule(vertexShaderPath);
+	VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderPath);
+
+	VkPipelineShaderStageCreateInfo vertShaderStageCI = {};
+	vertShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertShaderStageCI.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertShaderStageCI.module = vertexShaderModule;
+	vertShaderStageCI.pName = "main";
+
+	VkPipelineShaderStageCreateInfo fragShaderStageCI = {};
+	fragShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragShaderStageCI.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragShaderStageCI.module = fragmentShaderModule;
+	fragShaderStageCI.pName = "main";
+
+	VkPipelineShaderStageCreateInfo shaderStages[] = {
+		vertShaderStageCI, fragShaderStageCI
+	};
+
+	VkVertexInputBindingDescription vertexInputBindingDescription = Vertex::getInputBindingDescription();
+	std::array<VkVertexInputAttributeDescription, Vertex::attributeCount> vertexInputAttributeDescriptions = Vertex::getAttributeDescriptions();
+	
+	VkPipelineVertexInputStateCreateInfo vertexInputStateCI = {};
+	vertexInputStateCI.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputStateCI.vertexBindingDescriptionCount   = 1;
+	vertexInputStateCI.pVertexBindingDescriptions      = &vertexInputBindingDescription;
+	vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributeDescriptions.size());
+	vertexInputStateCI.pVertexAttributeDescriptions    = vertexInputAttributeDescriptions.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = {};
+	inputAssemblyStateCI.sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyStateCI.topology               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssemblyStateCI.primitiveRestartEnable = VK_FALSE;
+
+	// viewport and scissor are set when recording so the pipeline survives swapchain recreation
+	VkPipelineViewportStateCreateInfo viewportStateCI = {};
+	viewportStateCI.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportStateCI.viewportCount = 1;
+	viewportStateCI.pViewports    = nullptr;
+	viewportStateCI.scissorCount  = 1;
+	viewportStateCI.pScissors     = nullptr;
+
+	std::array<VkDynamicState, 2> dynamicStates = {
+		VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicStateCI = {};
+	dynamicStateCI.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicStateCI.pDynamicStates    = dynamicStates.data();
+
+	VkPipelineRasterizationStateCreateInfo rasterizationStateCI = {};
+	rasterizationStateCI.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationStateCI.depthClampEnable        = VK_FALSE;
+	rasterizationStateCI.rasterizerDiscardEnable = VK_FALSE;
+	rasterizationStateCI.polygonMode             = VK_POLYGON_MODE_FILL;
+	rasterizationStateCI.cullMode                = VK_CULL_MODE_BACK_BIT;
+	rasterizationStateCI.frontFace               = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizationStateCI.depthBiasEnable         = VK_FALSE;
+	rasterizationStateCI.lineWidth               = 1.0f;
+
+	// TODO : detect multisampling support and implement
+	VkPipelineMultisampleStateCreateInfo multisampleStateCI = {};
+	multisampleStateCI.sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleStateCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampleStateCI.sampleShadingEnable  = VK_FALSE;
+	multisampleStateCI.minSampleShading     = 1.0f;
+
+	// after a depth pre-pass only the nearest fragment of each pixel passes
+	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = {};
+	depthStencilStateCI.sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilStateCI.depthTestEnable       = VK_TRUE;
+	depthStencilStateCI.depthWriteEnable      = depthPrepass ? VK_FALSE : VK_TRUE;
+	depthStencilStateCI.depthCompareOp        = depthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+	depthStencilStateCI.depthBoundsTestEnable = VK_FALSE;
+	depthStencilStateCI.stencilTestEnable     = VK_FALSE;
+	depthStencilStateCI.minDepthBounds        = 0.0f;
+	depthStencilStateCI.maxDepthBounds        = 1.0f;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendStateCI = {};
+	colorBlendStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendStateCI.logicOpEnable = VK_FALSE;
+	colorBlendStateCI.logicOp = VK_LOGIC_OP_COPY;
+	colorBlendStateCI.attachmentCount = 1;
+	colorBlendStateCI.pAttachments = &colorBlendAttachment;
+	colorBlendStateCI.blendConstants[0] = 0.0f;
+	colorBlendStateCI.blendConstants[1] = 0.0f;
+	colorBlendStateCI.blendConstants[2] = 0.0f;
+	colorBlendStateCI.blendConstants[3] = 0.0f;
+
+	std::array<VkDescriptorSetLayoutBinding, 7> bindings = getSceneDescriptorBindings();
+	VkPushConstantRange pushConstantRange = getScenePushConstantRange();
+
+	checkShaderLayout(vertexShaderPath, VK_SHADER_STAGE_VERTEX_BIT, bindings.data(), static_cast<uint32_t>(bindings.size()), &pushConstantRange, 1);
+	checkShaderLayout(fragmentShaderPath, VK_SHADER_STAGE_FRAGMENT_BIT, bindings.data(), static_cast<uint32_t>(bindings.size()), &pushConstantRange, 1);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = {};
+	pipelineLayoutCI.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCI.setLayoutCount         = 1;
+	pipelineLayoutCI.pSetLayouts            = &descriptorSetLayout;
+	pipelineLayoutCI.pushConstantRangeCount = 1;
+	pipelineLayoutCI.pPushConstantRanges    = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		fputs("Could not create pipeline layout\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	VkGraphicsPipelineCreateInfo graphicsPipelineCI = {};
+	graphicsPipelineCI.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphicsPipelineCI.stageCount          = 2;
+	graphicsPipelineCI.pStages             = shaderStages;
+	graphicsPipelineCI.pVertexInputState   = &vertexInputStateCI;
+	graphicsPipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+	graphicsPipelineCI.pViewportState      = &viewportStateCI;
+	graphicsPipelineCI.pRasterizationState = &rasterizationStateCI;
+	graphicsPipelineCI.pMultisampleState   = &multisampleStateCI;
+	graphicsPipelineCI.pDepthStencilState  = &depthStencilStateCI;
+	graphicsPipelineCI.pColorBlendState    = &colorBlendStateCI;
+	graphicsPipelineCI.pDynamicState       = &dynamicStateCI;
+	graphicsPipelineCI.layout              = pipelineLayout;
+
+	VkPipelineRenderingCreateInfo renderingCI;
+	setMainPassTarget(graphicsPipelineCI, renderingCI);
+
+	VkPipelineFragmentShadingRateStateCreateInfoKHR shadingRateCI;
+	setPipelineShadingRate(graphicsPipelineCI, shadingRateCI, { 1, 1 }, shadingRate.primitiveRate);
+
+	VkPipeline graphicsPipeline;
+
+	if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCI, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+		fputs("Could not create graphics pipeline\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
+	vkDestroyShaderModule(logicalDevice, fragmentShaderModule, nullptr);
+
+	return graphicsPipeline;
+}
+
+/**
+ * position-only pipeline of the depth pre-pass, in the main subpass with
+ * colour writes off; it shares the main pipeline's layout
+ */
+VkPipeline createDepthPrepassPipeline() {
+
+	PROFILE_FUNCTION();
+
+	std::array<VkDescriptorSetLayoutBinding, 7> bindings = getSceneDescriptorBindings();
+	VkPushConstantRange pushConstantRange = getScenePushConstantRange();
+
+	checkShaderLayout("spirv/depth.vert", VK_SHADER_STAGE_VERTEX_BIT, bindings.data(), static_cast<uint32_t>(bindings.size()), &pushConstantRange, 1);
+
+	VkShaderModule vertexShaderModule = createShaderModule("spirv/depth.vert");
+
+	VkPipelineShaderStageCreateInfo vertShaderStageCI = {};
+	vertShaderStageCI.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertShaderStageCI.stage  = VK_SHADER_STAGE_VERTEX_BIT;
+	vertShaderStageCI.module = vertexShaderModule;
+	vertShaderStageCI.pName  = "main";
+
+	VkVertexInputBindingDescription vertexInputBindingDescription = Vertex::getInputBindingDescription();
+	VkVertexInputAttributeDescription vertexInputAttributeDescription = Vertex::getPositionAttributeDescription();
+
+	VkPipelineVertexInputStateCreateInfo vertexInputStateCI = {};
+	vertexInputStateCI.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputStateCI.vertexBindingDescriptionCount   = 1;
+	vertexInputStateCI.pVertexBindingDescriptions      = &vertexInputBindingDescription;
+	vertexInputStateCI.vertexAttributeDescriptionCount = 1;
+	vertexInputStateCI.pVertexAttributeDescriptions    = &vertexInputAttributeDescription;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = {};
+	inputAssemblyStateCI.sType    = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyStateCI.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewportStateCI = {};
+	viewportStateCI.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportStateCI.viewportCount = 1;
+	viewportStateCI.scissorCount  = 1;
+
+	std::array<VkDynamicState, 2> dynamicStates = {
+		VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicStateCI = {};
+	dynamicStateCI.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicStateCI.pDynamicStates    = dynamicStates.data();
+
+	// must rasterise exactly as the main pipeline does
+	VkPipelineRasterizationStateCreateInfo rasterizationStateCI = {};
+	rasterizationStateCI.sType       = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationStateCI.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizationStateCI.cullMode    = VK_CULL_MODE_BACK_BIT;
+	rasterizationStateCI.frontFace   = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizationStateCI.lineWidth   = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisampleStateCI = {};
+	multisampleStateCI.sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleStateCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = {};
+	depthStencilStateCI.sType            = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilStateCI.depthTestEnable  = VK_TRUE;
+	depthStencilStateCI.depthWriteEnable = VK_TRUE;
+	depthStencilStateCI.depthCompareOp   = VK_COMPARE_OP_LESS;
+	depthStencilStateCI.maxDepthBounds   = 1.0f;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = 0;
+	colorBlendAttachment.blendEnable    = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendStateCI = {};
+	colorBlendStateCI.sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendStateCI.attachmentCount = 1;
+	colorBlendStateCI.pAttachments    = &colorBlendAttachment;
+
+	VkGraphicsPipelineCreateInfo graphicsPipelineCI = {};
+	graphicsPipelineCI.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphicsPipelineCI.stageCount          = 1;
+	graphicsPipelineCI.pStages             = &vertShaderStageCI;
+	graphicsPipelineCI.pVertexInputState   = &vertexInputStateCI;
+	graphicsPipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+	graphicsPipelineCI.pViewportState      = &viewportStateCI;
+	graphicsPipelineCI.pRasterizationState = &rasterizationStateCI;
+	graphicsPipelineCI.pMultisampleState   = &multisampleStateCI;
+	graphicsPipelineCI.pDepthStencilState  = &depthStencilStateCI;
+	graphicsPipelineCI.pColorBlendState    = &colorBlendStateCI;
+	graphicsPipelineCI.pDynamicState       = &dynamicStateCI;
+	graphicsPipelineCI.layout              = pipelineLayout;
+
+	VkPipelineRenderingCreateInfo renderingCI;
+	setMainPassTarget(graphicsPipelineCI, renderingCI);
+
+	VkPipelineFragmentShadingRateStateCreateInfoKHR shadingRateCI;
+	setPipelineShadingRate(graphicsPipelineCI, shadingRateCI, { 1, 1 });
+
+	VkPipeline pipeline;
+
+	if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCI, nullptr, &pipeline) != VK_SUCCESS) {
+		fputs("Could not create depth pre-pass pipeline\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
+
+	return pipeline;
+}
+
+/**
+ * depth-only render pass writing every cascade at once through multiview,
+ * leaving the map ready to be sampled
+ */
+VkRenderPass createShadowRenderPass() {
+
+	VkAttachmentDescription depthAttachment = {};
+	depthAttachment.format         = shadows.format;
+	depthAttachment.samples        = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentReference = {};
+	depthAttachmentReference.attachment = 0;
+	depthAttachmentReference.layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount    = 0;
+	subpassDescription.pDepthStencilAttachment = &depthAttachmentReference;
+
+	std::array<VkSubpassDependency, 2> subpassDependencies = {};
+
+	// the previous frame's lighting must be done sampling the map
+	subpassDependencies[0].srcSubpass    = VK_SUBPASS_EXTERNAL;
+	subpassDependencies[0].dstSubpass    = 0;
+	subpassDependencies[0].srcStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	subpassDependencies[0].dstStageMask  = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	subpassDependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	subpassDependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	// and this frame's lighting must wait for it to be written
+	subpassDependencies[1].srcSubpass    = 0;
+	subpassDependencies[1].dstSubpass    = VK_SUBPASS_EXTERNAL;
+	subpassDependencies[1].srcStageMask  = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	subpassDependencies[1].dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	subpassDependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	subpassDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	// one view per cascade, all seeing the same geometry
+	uint32_t viewMask = (1u << SHADOW_CASCADE_COUNT) - 1;
+
+	VkRenderPassMultiviewCreateInfoKHR renderpassMultiviewCI = {};
+	renderpassMultiviewCI.sType                = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO_KHR;
+	renderpassMultiviewCI.subpassCount         = 1;
+	renderpassMultiviewCI.pViewMasks           = &viewMask;
+	renderpassMultiviewCI.correlationMaskCount = 1;
+	renderpassMultiviewCI.pCorrelationMasks    = &viewMask;
+
+	VkRenderPassCreateInfo renderpassCI = {};
+	renderpassCI.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderpassCI.pNext           = &renderpassMultiviewCI;
+	renderpassCI.attachmentCount = 1;
+	renderpassCI.pAttachments    = &depthAttachment;
+	renderpassCI.subpassCount    = 1;
+	renderpassCI.pSubpasses      = &subpassDescription;
+	renderpassCI.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
+	renderpassCI.pDependencies   = subpassDependencies.data();
+
+	VkRenderPass renderpass;
+
+	if (vkCreateRenderPass(logicalDevice, &renderpassCI, nullptr, &renderpass) != VK_SUCCESS) {
+		fputs("Unable to create shadow render pass\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	return renderpass;
+}
+
+/**
+ * position-only depth pipeline for the shadow pass. Fetching just the
+ * position keeps the vertex cost of rendering all cascades low
+ */
+void createShadowPipeline() {
+
+	PROFILE_FUNCTION();
+
+	VkDescriptorSetLayoutBinding descriptorSetLayoutBinding = {};
+	descriptorSetLayoutBinding.binding         = 0;
+	descriptorSetLayoutBinding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorSetLayoutBinding.descriptorCount = 1;
+	descriptorSetLayoutBinding.stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = {};
+	descriptorSetLayoutCI.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorSetLayoutCI.bindingCount = 1;
+	descriptorSetLayoutCI.pBindings    = &descriptorSetLayoutBinding;
+
+	if (vkCreateDescriptorSetLayout(logicalDevice, &descriptorSetLayoutCI, nullptr, &shadows.descriptorSetLayout) != VK_SUCCESS) {
+		fputs("Failed to create shadow descriptor set layout\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorPoolSize descriptorPoolSize = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 };
+
+	VkDescriptorPoolCreateInfo descriptorPoolCI = {};
+	descriptorPoolCI.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCI.maxSets       = 1;
+	descriptorPoolCI.poolSizeCount = 1;
+	descriptorPoolCI.pPoolSizes    = &descriptorPoolSize;
+
+	if (vkCreateDescriptorPool(logicalDevice, &descriptorPoolCI, nullptr, &shadows.descriptorPool) != VK_SUCCESS) {
+		fputs("Failed to create shadow descriptor pool\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorSetAllocateInfo descriptorSetAI = {};
+	descriptorSetAI.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAI.descriptorPool     = shadows.descriptorPool;
+	descriptorSetAI.descriptorSetCount = 1;
+	descriptorSetAI.pSetLayouts        = &shadows.descriptorSetLayout;
+
+	if (vkAllocateDescriptorSets(logicalDevice, &descriptorSetAI, &shadows.descriptorSet) != VK_SUCCESS) {
+		fputs("Could not allocate shadow descriptor set\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorBufferInfo descriptorBufferI = {};
+	descriptorBufferI.buffer = shadows.paramsBuffer;
+	descriptorBufferI.offset = 0;
+	descriptorBufferI.range  = sizeof(ShadowParams);
+
+	VkWriteDescriptorSet writeDescriptorSet = {};
+	writeDescriptorSet.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writeDescriptorSet.dstSet          = shadows.descriptorSet;
+	writeDescriptorSet.dstBinding      = 0;
+	writeDescriptorSet.descriptorCount = 1;
+	writeDescriptorSet.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	writeDescriptorSet.pBufferInfo     = &descriptorBufferI;
+
+	vkUpdateDescriptorSets(logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = {};
+	pipelineLayoutCI.sType          = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCI.setLayoutCount = 1;
+	pipelineLayoutCI.pSetLayouts    = &shadows.descriptorSetLayout;
+
+	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr, &shadows.pipelineLayout) != VK_SUCCESS) {
+		fputs("Could not create shadow pipeline layout\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	checkShaderLayout("spirv/shadow.vert", VK_SHADER_STAGE_VERTEX_BIT, &descriptorSetLayoutBinding, 1, nullptr, 0);
+
+	VkShaderModule vertexShaderModule = createShaderModule("spirv/shadow.vert");
+
+	// no fragment shader, only depth is written
+	VkPipelineShaderStageCreateInfo vertShaderStageCI = {};
+	vertShaderStageCI.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertShaderStageCI.stage  = VK_SHADER_STAGE_VERTEX_BIT;
+	vertShaderStageCI.module = vertexShaderModule;
+	vertShaderStageCI.pName  = "main";
+
+	VkVertexInputBindingDescription vertexInputBindingDescription = Vertex::getInputBindingDescription();
+	VkVertexInputAttributeDescription vertexInputAttributeDescription = Vertex::getPositionAttributeDescription();
+
+	VkPipelineVertexInputStateCreateInfo vertexInputStateCI = {};
+	vertexInputStateCI.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputStateCI.vertexBindingDescriptionCount   = 1;
+	vertexInputStateCI.pVertexBindingDescriptions      = &vertexInputBindingDescription;
+	vertexInputStateCI.vertexAttributeDescriptionCount = 1;
+	vertexInputStateCI.pVertexAttributeDescriptions    = &vertexInputAttributeDescription;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = {};
+	inputAssemblyStateCI.sType    = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyStateCI.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkViewport viewport = {};
+	viewport.width    = SHADOW_MAP_SIZE;
+	viewport.height   = SHADOW_MAP_SIZE;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE };
+
+	VkPipelineViewportStateCreateInfo viewportStateCI = {};
+	viewportStateCI.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportStateCI.viewportCount = 1;
+	viewportStateCI.pViewports    = &viewport;
+	viewportStateCI.scissorCount  = 1;
+	viewportStateCI.pScissors     = &scissor;
+
+	// both faces cast, and the bias keeps surfaces from shadowing themselves
+	VkPipelineRasterizationStateCreateInfo rasterizationStateCI = {};
+	rasterizationStateCI.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationStateCI.polygonMode             = VK_POLYGON_MODE_FILL;
+	rasterizationStateCI.cullMode                = VK_CULL_MODE_NONE;
+	rasterizationStateCI.frontFace               = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizationStateCI.depthBiasEnable         = VK_TRUE;
+	rasterizationStateCI.depthBiasConstantFactor = 1.25f;
+	rasterizationStateCI.depthBiasSlopeFactor    = 1.75f;
+	rasterizationStateCI.lineWidth               = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisampleStateCI = {};
+	multisampleStateCI.sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleStateCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = {};
+	depthStencilStateCI.sType            = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilStateCI.depthTestEnable  = VK_TRUE;
+	depthStencilStateCI.depthWriteEnable = VK_TRUE;
+	depthStencilStateCI.depthCompareOp   = VK_COMPARE_OP_LESS_OR_EQUAL;
+	depthStencilStateCI.maxDepthBounds   = 1.0f;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendStateCI = {};
+	colorBlendStateCI.sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendStateCI.attachmentCount = 0;
+
+	VkGraphicsPipelineCreateInfo graphicsPipelineCI = {};
+	graphicsPipelineCI.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphicsPipelineCI.stageCount          = 1;
+	graphicsPipelineCI.pStages             = &vertShaderStageCI;
+	graphicsPipelineCI.pVertexInputState   = &vertexInputStateCI;
+	graphicsPipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+	graphicsPipelineCI.pViewportState      = &viewportStateCI;
+	graphicsPipelineCI.pRasterizationState = &rasterizationStateCI;
+	graphicsPipelineCI.pMultisampleState   = &multisampleStateCI;
+	graphicsPipelineCI.pDepthStencilState  = &depthStencilStateCI;
+	graphicsPipelineCI.pColorBlendState    = &colorBlendStateCI;
+	graphicsPipelineCI.layout              = shadows.pipelineLayout;
+	graphicsPipelineCI.renderPass          = shadows.renderpass;
+
+	if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCI, nullptr, &shadows.pipeline) != VK_SUCCESS) {
+		fputs("Could not create shadow pipeline\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
+}
+
+/**
+ * creates the cascade array image and its sampler. Without multiview the map
+ * is only cleared to the far plane, so nothing is ever in shadow
+ */
+void createShadowResources() {
+
+	shadows.enabled = multiviewSupported;
+	shadows.format = selectImageFormat(
+			{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+			);
+
+	createImage(
+			shadows.image, shadows.memory,
+			SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, shadows.format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			SHADOW_CASCADE_COUNT
+			);
+
+	vkBindImageMemory(logicalDevice, shadows.image, shadows.memory, 0);
+
+	shadows.view = createImageView(shadows.image, shadows.format, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, SHADOW_CASCADE_COUNT);
+
+	// hardware depth comparison; outside the cascade counts as lit
+	VkSamplerCreateInfo samplerCI = {};
+	samplerCI.sType         = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCI.magFilter     = VK_FILTER_LINEAR;
+	samplerCI.minFilter     = VK_FILTER_LINEAR;
+	samplerCI.mipmapMode    = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCI.addressModeU  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	samplerCI.addressModeV  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	samplerCI.addressModeW  = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	samplerCI.compareEnable = VK_TRUE;
+	samplerCI.compareOp     = VK_COMPARE_OP_LESS_OR_EQUAL;
+	samplerCI.maxLod        = 0.0f;
+	samplerCI.borderColor   = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+	if (vkCreateSampler(logicalDevice, &samplerCI, nullptr, &shadows.sampler) != VK_SUCCESS) {
+		fputs("Could not create shadow sampler\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	createBuffer(shadows.paramsBuffer, shadows.paramsBufferMemory, sizeof(ShadowParams),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	vkMapMemory(logicalDevice, shadows.paramsBufferMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void **>(&shadows.params));
+
+	// clear every cascade to the far plane, in case the pass never runs
+	clearDepthImage(shadows.image, shadows.format, SHADOW_CASCADE_COUNT);
+
+	if (!shadows.enabled) {
+		fputs("VK_KHR_multiview not supported, shadows disabled\n", stderr);
+		return;
+	}
+
+	shadows.renderpass = createShadowRenderPass();
+
+	// multiview renders to every layer of the view; the framebuffer has one
+	VkFramebufferCreateInfo framebufferCI = {};
+	framebufferCI.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferCI.renderPass      = shadows.renderpass;
+	framebufferCI.attachmentCount = 1;
+	framebufferCI.pAttachments    = &shadows.view;
+	framebufferCI.width           = SHADOW_MAP_SIZE;
+	framebufferCI.height          = SHADOW_MAP_SIZE;
+	framebufferCI.layers          = 1;
+
+	if (vkCreateFramebuffer(logicalDevice, &framebufferCI, nullptr, &shadows.framebuffer) != VK_SUCCESS) {
+		fputs("Failed to create shadow framebuffer\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	createShadowPipeline();
+}
+
+void destroyShadowResources() {
+
+	if (shadows.enabled) {
+		vkDestroyPipeline(logicalDevice, shadows.pipeline, nullptr);
+		vkDestroyPipelineLayout(logicalDevice, shadows.pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(logicalDevice, shadows.descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(logicalDevice, shadows.descriptorSetLayout, nullptr);
+		vkDestroyFramebuffer(logicalDevice, shadows.framebuffer, nullptr);
+		vkDestroyRenderPass(logicalDevice, shadows.renderpass, nullptr);
+	}
+
+	if (shadows.params)
+		vkUnmapMemory(logicalDevice, shadows.paramsBufferMemory);
+
+	vkDestroyBuffer(logicalDevice, shadows.paramsBuffer, nullptr);
+	freeMemory(shadows.paramsBufferMemory);
+
+	vkDestroySampler(logicalDevice, shadows.sampler, nullptr);
+	vkDestroyImageView(logicalDevice, shadows.view, nullptr);
+	vkDestroyImage(logicalDevice, shadows.image, nullptr);
+	freeMemory(shadows.memory);
+}
+
+ComputePipeline createComputePipeline(
+		const std::string spirvPath,
+		uint32_t storageBufferCount,
+		uint32_t storageImageCount,
+		uint32_t pushConstantSize = 0,
+		uint32_t maxDescriptorSets = 1,
+		uint32_t sampledImageCount = 0,
+		const VkSpecializationInfo *specialization = nullptr) {
+
+	PROFILE_FUNCTION();
+
+	ComputePipeline computePipeline = {};
+	computePipeline.storageBufferCount = storageBufferCount;
+	computePipeline.storageImageCount  = storageImageCount;
+	computePipeline.sampledImageCount  = sampledImageCount;
+	computePipeline.pushConstantSize   = pushConstantSize;
+
+	std::vector<VkDescriptorSetLayoutBinding> bindings(storageBufferCount + storageImageCount + sampledImageCount);
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i] = {};
+		bindings[i].binding         = i;
+		bindings[i].descriptorType  = i < storageBufferCount ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+			: i < storageBufferCount + storageImageCount ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+			: VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = {};
+	descriptorSetLayoutCI.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+	descriptorSetLayoutCI.pBindings    = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(logicalDevice, &descriptorSetLayoutCI, nullptr, &computePipeline.descriptorSetLayout) != VK_SUCCESS) {
+		fputs("Failed to create compute descriptor set layout\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<VkDescriptorPoolSize> descriptorPoolSizes;
+
+	if (storageBufferCount > 0)
+		descriptorPoolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, storageBufferCount * maxDescriptorSets });
+	if (storageImageCount > 0)
+		descriptorPoolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, storageImageCount * maxDescriptorSets });
+	if (sampledImageCount > 0)
+		descriptorPoolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampledImageCount * maxDescriptorSets });
+
+	VkDescriptorPoolCreateInfo descriptorPoolCI = {};
+	descriptorPoolCI.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCI.maxSets       = maxDescriptorSets;
+	descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());
+	descriptorPoolCI.pPoolSizes    = descriptorPoolSizes.data();
+
+	if (vkCreateDescriptorPool(logicalDevice, &descriptorPoolCI, nullptr, &computePipeline.descriptorPool) != VK_SUCCESS) {
+		fputs("Failed to create compute descriptor pool\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset     = 0;
+	pushConstantRange.size       = pushConstantSize;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = {};
+	pipelineLayoutCI.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCI.setLayoutCount         = 1;
+	pipelineLayoutCI.pSetLayouts            = &computePipeline.descriptorSetLayout;
+	pipelineLayoutCI.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+	pipelineLayoutCI.pPushConstantRanges    = &pushConstantRange;
+
+	checkShaderLayout(spirvPath, VK_SHADER_STAGE_COMPUTE_BIT, bindings.data(), static_cast<uint32_t>(bindings.size()),
+			&pushConstantRange, pipelineLayoutCI.pushConstantRangeCount);
+
+	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr, &computePipeline.layout) != VK_SUCCESS) {
+		fputs("Could not create compute pipeline layout\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	VkShaderModule computeShaderModule = createShaderModule(spirvPath);
+
+	VkPipelineShaderStageCreateInfo computeShaderStageCI = {};
+	computeShaderStageCI.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	computeShaderStageCI.stage               = VK_SHADER_STAGE_COMPUTE_BIT;
+	computeShaderStageCI.module              = computeShaderModule;
+	computeShaderStageCI.pName               = "main";
+	computeShaderStageCI.pSpecializationInfo = specialization;
+
+	VkComputePipelineCreateInfo computePipelineCI = {};
+	computePipelineCI.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	computePipelineCI.stage  = computeShaderStageCI;
+	computePipelineCI.layout = computePipeline.layout;
+
+	if (vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &computePipelineCI, nullptr, &computePipeline.pipeline) != VK_SUCCESS) {
+		fprintf(stderr, "Could not create compute pipeline for %s\n", spirvPath.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	// the pipeline keeps what it needs from the module
+	vkDestroyShaderModule(logicalDevice, computeShaderModule, nullptr);
+
+	return computePipeline;
+}
+
+VkDescriptorSet allocateComputeDescriptorSet(const ComputePipeline &computePipeline) {
+
+	VkDescriptorSetAllocateInfo descriptorSetAI = {};
+	descriptorSetAI.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAI.descriptorPool     = computePipeline.descriptorPool;
+	descriptorSetAI.descriptorSetCount = 1;
+	descriptorSetAI.pSetLayouts        = &computePipeline.descriptorSetLayout;
+
+	VkDescriptorSet descriptorSet;
+
+	if (vkAllocateDescriptorSets(logicalDevice, &descriptorSetAI, &descriptorSet) != VK_SUCCESS) {
+		fputs("Could not allocate compute descriptor set\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	return descriptorSet;
+}
+
+void writeStorageBufferDescriptor(VkDescriptorSet descriptorSet, uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) {
+
+	VkDescriptorBufferInfo descriptorBufferI = {};
+	descriptorBufferI.buffer = buffer;
+	descriptorBufferI.offset = offset;
+	descriptorBufferI.range  = range;
+
+	VkWriteDescriptorSet writeDescriptorSet = {};
+	writeDescriptorSet.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writeDescriptorSet.dstSet          = descriptorSet;
+	writeDescriptorSet.dstBinding      = binding;
+	writeDescriptorSet.descriptorCount = 1;
+	writeDescriptorSet.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writeDescriptorSet.pBufferInfo     = &descriptorBufferI;
+
+	vkUpdateDescriptorSets(logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+}
+
+/**
+ * storage images are accessed in VK_IMAGE_LAYOUT_GENERAL
+ */
+void writeStorageImageDescriptor(VkDescriptorSet descriptorSet, uint32_t binding, VkImageView imageView) {
+
+	VkDescriptorImageInfo descriptorImageI = {};
+	descriptorImageI.imageView   = imageView;
+	descriptorImageI.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet writeDescriptorSet = {};
+	writeDescriptorSet.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writeDescriptorSet.dstSet          = descriptorSet;
+	writeDescriptorSet.dstBinding      = binding;
+	writeDescriptorSet.descriptorCount = 1;
+	writeDescriptorSet.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	writeDescriptorSet.pImageInfo      = &descriptorImageI;
+
+	vkUpdateDescriptorSets(logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+}
+
+void writeSampledImageDescriptor(VkDescriptorSet descriptorSet, uint32_t binding, VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout) {
+
+	VkDescriptorImageInfo descriptorImageI = {};
+	descriptorImageI.sampler     = sampler;
+	descriptorImageI.imageView   = imageView;
+	descriptorImageI.imageLayout = imageLayout;
+
+	VkWriteDescriptorSet writeDescriptorSet = {};
+	writeDescriptorSet.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writeDescriptorSet.dstSet          = descriptorSet;
+	writeDescriptorSet.dstBinding      = binding;
+	writeDescriptorSet.descriptorCount = 1;
+	writeDescriptorSet.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writeDescriptorSet.pImageInfo      = &descriptorImageI;
+
+	vkUpdateDescriptorSets(logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+}
+
+/**
+ * number of workgroups of groupSize invocations needed to cover count items
+ */
+uint32_t getGroupCount(uint32_t count, uint32_t groupSize) {
+	return (count + groupSize - 1) / groupSize;
+}
+
+/**
+ * records a dispatch of the given number of workgroups. pushConstants, if
+ * given, must be the size the pipeline was created with
+ */
+void dispatchCompute(
+		VkCommandBuffer commandBuffer,
+		const ComputePipeline &computePipeline,
+		VkDescriptorSet descriptorSet,
+		uint32_t groupCountX,
+		uint32_t groupCountY = 1,
+		uint32_t groupCountZ = 1,
+		const void *pushConstants = nullptr) {
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline.pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline.layout, 0, 1, &descriptorSet, 0, nullptr);
+
+	if (pushConstants && computePipeline.pushConstantSize > 0)
+		vkCmdPushConstants(commandBuffer, computePipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, computePipeline.pushConstantSize, pushConstants);
+
+	vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+/**
+ * makes the writes of one dispatch visible to the reads of the next
+ */
+void recordComputeBarrier(VkCommandBuffer commandBuffer) {
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT
+		);
+}
+
+void destroyComputePipeline(ComputePipeline &computePipeline) {
+
+	vkDestroyPipeline(logicalDevice, computePipeline.pipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, computePipeline.layout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, computePipeline.descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, computePipeline.descriptorSetLayout, nullptr);
+
+	computePipeline = {};
+}
+
+/**
+ * graphics pipeline drawing each alive particle as an additively blended,
+ * camera-facing quad straight out of the particle storage buffers
+ */
+void createParticlePipeline() {
+
+	PROFILE_FUNCTION();
+
+	std::array<VkDescriptorSetLayoutBinding, 4> bindings = {};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding         = i;
+		bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI = {};
+	descriptorSetLayoutCI.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+	descriptorSetLayoutCI.pBindings    = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(logicalDevice, &descriptorSetLayoutCI, nullptr, &particles.drawDescriptorSetLayout) != VK_SUCCESS) {
+		fputs("Failed to create particle descriptor set layout\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorPoolSize descriptorPoolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(bindings.size()) };
+
+	VkDescriptorPoolCreateInfo descriptorPoolCI = {};
+	descriptorPoolCI.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCI.maxSets       = 1;
+	descriptorPoolCI.poolSizeCount = 1;
+	descriptorPoolCI.pPoolSizes    = &descriptorPoolSize;
+
+	if (vkCreateDescriptorPool(logicalDevice, &descriptorPoolCI, nullptr, &particles.drawDescriptorPool) != VK_SUCCESS) {
+		fputs("Failed to create particle descriptor pool\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorSetAllocateInfo descriptorSetAI = {};
+	descriptorSetAI.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAI.descriptorPool     = particles.drawDescriptorPool;
+	descriptorSetAI.descriptorSetCount = 1;
+	descriptorSetAI.pSetLayouts        = &particles.drawDescriptorSetLayout;
+
+	vkAllocateDescriptorSets(logicalDevice, &descriptorSetAI, &particles.drawDescriptorSet);
+
+	writeStorageBufferDescriptor(particles.drawDescriptorSet, 0, particles.buffers[PARTICLE_BUFFER_POSITIONS]);
+	writeStorageBufferDescriptor(particles.drawDescriptorSet, 1, particles.buffers[PARTICLE_BUFFER_VELOCITIES]);
+	writeStorageBufferDescriptor(particles.drawDescriptorSet, 2, particles.buffers[PARTICLE_BUFFER_ALIVE_LISTS]);
+	writeStorageBufferDescriptor(particles.drawDescriptorSet, 3, particles.buffers[PARTICLE_BUFFER_COUNTERS]);
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset     = 0;
+	pushConstantRange.size       = sizeof(ParticleDrawParams);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = {};
+	pipelineLayoutCI.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCI.setLayoutCount         = 1;
+	pipelineLayoutCI.pSetLayouts            = &particles.drawDescriptorSetLayout;
+	pipelineLayoutCI.pushConstantRangeCount = 1;
+	pipelineLayoutCI.pPushConstantRanges    = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr, &particles.drawPipelineLayout) != VK_SUCCESS) {
+		fputs("Could not create particle pipeline layout\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	checkShaderLayout("spirv/particle.vert", VK_SHADER_STAGE_VERTEX_BIT, bindings.data(), static_cast<uint32_t>(bindings.size()), &pushConstantRange, 1);
+	checkShaderLayout("spirv/particle.frag", VK_SHADER_STAGE_FRAGMENT_BIT, bindings.data(), static_cast<uint32_t>(bindings.size()), &pushConstantRange, 1);
+
+	VkShaderModule vertexShaderModule = createShaderModule("spirv/particle.vert");
+	VkShaderModule fragmentShaderModule = createShaderModule("spirv/particle.frag");
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage  = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertexShaderModule;
+	shaderStages[0].pName  = "main";
+	shaderStages[1].sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage  = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragmentShaderModule;
+	shaderStages[1].pName  = "main";
+
+	// quads are generated from gl_VertexIndex, there are no vertex attributes
+	VkPipelineVertexInputStateCreateInfo vertexInputStateCI = {};
+	vertexInputStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = {};
+	inputAssemblyStateCI.sType    = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyStateCI.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+
+	VkPipelineViewportStateCreateInfo viewportStateCI = {};
+	viewportStateCI.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportStateCI.viewportCount = 1;
+	viewportStateCI.scissorCount  = 1;
+
+	std::array<VkDynamicState, 2> dynamicStates = {
+		VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicStateCI = {};
+	dynamicStateCI.sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicStateCI.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicStateCI.pDynamicStates    = dynamicStates.data();
+
+	VkPipelineRasterizationStateCreateInfo rasterizationStateCI = {};
+	rasterizationStateCI.sType       = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationStateCI.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizationStateCI.cullMode    = VK_CULL_MODE_NONE;
+	rasterizationStateCI.frontFace   = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizationStateCI.lineWidth   = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisampleStateCI = {};
+	multisampleStateCI.sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleStateCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// tested against the scene but order independent among themselves
+	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = {};
+	depthStencilStateCI.sType            = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilStateCI.depthTestEnable  = VK_TRUE;
+	depthStencilStateCI.depthWriteEnable = VK_FALSE;
+	depthStencilStateCI.depthCompareOp   = VK_COMPARE_OP_LESS;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable         = VK_TRUE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.colorBlendOp        = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.alphaBlendOp        = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendStateCI = {};
+	colorBlendStateCI.sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendStateCI.attachmentCount = 1;
+	colorBlendStateCI.pAttachments    = &colorBlendAttachment;
+
+	VkGraphicsPipelineCreateInfo graphicsPipelineCI = {};
+	graphicsPipelineCI.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphicsPipelineCI.stageCount          = 2;
+	graphicsPipelineCI.pStages             = shaderStages;
+	graphicsPipelineCI.pVertexInputState   = &vertexInputStateCI;
+	graphicsPipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+	graphicsPipelineCI.pViewportState      = &viewportStateCI;
+	graphicsPipelineCI.pRasterizationState = &rasterizationStateCI;
+	graphicsPipelineCI.pMultisampleState   = &multisampleStateCI;
+	graphicsPipelineCI.pDepthStencilState  = &depthStencilStateCI;
+	graphicsPipelineCI.pColorBlendState    = &colorBlendStateCI;
+	graphicsPipelineCI.pDynamicState       = &dynamicStateCI;
+	graphicsPipelineCI.layout              = particles.drawPipelineLayout;
+
+	VkPipelineRenderingCreateInfo renderingCI;
+	setMainPassTarget(graphicsPipelineCI, renderingCI);
+
+	// soft, blended sprites lose little at a quarter of the fragments
+	VkPipelineFragmentShadingRateStateCreateInfoKHR shadingRateCI;
+	setPipelineShadingRate(graphicsPipelineCI, shadingRateCI, { 2, 2 });
+
+	if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCI, nullptr, &particles.drawPipeline) != VK_SUCCESS) {
+		fputs("Could not create particle pipeline\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
+	vkDestroyShaderModule(logicalDevice, fragmentShaderModule, nullptr);
+}
+
+/**
+ * sets the camera in the particle draw parameters; the camera does not move,
+ * so they are baked into the command buffers and only change with the
+ * projection when the swapchain is recreated
+ */
+void updateParticleCamera() {
+
+	glm::mat4 view = getViewMatrix();
+	glm::mat4 projection = getProjectionMatrix();
+
+	particles.drawParams.viewProjection = projection * view;
+	particles.drawParams.cameraRight    = glm::vec4(view[0][0], view[1][0], view[2][0], PARTICLE_SIZE);
+	particles.drawParams.cameraUp       = glm::vec4(view[0][1], view[1][1], view[2][1], 0.0f);
+}
+
+/**
+ * allocates the particle state for maxParticles particles, all of them
+ * initially on the dead list
+ */
+void createParticleSystem(uint32_t maxParticles) {
+
+	particles.maxParticles    = maxParticles;
+	particles.emitRate        = maxParticles / (0.5f * (PARTICLE_MIN_LIFETIME + PARTICLE_MAX_LIFETIME));
+	particles.emitAccumulator = 0.0f;
+	particles.seed            = 0;
+	particles.emitter         = glm::vec4(0.0f, -0.5f, 0.0f, 0.05f);
+	particles.gravity         = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
+
+	const VkDeviceSize bufferSizes[PARTICLE_BUFFER_COUNT] = {
+		maxParticles * sizeof(glm::vec4),		// positions
+		maxParticles * sizeof(glm::vec4),		// velocities
+		maxParticles * sizeof(uint32_t),		// dead list
+		2 * maxParticles * sizeof(uint32_t),	// alive lists
+		sizeof(ParticleCounters)
+	};
+
+	for (uint32_t i = 0; i < PARTICLE_BUFFER_COUNT; i++) {
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+		// the counters start with the indirect draw arguments
+		if (i == PARTICLE_BUFFER_COUNTERS)
+			usage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+
+		createBuffer(particles.buffers[i], particles.memory[i], bufferSizes[i], usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	std::vector<uint32_t> deadList(maxParticles);
+	std::iota(deadList.begin(), deadList.end(), 0);
+
+	ParticleCounters counters = {};
+	counters.vertexCount = 4;
+	counters.deadCount   = static_cast<int32_t>(maxParticles);
+
+	UploadBatch batch = beginUploads();
+	stageBufferUpload(batch, deadList.data(), bufferSizes[PARTICLE_BUFFER_DEAD_LIST], particles.buffers[PARTICLE_BUFFER_DEAD_LIST], 0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	stageBufferUpload(batch, &counters, sizeof(counters), particles.buffers[PARTICLE_BUFFER_COUNTERS], 0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	finishUploads(batch);
+
+	const char *shaders[] = {
+		"spirv/particle_emit.comp", "spirv/particle_simulate.comp", "spirv/particle_compact.comp", "spirv/particle_finish.comp"
+	};
+
+	for (uint32_t i = 0; i < particles.computePipelines.size(); i++) {
+
+		particles.computePipelines[i] = createComputePipeline(shaders[i], PARTICLE_BUFFER_COUNT, 0, sizeof(ParticleSimulationParams));
+		particles.computeDescriptorSets[i] = allocateComputeDescriptorSet(particles.computePipelines[i]);
+
+		for (uint32_t b = 0; b < PARTICLE_BUFFER_COUNT; b++)
+			writeStorageBufferDescriptor(particles.computeDescriptorSets[i], b, particles.buffers[b]);
+	}
+
+	createParticlePipeline();
+
+	particles.drawParams.maxParticles = maxParticles;
+	updateParticleCamera();
+}
+
+/**
+ * records one simulation step: emit, simulate, compact and finish. Nothing
+ * here depends on the number of live particles, which only the GPU knows;
+ * simulate and compact cover the whole pool and stop at the alive count
+ */
+void recordParticleUpdate(VkCommandBuffer commandBuffer, float dt) {
+
+	PROFILE_FUNCTION();
+
+	particles.emitAccumulator += particles.emitRate * dt;
+
+	ParticleSimulationParams params = {};
+	params.emitter      = particles.emitter;
+	params.gravity      = glm::vec4(glm::vec3(particles.gravity), dt);
+	params.emitCount    = std::min(static_cast<uint32_t>(particles.emitAccumulator), particles.maxParticles);
+	params.seed         = particles.seed++;
+	params.maxParticles = particles.maxParticles;
+
+	particles.emitAccumulator -= params.emitCount;
+
+	// the previous frame's draw and simulation must be done with the state
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+			VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
+			VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT
+		);
+
+	// compaction counts survivors into the indirect draw's instance count
+	vkCmdFillBuffer(commandBuffer, particles.buffers[PARTICLE_BUFFER_COUNTERS], offsetof(ParticleCounters, instanceCount), sizeof(uint32_t), 0);
+
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+		);
+
+	uint32_t poolGroups = getGroupCount(particles.maxParticles, PARTICLE_GROUP_SIZE);
+
+	if (params.emitCount > 0) {
+		dispatchCompute(commandBuffer, particles.computePipelines[0], particles.computeDescriptorSets[0], getGroupCount(params.emitCount, PARTICLE_GROUP_SIZE), 1, 1, &params);
+		recordComputeBarrier(commandBuffer);
+	}
+
+	dispatchCompute(commandBuffer, particles.computePipelines[1], particles.computeDescriptorSets[1], poolGroups, 1, 1, &params);
+	recordComputeBarrier(commandBuffer);
+
+	dispatchCompute(commandBuffer, particles.computePipelines[2], particles.computeDescriptorSets[2], poolGroups, 1, 1, &params);
+	recordComputeBarrier(commandBuffer);
+
+	dispatchCompute(commandBuffer, particles.computePipelines[3], particles.computeDescriptorSets[3], 1, 1, 1, &params);
+
+	// hand the survivors to the indirect draw
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+			VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT
+		);
+
+}
+
+void destroyParticleSystem() {
+
+	for (ComputePipeline &computePipeline : particles.computePipelines)
+		destroyComputePipeline(computePipeline);
+
+	vkDestroyPipeline(logicalDevice, particles.drawPipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, particles.drawPipelineLayout, nullptr);
+	vkDestroyDescriptorPool(logicalDevice, particles.drawDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(logicalDevice, particles.drawDescriptorSetLayout, nullptr);
+
+	for (uint32_t i = 0; i < PARTICLE_BUFFER_COUNT; i++) {
+		vkDestroyBuffer(logicalDevice, particles.buffers[i], nullptr);
+		freeMemory(particles.memory[i]);
+	}
+
+}
+
+/**
+ * creates count instances of the procedural test character, laid out in rows
+ * facing the camera, with the skinning pipeline and one joint slot per frame
+ * in flight
+ */
+void createSkinnedCharacters(uint32_t count) {
+
+	std::vector<Vertex> bindPose;
+	std::vector<VertexSkin> skins;
+	std::vector<uint32_t> characterIndices;
+
+	buildSkinnedColumn(4, bindPose, skins, characterIndices, characters.skeleton, characters.clip);
+
+	const uint32_t jointCount = characters.skeleton.getJointCount();
+	const uint32_t slotCount = presentPolicy.framesInFlight;
+
+	characters.count       = count;
+	characters.vertexCount = static_cast<uint32_t>(bindPose.size());
+	characters.indexCount  = static_cast<uint32_t>(characterIndices.size());
+	characters.time        = 0.0f;
+
+	const uint32_t rowLength = 8;
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t column = i % rowLength;
+		uint32_t row = i / rowLength;
+		characters.positions.push_back(glm::vec3(0.25f * column - 0.875f, -0.5f, -0.5f * row));
+	}
+
+	VkDeviceSize bindPoseBytes = sizeof(Vertex) * bindPose.size();
+	VkDeviceSize skinBytes = sizeof(VertexSkin) * skins.size();
+	VkDeviceSize indexBytes = sizeof(uint32_t) * characterIndices.size();
+
+	createBuffer(characters.bindPoseBuffer, characters.bindPoseBufferMemory, bindPoseBytes,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	createBuffer(characters.skinBuffer, characters.skinBufferMemory, skinBytes,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// every instance draws the same index list, from the geometry pool
+	GeometryAllocation indexAllocation;
+
+	if (!geometry.pool.allocate(0, characters.indexCount, indexAllocation)) {
+		fputs("No room in the geometry pool for the character indices\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	characters.firstIndex = indexAllocation.firstIndex;
+
+	// written by the skinning pass, read as vertices by everything after it
+	createBuffer(characters.skinnedBuffer, characters.skinnedBufferMemory, bindPoseBytes * count,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	VkDeviceSize alignment = deviceCapabilities.properties.limits.minStorageBufferOffsetAlignment;
+	VkDeviceSize jointBytes = sizeof(glm::mat4) * jointCount * count;
+	characters.jointSlotSize = (jointBytes + alignment - 1) / alignment * alignment;
+
+	createBuffer(characters.jointBuffer, characters.jointBufferMemory, characters.jointSlotSize * slotCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	vkMapMemory(logicalDevice, characters.jointBufferMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void **>(&characters.jointMatrices));
+
+	UploadBatch batch = beginUploads();
+	stageBufferUpload(batch, bindPose.data(), bindPoseBytes, characters.bindPoseBuffer, 0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	stageBufferUpload(batch, skins.data(), skinBytes, characters.skinBuffer, 0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	stageBufferUpload(batch, characterIndices.data(), indexBytes, geometry.indexBuffer, sizeof(uint32_t) * static_cast<VkDeviceSize>(characters.firstIndex),
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	finishUploads(batch);
+
+	characters.skinningPipeline = createComputePipeline("spirv/skin.comp", 4, 0, sizeof(SkinningParams), slotCount);
+
+	for (uint32_t i = 0; i < slotCount; i++) {
+
+		VkDescriptorSet descriptorSet = allocateComputeDescriptorSet(characters.skinningPipeline);
+
+		writeStorageBufferDescriptor(descriptorSet, 0, characters.bindPoseBuffer);
+		writeStorageBufferDescriptor(descriptorSet, 1, characters.skinBuffer);
+		writeStorageBufferDescriptor(descriptorSet, 2, characters.jointBuffer, i * characters.jointSlotSize, jointBytes);
+		writeStorageBufferDescriptor(descriptorSet, 3, characters.skinnedBuffer);
+
+		characters.descriptorSets.push_back(descriptorSet);
+	}
+
+}
+
+/**
+ * advances the animation, writes every instance's skinning matrices into the
+ * given joint slot and records the skinning pass. The slot must belong to a
+ * frame the GPU has finished with
+ */
+void recordSkinning(VkCommandBuffer commandBuffer, uint32_t slot, float dt) {
+
+	PROFILE_FUNCTION();
+
+	characters.time += dt;
+
+	const uint32_t jointCount = characters.skeleton.getJointCount();
+	glm::mat4 *matrices = reinterpret_cast<glm::mat4 *>(characters.jointMatrices + slot * characters.jointSlotSize);
+
+	jobs.parallelFor(characters.count, 16, [matrices, jointCount](uint32_t begin, uint32_t end) {
+
+			JointPose pose[MAX_JOINTS];
+
+			for (uint32_t i = begin; i < end; i++) {
+
+				// offset each instance in time so they do not sway in lockstep
+				characters.skeleton.samplePose(characters.clip, characters.time + 0.3f * i, pose);
+
+				glm::mat4 root = glm::translate(glm::mat4(1.0f), characters.positions[i]);
+				characters.skeleton.computeSkinningMatrices(pose, root, &matrices[i * jointCount]);
+			}
+		});
+
+	// the previous frame's draws must be done reading the skinned vertices
+	recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, 0, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0);
+
+	SkinningParams params = {};
+	params.vertexCount   = characters.vertexCount;
+	params.jointCount    = jointCount;
+	params.instanceCount = characters.count;
+
+	dispatchCompute(commandBuffer, characters.skinningPipeline, characters.descriptorSets[slot],
+			getGroupCount(characters.vertexCount, SKINNING_GROUP_SIZE), characters.count, 1, &params);
+
+	// index fetch does not wait, the indices never change
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT
+		);
+
+}
+
+void destroySkinnedCharacters() {
+
+	destroyComputePipeline(characters.skinningPipeline);
+
+	vkUnmapMemory(logicalDevice, characters.jointBufferMemory);
+
+	VkBuffer buffers[] = {
+		characters.bindPoseBuffer, characters.skinBuffer, characters.skinnedBuffer, characters.jointBuffer
+	};
+	VkDeviceMemory memory[] = {
+		characters.bindPoseBufferMemory, characters.skinBufferMemory, characters.skinnedBufferMemory, characters.jointBufferMemory
+	};
+
+	for (uint32_t i = 0; i < 4; i++) {
+		vkDestroyBuffer(logicalDevice, buffers[i], nullptr);
+		freeMemory(memory[i]);
+	}
+
+}
+
+/**
+ * uploads count scattered lights and creates the cluster grid and the culling
+ * pipeline. The grid is created even without lights, since the main
+ * pipeline's fragment shader always reads it
+ */
+void createLightGrid(uint32_t count) {
+
+	lightGrid.lightCount = count;
+
+	std::vector<Light> lights = scatterLights(count, glm::vec3(-2.0f, -1.0f, -3.0f), glm::vec3(2.0f, 1.0f, 1.0f), 1);
+
+	const VkDeviceSize bufferSizes[LIGHT_BUFFER_COUNT] = {
+		sizeof(ClusterParams),
+		std::max(count, 1u) * sizeof(Light),
+		CLUSTER_COUNT * sizeof(uint32_t),
+		CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t)
+	};
+
+	createBuffer(lightGrid.buffers[LIGHT_BUFFER_PARAMS], lightGrid.memory[LIGHT_BUFFER_PARAMS], bufferSizes[LIGHT_BUFFER_PARAMS],
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	vkMapMemory(logicalDevice, lightGrid.memory[LIGHT_BUFFER_PARAMS], 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void **>(&lightGrid.params));
+	*lightGrid.params = {};
+
+	for (uint32_t i = LIGHT_BUFFER_LIGHTS; i < LIGHT_BUFFER_COUNT; i++)
+		createBuffer(lightGrid.buffers[i], lightGrid.memory[i], bufferSizes[i],
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (count > 0) {
+		UploadBatch batch = beginUploads();
+		stageBufferUpload(batch, lights.data(), count * sizeof(Light), lightGrid.buffers[LIGHT_BUFFER_LIGHTS], 0,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		finishUploads(batch);
+	}
+
+	lightGrid.cullPipeline = createComputePipeline("spirv/light_cull.comp", LIGHT_BUFFER_COUNT, 0);
+	lightGrid.cullDescriptorSet = allocateComputeDescriptorSet(lightGrid.cullPipeline);
+
+	for (uint32_t i = 0; i < LIGHT_BUFFER_COUNT; i++)
+		writeStorageBufferDescriptor(lightGrid.cullDescriptorSet, i, lightGrid.buffers[i]);
+}
+
+void createUniformBuffer() {
+
+	createBuffer(uniformBuffer, uniformBufferMemory, sizeof(UniformBufferObject),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+/**
+ * writes the camera into the uniform buffer, the cluster parameters and the
+ * shadow cascades; all depend on the swapchain extent, and the GPU must not
+ * be using them
+ */
+void updateCameraBuffers() {
+
+	UniformBufferObject ubo = {};
+	ubo.model      = glm::mat4(1.0f);
+	ubo.view       = getViewMatrix();
+	ubo.projection = getProjectionMatrix();
+
+	void *data;
+	vkMapMemory(logicalDevice, uniformBufferMemory, 0, sizeof(ubo), 0, &data);
+	memcpy(data, &ubo, sizeof(ubo));
+	vkUnmapMemory(logicalDevice, uniformBufferMemory);
+
+	lightGrid.params->view              = ubo.view;
+	lightGrid.params->inverseProjection = glm::inverse(ubo.projection);
+	lightGrid.params->screen            = glm::vec4(swapchainExtent.width, swapchainExtent.height, cameraNear, cameraFar);
+	lightGrid.params->lightCount        = lightGrid.lightCount;
+
+	computeShadowCascades(ubo.view, cameraFovY, swapchainExtent.width / static_cast<float>(swapchainExtent.height), cameraNear, sunDirection, shadows.cascades);
+	*shadows.params = shadows.cascades;
+
+	// the depth buffer is recreated empty with the swapchain, so the first
+	// pyramid built with this camera occludes nothing
+	if (occlusion.params)
+		occlusion.params->viewProjection = ubo.projection * ubo.view;
+}
+
+/**
+ * rebuilds the cluster light lists for this frame's camera and lights
+ */
+void recordLightCulling(VkCommandBuffer commandBuffer) {
+
+	PROFILE_FUNCTION();
+
+	// the previous frame's fragments must be done reading the lists
+	recordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, 0, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0);
+
+	dispatchCompute(commandBuffer, lightGrid.cullPipeline, lightGrid.cullDescriptorSet, getGroupCount(CLUSTER_COUNT, LIGHT_CULL_GROUP_SIZE));
+
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT
+		);
+
+}
+
+void destroyLightGrid() {
+
+	destroyComputePipeline(lightGrid.cullPipeline);
+
+	if (lightGrid.params)
+		vkUnmapMemory(logicalDevice, lightGrid.memory[LIGHT_BUFFER_PARAMS]);
+
+	for (uint32_t i = 0; i < LIGHT_BUFFER_COUNT; i++) {
+		vkDestroyBuffer(logicalDevice, lightGrid.buffers[i], nullptr);
+		freeMemory(lightGrid.memory[i]);
+	}
+
+}
+
+/**
+ * creates the object and draw buffers and both compute passes; the pyramid
+ * itself follows the swapchain, see createHiZPyramid
+ */
+void createOcclusionCuller() {
+
+	occlusion.objectCount = static_cast<uint32_t>(meshes.size()) + characters.count;
+
+	uint32_t count = std::max(occlusion.objectCount, 1u);
+
+	createBuffer(occlusion.buffers[OCCLUSION_BUFFER_PARAMS], occlusion.memory[OCCLUSION_BUFFER_PARAMS], sizeof(OcclusionParams),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	createBuffer(occlusion.buffers[OCCLUSION_BUFFER_OBJECTS], occlusion.memory[OCCLUSION_BUFFER_OBJECTS], count * sizeof(CullObject),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	createBuffer(occlusion.buffers[OCCLUSION_BUFFER_DRAWS], occlusion.memory[OCCLUSION_BUFFER_DRAWS], count * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	vkMapMemory(logicalDevice, occlusion.memory[OCCLUSION_BUFFER_PARAMS], 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void **>(&occlusion.params));
+	vkMapMemory(logicalDevice, occlusion.memory[OCCLUSION_BUFFER_OBJECTS], 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void **>(&occlusion.objects));
+
+	*occlusion.params = {};
+	occlusion.params->objectCount = occlusion.objectCount;
+
+	// texels are fetched by index, never filtered
+	VkSamplerCreateInfo samplerCI = {};
+	samplerCI.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCI.magFilter    = VK_FILTER_NEAREST;
+	samplerCI.minFilter    = VK_FILTER_NEAREST;
+	samplerCI.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.maxLod       = static_cast<float>(HIZ_MAX_LEVELS);
+
+	if (vkCreateSampler(logicalDevice, &samplerCI, nullptr, &occlusion.sampler) != VK_SUCCESS) {
+		fputs("Could not create occlusion sampler\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	// previous level and level being written as storage images, the depth buffer sampled
+	occlusion.reducePipeline = createComputePipeline("spirv/hiz.comp", 0, 2, sizeof(HiZParams), HIZ_MAX_LEVELS, 1);
+
+	occlusion.cullPipeline = createComputePipeline("spirv/occlusion_cull.comp", OCCLUSION_BUFFER_COUNT, 0, 0, 1, 1);
+	occlusion.cullDescriptorSet = allocateComputeDescriptorSet(occlusion.cullPipeline);
+
+	for (uint32_t i = 0; i < OCCLUSION_BUFFER_COUNT; i++)
+		writeStorageBufferDescriptor(occlusion.cullDescriptorSet, i, occlusion.buffers[i]);
+}
+
+/**
+ * creates the depth pyramid for the current depth buffer, full size at level
+ * 0 down to a single texel, and points the reduction and cull passes at it
+ */
+void createHiZPyramid() {
+
+	uint32_t width = swapchainExtent.width;
+	uint32_t height = swapchainExtent.height;
+
+	occlusion.levelCount = 1;
+	while (occlusion.levelCount < HIZ_MAX_LEVELS && (std::max(width, height) >> occlusion.levelCount) > 0)
+		occlusion.levelCount++;
+
+	createImage(
+			occlusion.pyramid, occlusion.pyramidMemory,
+			width, height, VK_FORMAT_R32_SFLOAT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			1,
+			occlusion.levelCount,
+			MEMORY_CATEGORY_TRANSIENT
+			);
+
+	vkBindImageMemory(logicalDevice, occlusion.pyramid, occlusion.pyramidMemory, 0);
+
+	occlusion.pyramidView = createImageView(occlusion.pyramid, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, 1, 0, occlusion.levelCount);
+
+	occlusion.levelViews.resize(occlusion.levelCount);
+	for (uint32_t level = 0; level < occlusion.levelCount; level++)
+		occlusion.levelViews[level] = createImageView(occlusion.pyramid, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, 1, level, 1);
+
+	// written and read in place for its whole life
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask       = 0;
+	imageMemoryBarrier.dstAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+	imageMemoryBarrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemoryBarrier.newLayout           = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image               = occlusion.pyramid;
+	imageMemoryBarrier.subresourceRange = {
+		.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+		.baseMipLevel   = 0,
+		.levelCount     = occlusion.levelCount,
+		.baseArrayLayer = 0,
+		.layerCount     = 1
+	};
+
+	VkCommandBuffer commandBuffer = beginCommandRecording(commandPool);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	endCommandRecording(commandBuffer);
+	submitCommandBuffer(commandPool, commandBuffer, graphicsQueue);
+
+	// the sets of the previous pyramid go with it
+	vkResetDescriptorPool(logicalDevice, occlusion.reducePipeline.descriptorPool, 0);
+
+	occlusion.reduceDescriptorSets.resize(occlusion.levelCount);
+
+	for (uint32_t level = 0; level < occlusion.levelCount; level++) {
+
+		VkDescriptorSet descriptorSet = allocateComputeDescriptorSet(occlusion.reducePipeline);
+
+		// level 0 reads the depth buffer instead, but the binding must be valid
+		writeStorageImageDescriptor(descriptorSet, 0, occlusion.levelViews[level > 0 ? level - 1 : 0]);
+		writeStorageImageDescriptor(descriptorSet, 1, occlusion.levelViews[level]);
+		writeSampledImageDescriptor(descriptorSet, 2, occlusion.sampler, depthBufferView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+
+		occlusion.reduceDescriptorSets[level] = descriptorSet;
+	}
+
+	writeSampledImageDescriptor(occlusion.cullDescriptorSet, OCCLUSION_BUFFER_COUNT, occlusion.sampler, occlusion.pyramidView, VK_IMAGE_LAYOUT_GENERAL);
+}
+
+/**
+ * reduces the previous frame's depth buffer into the pyramid, then writes
+ * this frame's indirect draws with the hidden objects' instances removed
+ */
+void recordOcclusionCulling(VkCommandBuffer commandBuffer) {
+
+	PROFILE_FUNCTION();
+
+	// the previous frame's draws must be done reading their arguments, and
+	// its cull pass reading the pyramid
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0
+		);
+
+	HiZParams hizParams = {};
+	hizParams.srcSize = glm::ivec2(swapchainExtent.width, swapchainExtent.height);
+
+	for (uint32_t level = 0; level < occlusion.levelCount; level++) {
+
+		hizParams.dstSize = glm::max(glm::ivec2(swapchainExtent.width >> level, swapchainExtent.height >> level), glm::ivec2(1));
+		hizParams.level   = level;
+
+		dispatchCompute(
+				commandBuffer,
+				occlusion.reducePipeline,
+				occlusion.reduceDescriptorSets[level],
+				getGroupCount(hizParams.dstSize.x, HIZ_GROUP_SIZE),
+				getGroupCount(hizParams.dstSize.y, HIZ_GROUP_SIZE),
+				1,
+				&hizParams
+				);
+
+		recordComputeBarrier(commandBuffer);
+
+		hizParams.srcSize = hizParams.dstSize;
+	}
+
+	dispatchCompute(commandBuffer, occlusion.cullPipeline, occlusion.cullDescriptorSet, getGroupCount(occlusion.objectCount, OCCLUSION_CULL_GROUP_SIZE));
+
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT
+		);
+
+}
+
+void destroyHiZPyramid() {
+
+	std::vector<VkImageView> levelViews = occlusion.levelViews;
+	VkImageView pyramidView = occlusion.pyramidView;
+	VkImage pyramid = occlusion.pyramid;
+	VkDeviceMemory pyramidMemory = occlusion.pyramidMemory;
+
+	deferDeletion([=]() {
+		for (VkImageView view : levelViews)
+			vkDestroyImageView(logicalDevice, view, nullptr);
+
+		vkDestroyImageView(logicalDevice, pyramidView, nullptr);
+		vkDestroyImage(logicalDevice, pyramid, nullptr);
+		freeMemory(pyramidMemory);
+	});
+
+	occlusion.levelViews.clear();
+	occlusion.reduceDescriptorSets.clear();
+}
+
+void destroyOcclusionCuller() {
+
+	destroyComputePipeline(occlusion.cullPipeline);
+	destroyComputePipeline(occlusion.reducePipeline);
+
+	vkDestroySampler(logicalDevice, occlusion.sampler, nullptr);
+
+	if (occlusion.params) {
+		vkUnmapMemory(logicalDevice, occlusion.memory[OCCLUSION_BUFFER_PARAMS]);
+		vkUnmapMemory(logicalDevice, occlusion.memory[OCCLUSION_BUFFER_OBJECTS]);
+	}
+
+	for (uint32_t i = 0; i < OCCLUSION_BUFFER_COUNT; i++) {
+		vkDestroyBuffer(logicalDevice, occlusion.buffers[i], nullptr);
+		freeMemory(occlusion.memory[i]);
+	}
+
+}
+
+/**
+ * size of the area the main pass renders to at a render scale
+ */
+VkExtent2D getRenderExtent(float scale) {
+	return {
+		std::max(static_cast<uint32_t>(swapchainExtent.width * scale + 0.5f), 1u),
+		std::max(static_cast<uint32_t>(swapchainExtent.height * scale + 0.5f), 1u)
+	};
+}
+
+/**
+ * sampler and pipeline of the upscale pass; its images follow the swapchain
+ */
+void createUpscaler() {
+
+	// the rendered corner is resampled between texels
+	VkSamplerCreateInfo samplerCI = {};
+	samplerCI.sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCI.magFilter    = VK_FILTER_LINEAR;
+	samplerCI.minFilter    = VK_FILTER_LINEAR;
+	samplerCI.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+	if (vkCreateSampler(logicalDevice, &samplerCI, nullptr, &resolution.sampler) != VK_SUCCESS) {
+		fputs("Could not create upscale sampler\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	// output as a storage image, the scene target sampled
+	resolution.upscalePipeline = createComputePipeline("spirv/upscale.comp", 0, 1, sizeof(UpscaleParams), 1, 1);
+}
+
+/**
+ * creates the scene target and the upscaled image at the swapchain extent,
+ * and points the upscale pass at them
+ */
+void createResolutionTargets() {
+
+	createImage(
+			resolution.sceneColor, resolution.sceneColorMemory,
+			swapchainExtent.width, swapchainExtent.height, swapchainFormat.format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			1, 1, MEMORY_CATEGORY_TRANSIENT
+			);
+
+	vkBindImageMemory(logicalDevice, resolution.sceneColor, resolution.sceneColorMemory, 0);
+
+	resolution.sceneColorView = createImageView(resolution.sceneColor, swapchainFormat.format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	// swapchain images rarely allow storage, so the upscale writes here and
+	// the blit converts to the swapchain format
+	createImage(
+			resolution.upscaled, resolution.upscaledMemory,
+			swapchainExtent.width, swapchainExtent.height, VK_FORMAT_R16G16B16A16_SFLOAT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			1, 1, MEMORY_CATEGORY_TRANSIENT
+			);
+
+	vkBindImageMemory(logicalDevice, resolution.upscaled, resolution.upscaledMemory, 0);
+
+	resolution.upscaledView = createImageView(resolution.upscaled, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	// written and read in place for its whole life
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask       = 0;
+	imageMemoryBarrier.dstAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+	imageMemoryBarrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemoryBarrier.newLayout           = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image               = resolution.upscaled;
+	imageMemoryBarrier.subresourceRange = {
+		.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+		.baseMipLevel   = 0,
+		.levelCount     = 1,
+		.baseArrayLayer = 0,
+		.layerCount     = 1
+	};
+
+	std::array<VkImageMemoryBarrier, 2> imageMemoryBarriers = { imageMemoryBarrier, imageMemoryBarrier };
+
+	// the rate pass samples the scene target before the first main pass has
+	// rendered to it; what it finds there only steers that first frame
+	imageMemoryBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageMemoryBarriers[1].newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageMemoryBarriers[1].image         = resolution.sceneColor;
+
+	uint32_t barrierCount = shadingRate.attachmentRate ? 2 : 1;
+
+	VkCommandBuffer commandBuffer = beginCommandRecording(commandPool);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, barrierCount, imageMemoryBarriers.data());
+	endCommandRecording(commandBuffer);
+	submitCommandBuffer(commandPool, commandBuffer, graphicsQueue);
+
+	// the set of the previous targets goes with them
+	vkResetDescriptorPool(logicalDevice, resolution.upscalePipeline.descriptorPool, 0);
+
+	resolution.descriptorSet = allocateComputeDescriptorSet(resolution.upscalePipeline);
+
+	writeStorageImageDescriptor(resolution.descriptorSet, 0, resolution.upscaledView);
+	writeSampledImageDescriptor(resolution.descriptorSet, 1, resolution.sampler, resolution.sceneColorView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+/**
+ * resamples what swapchain image i's main pass rendered of the scene target
+ * up to full size and blits it into the image, leaving it ready to present
+ */
+void recordUpscale(VkCommandBuffer commandBuffer, uint32_t i) {
+
+	float scale = resolution.imageScales[i];
+	VkExtent2D renderExtent = getRenderExtent(scale);
+
+	// the previous frame's blit must be done reading the upscaled image
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_BLIT_BIT, 0,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0
+		);
+
+	UpscaleParams upscaleParams = {};
+	upscaleParams.srcSize   = glm::ivec2(renderExtent.width, renderExtent.height);
+	upscaleParams.dstSize   = glm::ivec2(swapchainExtent.width, swapchainExtent.height);
+	upscaleParams.sharpness = UPSCALE_SHARPNESS * (1.0f - scale) / (1.0f - RESOLUTION_MIN_SCALE);
+
+	dispatchCompute(
+			commandBuffer,
+			resolution.upscalePipeline,
+			resolution.descriptorSet,
+			getGroupCount(swapchainExtent.width, UPSCALE_GROUP_SIZE),
+			getGroupCount(swapchainExtent.height, UPSCALE_GROUP_SIZE),
+			1,
+			&upscaleParams
+			);
+
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	// presentation is done with the image once the acquire semaphore, waited
+	// on at transfer, has signalled
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask       = 0;
+	imageMemoryBarrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemoryBarrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemoryBarrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image               = swapchainImages[i];
+	imageMemoryBarrier.subresourceRange = {
+		.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+		.baseMipLevel   = 0,
+		.levelCount     = 1,
+		.baseArrayLayer = 0,
+		.layerCount     = 1
+	};
+
+	vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			1, &imageMemoryBarrier
+		);
+
+	// same size, so this only converts to the swapchain format
+	VkImageBlit imageBlit = {};
+	imageBlit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	imageBlit.srcOffsets[1]  = { static_cast<int32_t>(swapchainExtent.width), static_cast<int32_t>(swapchainExtent.height), 1 };
+	imageBlit.dstSubresource = imageBlit.srcSubresource;
+	imageBlit.dstOffsets[1]  = imageBlit.srcOffsets[1];
+
+	vkCmdBlitImage(
+			commandBuffer,
+			resolution.upscaled, VK_IMAGE_LAYOUT_GENERAL,
+			swapchainImages[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &imageBlit,
+			VK_FILTER_NEAREST
+		);
+
+	// the present semaphore orders presentation after this
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemoryBarrier.dstAccessMask = 0;
+	imageMemoryBarrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageMemoryBarrier.newLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+}
+
+void destroyResolutionTargets() {
+
+	VkImageView sceneColorView = resolution.sceneColorView;
+	VkImage sceneColor = resolution.sceneColor;
+	VkDeviceMemory sceneColorMemory = resolution.sceneColorMemory;
+	VkImageView upscaledView = resolution.upscaledView;
+	VkImage upscaled = resolution.upscaled;
+	VkDeviceMemory upscaledMemory = resolution.upscaledMemory;
+
+	deferDeletion([=]() {
+		vkDestroyImageView(logicalDevice, sceneColorView, nullptr);
+		vkDestroyImage(logicalDevice, sceneColor, nullptr);
+		freeMemory(sceneColorMemory);
+
+		vkDestroyImageView(logicalDevice, upscaledView, nullptr);
+		vkDestroyImage(logicalDevice, upscaled, nullptr);
+		freeMemory(upscaledMemory);
+	});
+
+	resolution.descriptorSet = VK_NULL_HANDLE;
+}
+
+void destroyUpscaler() {
+	destroyComputePipeline(resolution.upscalePipeline);
+	vkDestroySampler(logicalDevice, resolution.sampler, nullptr);
+}
+
+/**
+ * pipeline of the rate pass; it samples the scene target through the upscale
+ * sampler, so comes after createUpscaler
+ */
+void createShadingRatePass() {
+
+	VkSpecializationMapEntry entries[] = {
+		{ 0, offsetof(ShadingRateConstants, flatContrast), sizeof(float) },
+		{ 1, offsetof(ShadingRateConstants, periphery), sizeof(float) }
+	};
+
+	VkSpecializationInfo specializationI = {};
+	specializationI.mapEntryCount = 2;
+	specializationI.pMapEntries   = entries;
+	specializationI.dataSize      = sizeof(ShadingRateConstants);
+	specializationI.pData         = &SHADING_RATE_CONSTANTS;
+
+	// rates as a storage image, the scene target sampled
+	shadingRate.ratePipeline = createComputePipeline("spirv/shading_rate.comp", 0, 1, sizeof(ShadingRateParams), 1, 1, &specializationI);
+}
+
+/**
+ * creates the rate image at the swapchain extent and points the rate pass at
+ * it and the scene target
+ */
+void createShadingRateImage() {
+
+	uint32_t width = getGroupCount(swapchainExtent.width, shadingRate.texelSize.width);
+	uint32_t height = getGroupCount(swapchainExtent.height, shadingRate.texelSize.height);
+
+	createImage(
+			shadingRate.image, shadingRate.memory,
+			width, height, VK_FORMAT_R8_UINT,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			1, 1, MEMORY_CATEGORY_TRANSIENT
+			);
+
+	vkBindImageMemory(logicalDevice, shadingRate.image, shadingRate.memory, 0);
+
+	shadingRate.view = createImageView(shadingRate.image, VK_FORMAT_R8_UINT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	// written by the rate pass and read by the main pass in place
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask       = 0;
+	imageMemoryBarrier.dstAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+	imageMemoryBarrier.oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemoryBarrier.newLayout           = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image               = shadingRate.image;
+	imageMemoryBarrier.subresourceRange = {
+		.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+		.baseMipLevel   = 0,
+		.levelCount     = 1,
+		.baseArrayLayer = 0,
+		.layerCount     = 1
+	};
+
+	VkCommandBuffer commandBuffer = beginCommandRecording(commandPool);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+	endCommandRecording(commandBuffer);
+	submitCommandBuffer(commandPool, commandBuffer, graphicsQueue);
+
+	shadingRate.previousScale = resolution.controller.getScale();
+
+	vkResetDescriptorPool(logicalDevice, shadingRate.ratePipeline.descriptorPool, 0);
+
+	shadingRate.descriptorSet = allocateComputeDescriptorSet(shadingRate.ratePipeline);
+
+	writeStorageImageDescriptor(shadingRate.descriptorSet, 0, shadingRate.view);
+	writeSampledImageDescriptor(shadingRate.descriptorSet, 1, resolution.sampler, resolution.sceneColorView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+/**
+ * writes the rates of a main pass rendering at scale from what the previous
+ * frame left in the scene target
+ */
+void recordShadingRate(VkCommandBuffer commandBuffer, float scale) {
+
+	VkExtent2D renderExtent = getRenderExtent(scale);
+	VkExtent2D previousExtent = getRenderExtent(shadingRate.previousScale);
+
+	ShadingRateParams shadingRateParams = {};
+	shadingRateParams.rateSize = glm::ivec2(
+			getGroupCount(renderExtent.width, shadingRate.texelSize.width),
+			getGroupCount(renderExtent.height, shadingRate.texelSize.height));
+	shadingRateParams.tileSize     = glm::ivec2(shadingRate.texelSize.width, shadingRate.texelSize.height);
+	shadingRateParams.renderSize   = glm::vec2(renderExtent.width, renderExtent.height);
+	shadingRateParams.previousSize = glm::vec2(previousExtent.width, previousExtent.height);
+
+	// the previous main pass must be done reading the rates
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR, 0,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0
+		);
+
+	dispatchCompute(
+			commandBuffer,
+			shadingRate.ratePipeline,
+			shadingRate.descriptorSet,
+			getGroupCount(shadingRateParams.rateSize.x, SHADING_RATE_GROUP_SIZE),
+			getGroupCount(shadingRateParams.rateSize.y, SHADING_RATE_GROUP_SIZE),
+			1,
+			&shadingRateParams
+			);
+
+	recordMemoryBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR, VK_ACCESS_2_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR
+		);
+
+	shadingRate.previousScale = scale;
+}
+
+void destroyShadingRateImage() {
+
+	VkImageView view = shadingRate.view;
+	VkImage image = shadingRate.image;
+	VkDeviceMemory memory = shadingRate.memory;
+
+	deferDeletion([=]() {
+		vkDestroyImageView(logicalDevice, view, nullptr);
+		vkDestroyImage(logicalDevice, image, nullptr);
+		freeMemory(memory);
+	});
+
+	shadingRate.descriptorSet = VK_NULL_HANDLE;
+}
+
+/**
+ * records swapchain image i's command buffer at the image's render scale:
+ * the shadow pass, the main pass and, with dynamic resolution, the upscale
+ * into the image. The draws use the LODs and occlusion objects
+ * recordRenderpasses picked
+ */
+void recordRenderpass(uint32_t i) {
+
+	VkCommandBufferBeginInfo commandBufferBI = {};
+	commandBufferBI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	commandBufferBI.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffers[i], &commandBufferBI) != VK_SUCCESS) {
+		fputs("Unable to begin command buffer\n", stderr);
+	}
+
+	// build and sort this command buffer's draws (descriptor sets are per swapchain image);
+	// pass 0 is the depth pre-pass, pass 1 the opaque pass
+	drawQueue.clear();
+
+	for (uint32_t m = 0; m < meshes.size(); m++) {
+
+		const Mesh &mesh = meshes[m];
+		const MeshLod &lod = mesh.lods[meshLods[m]];
+
+		float distance = glm::length(mesh.center - cameraPosition);
+		uint16_t depth = DrawQueue::quantiseDepth(distance, cameraNear, cameraFar);
+
+		DrawCommand draw = {};
+		draw.key            = DrawQueue::makeKey(1, 0, 0, m, depth);
+		draw.pipeline       = graphicsPipeline;
+		draw.pipelineLayout = pipelineLayout;
+		draw.descriptorSet  = descriptorSets.empty() ? VK_NULL_HANDLE : descriptorSets[i];
+		draw.vertexBuffer   = geometry.vertexBuffer;
+		draw.indexBuffer    = geometry.indexBuffer;
+		draw.count          = lod.indexCount;
+		draw.instanceCount  = 1;
+		draw.firstIndex     = lod.firstIndex;
+		draw.vertexOffset   = mesh.vertexOffset;
+
+		if (occlusionCulling) {
+			draw.indirectBuffer = occlusion.buffers[OCCLUSION_BUFFER_DRAWS];
+			draw.indirectOffset = m * sizeof(VkDrawIndexedIndirectCommand);
+		}
+
+		drawQueue.push(draw);
+
+		// the same draw, depth only, in the pass before
+		if (depthPrepass) {
+			draw.key      = DrawQueue::makeKey(0, 0, 0, m, depth);
+			draw.pipeline = depthPrepassPipeline;
+			drawQueue.push(draw);
+		}
+	}
+
+	// characters draw the vertices skinned this frame, like any other mesh
+	for (uint32_t c = 0; c < characters.count; c++) {
+
+		float distance = glm::length(characters.positions[c] - cameraPosition);
+		uint16_t depth = DrawQueue::quantiseDepth(distance, cameraNear, cameraFar);
+
+		DrawCommand draw = {};
+		draw.key            = DrawQueue::makeKey(1, 0, 0, static_cast<uint32_t>(meshes.size()), depth);
+		draw.pipeline       = graphicsPipeline;
+		draw.pipelineLayout = pipelineLayout;
+		draw.descriptorSet  = descriptorSets.empty() ? VK_NULL_HANDLE : descriptorSets[i];
+		draw.vertexBuffer   = characters.skinnedBuffer;
+		draw.indexBuffer    = geometry.indexBuffer;
+		draw.count          = characters.indexCount;
+		draw.instanceCount  = 1;
+		draw.firstIndex     = characters.firstIndex;
+		draw.vertexOffset   = static_cast<int32_t>(c * characters.vertexCount);
+
+		if (occlusionCulling) {
+			draw.indirectBuffer = occlusion.buffers[OCCLUSION_BUFFER_DRAWS];
+			draw.indirectOffset = (meshes.size() + c) * sizeof(VkDrawIndexedIndirectCommand);
+		}
+
+		drawQueue.push(draw);
+
+		if (depthPrepass) {
+			draw.key      = DrawQueue::makeKey(0, 0, 0, static_cast<uint32_t>(meshes.size()), depth);
+			draw.pipeline = depthPrepassPipeline;
+			drawQueue.push(draw);
+		}
+	}
+
+	drawQueue.sort();
+
+	// GPU time of the frame feeds the frame pacer
+	if (timestampQueryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(commandBuffers[i], timestampQueryPool, TIMESTAMPS_PER_IMAGE * i, TIMESTAMPS_PER_IMAGE);
+		vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, TIMESTAMPS_PER_IMAGE * i);
+	}
+
+	if (shadows.enabled)
+		recordShadowPass(commandBuffers[i]);
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, TIMESTAMPS_PER_IMAGE * i + 1);
+
+	VkExtent2D renderExtent = getRenderExtent(resolution.imageScales[i]);
+
+	VkViewport viewport = {};
+	viewport.x        = 0.0f;
+	viewport.y        = 0.0f;
+	viewport.width    = renderExtent.width;
+	viewport.height   = renderExtent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = renderExtent;
+
+	glm::vec2 viewportSize(renderExtent.width, renderExtent.height);
+
+	// start of renderpass
+	beginMainPass(commandBuffers[i], i, renderExtent);
+
+		vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
+		vkCmdPushConstants(commandBuffers[i], pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(viewportSize), &viewportSize);
+
+		drawQueue.record(commandBuffers[i]);
+
+		// particles last, blended over the scene; the count comes from the GPU
+		if (particles.maxParticles > 0) {
+			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, particles.drawPipeline);
+			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, particles.drawPipelineLayout, 0, 1, &particles.drawDescriptorSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffers[i], particles.drawPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ParticleDrawParams), &particles.drawParams);
+			vkCmdDrawIndirect(commandBuffers[i], particles.buffers[PARTICLE_BUFFER_COUNTERS], 0, 1, sizeof(VkDrawIndirectCommand));
+		}
+
+	endMainPass(commandBuffers[i], i);
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, TIMESTAMPS_PER_IMAGE * i + 2);
+
+	if (resolution.enabled)
+		recordUpscale(commandBuffers[i], i);
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, TIMESTAMPS_PER_IMAGE * i + 3);
+
+	if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
+		fputs("Failed to end command buffer\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+#if defined(DEBUG)
+	const DrawStats &stats = drawQueue.getStats();
+	fprintf(stdout,
+			"command buffer %u: %u draws, %u pipeline binds, %u descriptor set binds, %u skipped binds\n",
+			i, stats.draws, stats.pipelineBinds, stats.descriptorSetBinds, stats.skippedBinds
+			);
+#endif
+
+}
+
+void recordRenderpasses() {
+
+	PROFILE_FUNCTION();
+
+	selectMeshLods();
+
+	// what the cull pass writes each object's indirect draw from, in draw order
+	if (occlusionCulling) {
+
+		for (uint32_t m = 0; m < meshes.size(); m++) {
+
+			const Mesh &mesh = meshes[m];
+			const MeshLod &lod = mesh.lods[meshLods[m]];
+
+			occlusion.objects[m] = { glm::vec4(mesh.center, mesh.radius), lod.indexCount, lod.firstIndex, mesh.vertexOffset, 0 };
+		}
+
+		for (uint32_t c = 0; c < characters.count; c++) {
+			occlusion.objects[meshes.size() + c] = {
+				glm::vec4(characters.positions[c] + glm::vec3(0.0f, 0.5f, 0.0f), 0.75f),
+				characters.indexCount, characters.firstIndex, static_cast<int32_t>(c * characters.vertexCount), 0
+			};
+		}
+	}
+
+	for (uint32_t i = 0; i < commandBuffers.size(); i++)
+		recordRenderpass(i);
+}
+
+/**
+ * creates a pool of TIMESTAMPS_PER_IMAGE timestamps per swapchain image, if
+ * the graphics queue can write timestamps at all
+ */
+VkQueryPool createTimestampQueryPool() {
+
+	const std::vector<VkQueueFamilyProperties> &queueFamilies = deviceCapabilities.queueFamilies;
+	const VkPhysicalDeviceProperties &properties = deviceCapabilities.properties;
+
+	if (queueFamilies[graphicsFamilyIndex].timestampValidBits == 0 || properties.limits.timestampPeriod == 0.0f)
+		return VK_NULL_HANDLE;
+
+	timestampPeriod = properties.limits.timestampPeriod * 1e-9;
+	gpuClock.init(properties.limits.timestampPeriod);
+
+	VkQueryPoolCreateInfo queryPoolCI = {};
+	queryPoolCI.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCI.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCI.queryCount = TIMESTAMPS_PER_IMAGE * static_cast<uint32_t>(swapchainImageViews.size());
+
+	VkQueryPool queryPool;
+
+	if (vkCreateQueryPool(logicalDevice, &queryPoolCI, nullptr, &queryPool) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	return queryPool;
+}
+
+VkSemaphore createSemaphore() {
+
+	VkSemaphoreCreateInfo semaphoreCI = {};
+	semaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	VkSemaphore semaphore;
+
+	if (vkCreateSemaphore(logicalDevice, &semaphoreCI, nullptr, &semaphore) != VK_SUCCESS) {
+		fputs("Could not create semaphore\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	return semaphore;
+}
+
+std::vector<FrameSync> createFrameSync(uint32_t framesInFlight) {
+
+	std::vector<FrameSync> frames(framesInFlight);
+
+	VkFenceCreateInfo fenceCI = {};
+	fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceCI.flags = VK_FENCE_CREATE_SIGNALED_BIT;	// nothing to wait for on the first frame
+
+	for (FrameSync &frame : frames) {
+
+		frame.imageAvailable = createSemaphore();
+
+		if (vkCreateFence(logicalDevice, &fenceCI, nullptr, &frame.inFlight) != VK_SUCCESS) {
+			fputs("Could not create fence\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+
+		VkCommandBufferAllocateInfo commandBufferAI = {};
+		commandBufferAI.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAI.commandPool        = commandPool;
+		commandBufferAI.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAI.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(logicalDevice, &commandBufferAI, &frame.commandBuffer) != VK_SUCCESS) {
+			fputs("Failed to allocate command buffers\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+
+		frame.imageIndex = 0;
+		frame.timestampsWritten = false;
+		frame.frameNumber = 0;
+
+		frame.arenas.resize(jobs.getThreadCount());
+
+		for (LinearArena &arena : frame.arenas)
+			arena.init(FRAME_ARENA_SIZE);
+	}
+
+	return frames;
+}
+
+/**
+ * the calling thread's arena for the frame being built; what it allocates
+ * lives until this frame slot comes round again
+ */
+LinearArena &getFrameArena() {
+	return frames[currentFrame].arenas[JobSystem::getThreadIndex()];
+}
+
+/**
+ * creates everything sized by or per swapchain image, once the swapchain exists
+ */
+void createSwapchainResources() {
+
+	swapchainImageViews = createSwapchainImageViews();
+
+	depthBuffer = createDepthBuffer();
+
+	if (occlusionCulling)
+		createHiZPyramid();
+
+	if (resolution.enabled)
+		createResolutionTargets();
+
+	if (shadingRate.attachmentRate)
+		createShadingRateImage();
+
+	// the 1.3 path renders straight to the image views
+	if (!dynamicRenderingEnabled)
+		swapchainFramebuffers = createFramebuffers();
+
+	commandBuffers = createCommandBuffers(commandPool);
+
+	renderFinishedSemaphores.resize(swapchainImageViews.size());
+	for (VkSemaphore &semaphore : renderFinishedSemaphores)
+		semaphore = createSemaphore();
+
+	imagesInFlight.assign(swapchainImageViews.size(), VK_NULL_HANDLE);
+	resolution.imageScales.assign(swapchainImageViews.size(), resolution.controller.getScale());
+
+	timestampQueryPool = createTimestampQueryPool();
+
+	for (FrameSync &frame : frames)
+		frame.timestampsWritten = false;
+
+	updateCameraBuffers();
+	createDescriptorPool();
+	createDescriptorSets();
+
+	recordRenderpasses();
+}
+
+/**
+ * releases everything sized to the swapchain, the swapchain included. Frames
+ * in flight may still use it all, so it is destroyed once they complete; the
+ * swapchain handle stays valid until then to be passed as the old swapchain
+ */
+void destroySwapchainResources() {
+
+	VkQueryPool queryPool = timestampQueryPool;
+	VkDescriptorPool pool = descriptorPool;
+	std::vector<VkSemaphore> semaphores = renderFinishedSemaphores;
+	std::vector<VkCommandBuffer> buffers = commandBuffers;
+	std::vector<VkFramebuffer> framebuffers = swapchainFramebuffers;
+	VkImageView depthView = depthBufferView;
+	VkImage depthImage = depthBuffer;
+	VkDeviceMemory depthMemory = depthBufferMemory;
+	std::vector<VkImageView> imageViews = swapchainImageViews;
+	VkSwapchainKHR oldSwapchain = swapchain;
+
+	deferDeletion([=]() {
+		if (queryPool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(logicalDevice, queryPool, nullptr);
+
+		// frees the descriptor sets with it
+		vkDestroyDescriptorPool(logicalDevice, pool, nullptr);
+
+		for (VkSemaphore semaphore : semaphores)
+			vkDestroySemaphore(logicalDevice, semaphore, nullptr);
+
+		vkFreeCommandBuffers(logicalDevice, commandPool, static_cast<uint32_t>(buffers.size()), buffers.data());
+
+		for (VkFramebuffer framebuffer : framebuffers)
+			vkDestroyFramebuffer(logicalDevice, framebuffer, nullptr);
+
+		vkDestroyImageView(logicalDevice, depthView, nullptr);
+		vkDestroyImage(logicalDevice, depthImage, nullptr);
+		freeMemory(depthMemory);
+
+		for (VkImageView imageView : imageViews)
+			vkDestroyImageView(logicalDevice, imageView, nullptr);
+
+		vkDestroySwapchainKHR(logicalDevice, oldSwapchain, nullptr);
+	});
+
+	if (occlusionCulling)
+		destroyHiZPyramid();
+
+	if (resolution.enabled)
+		destroyResolutionTargets();
+
+	if (shadingRate.attachmentRate)
+		destroyShadingRateImage();
+
+	timestampQueryPool = VK_NULL_HANDLE;
+	renderFinishedSemaphores.clear();
+	commandBuffers.clear();
+	swapchainFramebuffers.clear();
+	swapchainImageViews.clear();
+}
+
+/**
+ * waits for the frames in flight, without idling the other queues
+ */
+void waitForFramesInFlight() {
+	for (FrameSync &frame : frames)
+		vkWaitForFences(logicalDevice, 1, &frame.inFlight, VK_TRUE, UINT64_MAX);
+}
+
+void recreateSwapchain() {
+
+#if !defined(USE_NULLWS)
+	// a minimised window has no area to create a swapchain for
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+
+	while (width == 0 || height == 0) {
+		glfwWaitEvents();
+		glfwGetFramebufferSize(window, &width, &height);
+	}
+#endif
+
+	// the pyramid and upscale passes rewrite their descriptor sets in place,
+	// which frames in flight may still be reading; everything else is released
+	// into the deletion queue and the new resources are built alongside
+	if (occlusionCulling || resolution.enabled)
+		waitForFramesInFlight();
+
+	destroySwapchainResources();
+
+	swapchain = createSwapchain(swapchain);
+
+	// the aspect ratio may have changed
+	if (particles.maxParticles > 0)
+		updateParticleCamera();
+
+	createSwapchainResources();
+
+	framebufferResized = false;
+}
+
+/**
+ * hands the GPU time of a completed frame to the frame pacer and the
+ * resolution controller, and its passes to the profiler
+ */
+void readFrameTimestamps(FrameSync &frame) {
+
+	if (!frame.timestampsWritten)
+		return;
+
+	frame.timestampsWritten = false;
+
+	uint64_t timestamps[TIMESTAMPS_PER_IMAGE];
+
+	// the image may already have been resubmitted, in which case the
+	// results are not ready and this sample is skipped
+	VkResult result = vkGetQueryPoolResults(
+			logicalDevice, timestampQueryPool,
+			TIMESTAMPS_PER_IMAGE * frame.imageIndex, TIMESTAMPS_PER_IMAGE,
+			sizeof(timestamps), timestamps, sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT
+			);
+
+	if (result != VK_SUCCESS || timestamps[3] <= timestamps[0])
+		return;
+
+	framePacer.gpuFrameCompleted((timestamps[3] - timestamps[0]) * timestampPeriod);
+
+	// only the main pass costs less at a lower resolution
+	if (resolution.enabled) {
+		uint64_t mainPass = timestamps[2] - timestamps[1];
+		resolution.controller.gpuFrameCompleted((timestamps[3] - timestamps[0] - mainPass) * timestampPeriod, mainPass * timestampPeriod, frame.renderScale);
+	}
+
+#if defined(PROFILE)
+	gpuClock.observe(timestamps[2], profilerNow());
+
+	if (shadows.enabled)
+		PROFILE_GPU_ZONE("shadow pass", gpuClock.toCpuTime(timestamps[0]), gpuClock.toCpuTime(timestamps[1]));
+
+	PROFILE_GPU_ZONE("main pass", gpuClock.toCpuTime(timestamps[1]), gpuClock.toCpuTime(timestamps[2]));
+
+	if (resolution.enabled)
+		PROFILE_GPU_ZONE("upscale", gpuClock.toCpuTime(timestamps[2]), gpuClock.toCpuTime(timestamps[3]));
+#endif
+}
+
+/**
+ * for --capture: a buffer the swapchain image fits in, and the command buffer
+ * that copies it there. Needs the frame slots, to know which frame ends the
+ * allocation count
+ */
+void createFrameCapture() {
+
+	capture.frameNumber = ALLOCATION_WARMUP_CYCLES * frames.size() + benchAllocationFrames;
+	capture.copied = false;
+
+	createBuffer(capture.buffer, capture.memory,
+			static_cast<VkDeviceSize>(swapchainExtent.width) * swapchainExtent.height * 4,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			MEMORY_CATEGORY_STAGING);
+
+	VkCommandBufferAllocateInfo commandBufferAI = {};
+	commandBufferAI.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferAI.commandPool        = commandPool;
+	commandBufferAI.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferAI.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(logicalDevice, &commandBufferAI, &capture.commandBuffer) != VK_SUCCESS) {
+		fputs("Could not allocate capture command buffer\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * copies the swapchain image into the capture buffer, after everything before
+ * it in the submission, and hands the image back for presenting
+ */
+void recordFrameCapture(VkImage image) {
+
+	VkCommandBufferBeginInfo commandBufferBI = {};
+	commandBufferBI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	commandBufferBI.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(capture.commandBuffer, &commandBufferBI);
+
+	// the image was last drawn to or, with dynamic resolution, blitted to
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemoryBarrier.dstAccessMask       = VK_ACCESS_TRANSFER_READ_BIT;
+	imageMemoryBarrier.oldLayout           = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	imageMemoryBarrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image               = image;
+	imageMemoryBarrier.subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	vkCmdPipelineBarrier(capture.commandBuffer,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent      = { swapchainExtent.width, swapchainExtent.height, 1 };
+
+	vkCmdCopyImageToBuffer(capture.commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, capture.buffer, 1, &region);
+
+	imageMemoryBarrier.srcAccessMask = 0;
+	imageMemoryBarrier.dstAccessMask = 0;
+	imageMemoryBarrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageMemoryBarrier.newLayout     = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(capture.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 1, &memoryBarrier, 0, nullptr, 1, &imageMemoryBarrier);
+
+	vkEndCommandBuffer(capture.commandBuffer);
+
+	capture.extent = swapchainExtent;
+	capture.copied = true;
+}
+
+/**
+ * writes the captured frame to capturePath as RGB; the device must be idle
+ */
+void writeFrameCapture() {
+
+	if (!capture.copied) {
+		fprintf(stderr, "The run ended before frame %llu, nothing captured\n", static_cast<unsigned long long>(capture.frameNumber));
+		exit(EXIT_FAILURE);
+	}
+
+	bool bgr;
+
+	switch (swapchainFormat.format) {
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		bgr = true;
+		break;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		bgr = false;
+		break;
+	default:
+		fprintf(stderr, "Cannot capture swapchain format %d\n", swapchainFormat.format);
+		exit(EXIT_FAILURE);
+	}
+
+	FILE *file = fopen(capturePath, "wb");
+
+	if (!file) {
+		fprintf(stderr, "Could not open %s for writing\n", capturePath);
+		exit(EXIT_FAILURE);
+	}
+
+	void *mapped;
+	vkMapMemory(logicalDevice, capture.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+
+	const uint8_t *texels = static_cast<const uint8_t *>(mapped);
+
+	fprintf(file, "P6\n%u %u\n255\n", capture.extent.width, capture.extent.height);
+
+	std::vector<uint8_t> row(capture.extent.width * 3);
+
+	for (uint32_t y = 0; y < capture.extent.height; y++) {
+
+		for (uint32_t x = 0; x < capture.extent.width; x++) {
+			const uint8_t *texel = texels + (static_cast<size_t>(y) * capture.extent.width + x) * 4;
+			row[x * 3 + 0] = texel[bgr ? 2 : 0];
+			row[x * 3 + 1] = texel[1];
+			row[x * 3 + 2] = texel[bgr ? 0 : 2];
+		}
+
+		fwrite(row.data(), 1, row.size(), file);
+	}
+
+	vkUnmapMemory(logicalDevice, capture.memory);
+	fclose(file);
+}
+
+void destroyFrameCapture() {
+	vkFreeCommandBuffers(logicalDevice, commandPool, 1, &capture.commandBuffer);
+	vkDestroyBuffer(logicalDevice, capture.buffer, nullptr);
+	freeMemory(capture.memory);
+}
+
+void drawFrame() {
+
+	PROFILE_FUNCTION();
+
+	FrameSync &frame = frames[currentFrame];
+
+	{
+		PROFILE_ZONE("wait for frame in flight");
+		vkWaitForFences(logicalDevice, 1, &frame.inFlight, VK_TRUE, UINT64_MAX);
+	}
+
+	// frames complete in submission order on the one queue
+	completedFrames = std::max(completedFrames, frame.frameNumber);
+	deletionQueue.collect(completedFrames);
+
+	for (LinearArena &arena : frame.arenas)
+		arena.reset();
+
+	readFrameTimestamps(frame);
+
+	{
+		PROFILE_ZONE("frame pacing");
+		framePacer.waitForFrameStart();
+	}
+
+	uint32_t imageIndex;
+	VkResult result;
+
+	{
+		PROFILE_ZONE("acquire");
+		result = vkAcquireNextImageKHR(logicalDevice, swapchain, UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
+	}
+
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		recreateSwapchain();
+		return;
+	} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+		fputs("Could not acquire swapchain image\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	// an earlier frame may still be rendering to this image
+	if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+		PROFILE_ZONE("wait for image in flight");
+		vkWaitForFences(logicalDevice, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+	}
+
+	imagesInFlight[imageIndex] = frame.inFlight;
+
+	// the image is idle, so its command buffer can be recorded again at the current scale
+	if (resolution.enabled && resolution.imageScales[imageIndex] != resolution.controller.getScale()) {
+		PROFILE_ZONE("record at new resolution");
+		resolution.imageScales[imageIndex] = resolution.controller.getScale();
+		recordRenderpass(imageIndex);
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	float dt = capture.frameNumber > 0 ? CAPTURE_TIME_STEP : std::min(std::chrono::duration<float>(now - lastFrameTime).count(), 0.1f);
+	lastFrameTime = now;
+
+	if (memoryReportInterval > 0 && std::chrono::duration<double>(now - lastMemoryReport).count() >= memoryReportInterval) {
+		reportMemory();
+		lastMemoryReport = now;
+	} else if (std::chrono::duration<double>(now - lastMemoryBudgetUpdate).count() >= MEMORY_BUDGET_INTERVAL) {
+		updateMemoryBudget();
+	}
+
+	// work that changes every frame goes ahead of the pre-recorded render pass
+	ArenaVector<VkCommandBuffer> submitCommandBuffers{ArenaAllocator<VkCommandBuffer>(getFrameArena())};
+	submitCommandBuffers.reserve(3);
+
+	if (particles.maxParticles > 0 || characters.count > 0 || lightGrid.lightCount > 0 || occlusionCulling || shadingRate.attachmentRate) {
+
+		PROFILE_ZONE("record frame work");
+
+		vkResetCommandBuffer(frame.commandBuffer, 0);
+
+		VkCommandBufferBeginInfo commandBufferBI = {};
+		commandBufferBI.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		commandBufferBI.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkBeginCommandBuffer(frame.commandBuffer, &commandBufferBI);
+
+		if (particles.maxParticles > 0)
+			recordParticleUpdate(frame.commandBuffer, dt);
+
+		if (characters.count > 0)
+			recordSkinning(frame.commandBuffer, currentFrame, dt);
+
+		if (lightGrid.lightCount > 0)
+			recordLightCulling(frame.commandBuffer);
+
+		if (occlusionCulling)
+			recordOcclusionCulling(frame.commandBuffer);
+
+		if (shadingRate.attachmentRate)
+			recordShadingRate(frame.commandBuffer, resolution.imageScales[imageIndex]);
+
+		vkEndCommandBuffer(frame.commandBuffer);
+
+		submitCommandBuffers.push_back(frame.commandBuffer);
+	}
+
+	submitCommandBuffers.push_back(commandBuffers[imageIndex]);
+
+	if (submittedFrames + 1 == capture.frameNumber) {
+		recordFrameCapture(swapchainImages[imageIndex]);
+		submitCommandBuffers.push_back(capture.commandBuffer);
+	}
+
+	// simulation, skinning and culling must not wait for the image, only
+	// drawing (or the blit into it) must
+	VkPipelineStageFlags waitStageMask = resolution.enabled ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+	VkSubmitInfo submitI = {};
+	submitI.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitI.waitSemaphoreCount   = 1;
+	submitI.pWaitSemaphores      = &frame.imageAvailable;
+	submitI.pWaitDstStageMask    = &waitStageMask;
+	submitI.commandBufferCount   = static_cast<uint32_t>(submitCommandBuffers.size());
+	submitI.pCommandBuffers      = submitCommandBuffers.data();
+	submitI.signalSemaphoreCount = 1;
+	submitI.pSignalSemaphores    = &renderFinishedSemaphores[imageIndex];
+
+	vkResetFences(logicalDevice, 1, &frame.inFlight);
+
+	{
+		PROFILE_ZONE("submit");
+
+		result = vkQueueSubmit(graphicsQueue, 1, &submitI, frame.inFlight);
+
+		if (result != VK_SUCCESS) {
+			fputs("Could not submit frame\n", stderr);
+
+			// show what was resident when the device was lost
+			if (result == VK_ERROR_DEVICE_LOST)
+				reportMemory();
+
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	frame.imageIndex = imageIndex;
+	frame.renderScale = resolution.imageScales[imageIndex];
+	frame.timestampsWritten = timestampQueryPool != VK_NULL_HANDLE;
+	frame.frameNumber = ++submittedFrames;
+
+	framePacer.frameSubmitted();
+
+	VkPresentInfoKHR presentI = {};
+	presentI.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentI.waitSemaphoreCount = 1;
+	presentI.pWaitSemaphores    = &renderFinishedSemaphores[imageIndex];
+	presentI.swapchainCount     = 1;
+	presentI.pSwapchains        = &swapchain;
+	presentI.pImageIndices      = &imageIndex;
+
+	{
+		PROFILE_ZONE("present");
+		result = vkQueuePresentKHR(presentQueue, &presentI);
+	}
+
+	if (startupReport && submittedFrames == 1)
+		printf("first frame presented %.1fms after start\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupTime).count());
+
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+		recreateSwapchain();
+	} else if (result != VK_SUCCESS) {
+		fputs("Could not present swapchain image\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	currentFrame = (currentFrame + 1) % frames.size();
+}
+
+/**
+ * for --bench-allocations: counts heap allocations over benchAllocationFrames
+ * frames after the warm-up, and returns true once the count is in
+ */
+bool frameAllocationCountDone() {
+
+	if (benchAllocationFrames == 0)
+		return false;
+
+	uint64_t warmupFrames = ALLOCATION_WARMUP_CYCLES * frames.size();
+
+	auto now = std::chrono::steady_clock::now();
+
+	if (submittedFrames < warmupFrames) {
+		warmupAllocationCount = getHeapAllocationCount();
+		lastCountedFrame = now;
+		return false;
+	}
+
+	steadyFrameTimes.push_back(std::chrono::duration<double, std::milli>(now - lastCountedFrame).count());
+	lastCountedFrame = now;
+
+	if (submittedFrames < warmupFrames + benchAllocationFrames)
+		return false;
+
+	steadyFrameAllocations = getHeapAllocationCount() - warmupAllocationCount;
+
+	size_t arenaHighWater = 0;
+	uint32_t arenaGrowCount = 0;
+
+	for (const FrameSync &frame : frames) {
+		for (const LinearArena &arena : frame.arenas) {
+			arenaHighWater = std::max(arenaHighWater, arena.getHighWater());
+			arenaGrowCount += arena.getGrowCount();
+		}
+	}
+
+	printf("%u steady frames: %llu heap allocations (%.2f per frame)\n",
+			benchAllocationFrames, static_cast<unsigned long long>(steadyFrameAllocations),
+			static_cast<double>(steadyFrameAllocations) / benchAllocationFrames);
+	printf("frame arenas: %.1f KiB high water, grown %u times\n", arenaHighWater / 1024.0, arenaGrowCount);
+
+	double totalTime = std::accumulate(steadyFrameTimes.begin(), steadyFrameTimes.end(), 0.0);
+	std::sort(steadyFrameTimes.begin(), steadyFrameTimes.end());
+
+	printf("frame time: %.3fms mean, %.3fms median, %.3fms worst\n", totalTime / steadyFrameTimes.size(),
+			steadyFrameTimes[steadyFrameTimes.size() / 2], steadyFrameTimes.back());
+
+	return true;
+}
+
+void loop() {
+#if defined(USE_NULLWS)
+	while (!frameAllocationCountDone())
+		drawFrame();
+#else
+	while (!glfwWindowShouldClose(window) && !frameAllocationCountDone()) {
+		glfwPollEvents();
+		drawFrame();
+	}
+#endif
+
+	vkDeviceWaitIdle(logicalDevice);
+}
+
+void cleanup() {
+
+	vkDeviceWaitIdle(logicalDevice);
+
+	vkDestroyBuffer(logicalDevice, geometry.vertexBuffer, nullptr);
+	freeMemory(geometry.vertexBufferMemory);
+	vkDestroyBuffer(logicalDevice, geometry.indexBuffer, nullptr);
+	freeMemory(geometry.indexBufferMemory);
+
+	vkUnmapMemory(logicalDevice, stagingBufferMemory);
+	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+	freeMemory(stagingBufferMemory);
+
+	for (Texture &texture : textures) {
+		vkDestroyImageView(logicalDevice, texture.view, nullptr);
+		vkDestroyImage(logicalDevice, texture.image, nullptr);
+		freeMemory(texture.memory);
+	}
+
+	destroySwapchainResources();
+
+	if (particles.maxParticles > 0)
+		destroyParticleSystem();
+
+	if (characters.count > 0)
+		destroySkinnedCharacters();
+
+	destroyLightGrid();
+	destroyShadowResources();
+
+	if (occlusionCulling)
+		destroyOcclusionCuller();
+
+	if (shadingRate.attachmentRate)
+		destroyComputePipeline(shadingRate.ratePipeline);
+
+	if (resolution.enabled)
+		destroyUpscaler();
+
+	vkDestroyPipeline(logicalDevice, depthPrepassPipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, graphicsPipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+
+	if (renderpass != VK_NULL_HANDLE)
+		vkDestroyRenderPass(logicalDevice, renderpass, nullptr);
+
+	vkDestroyBuffer(logicalDevice, uniformBuffer, nullptr);
+	freeMemory(uniformBufferMemory);
+
+	for (FrameSync &frame : frames) {
+		vkDestroySemaphore(logicalDevice, frame.imageAvailable, nullptr);
+		vkDestroyFence(logicalDevice, frame.inFlight, nullptr);
+	}
+
+	vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
+
+	// the device is idle, so whatever is still queued can go now
+	deletionQueue.flush();
+
+	vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+	vkDestroyCommandPool(logicalDevice, computeCommandPool, nullptr);
+	vkDestroyCommandPool(logicalDevice, transferCommandPool, nullptr);
+
+	vkDestroySurfaceKHR(instance, surface, nullptr);
+
+	vkDestroyDevice(logicalDevice, nullptr);
+
+	vkDestroyInstance(instance, nullptr);
+
+	jobs.shutdown();
+}
+
+/**
+ * tears down what startup created before --bench-reduce ran; the frame
+ * resources, scene and its systems were never built on that path
+ */
+void cleanupBenchmark() {
+
+	vkDeviceWaitIdle(logicalDevice);
+
+	vkUnmapMemory(logicalDevice, stagingBufferMemory);
+	vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+	freeMemory(stagingBufferMemory);
+
+	vkDestroyPipeline(logicalDevice, depthPrepassPipeline, nullptr);
+	vkDestroyPipeline(logicalDevice, graphicsPipeline, nullptr);
+	vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+
+	if (renderpass != VK_NULL_HANDLE)
+		vkDestroyRenderPass(logicalDevice, renderpass, nullptr);
+
+	vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
+
+	deletionQueue.flush();
+
+	vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+	vkDestroyCommandPool(logicalDevice, computeCommandPool, nullptr);
+	vkDestroyCommandPool(logicalDevice, transferCommandPool, nullptr);
+
+	// the image views are only made with the frame resources
+	vkDestroySwapchainKHR(logicalDevice, swapchain, nullptr);
+	vkDestroySurfaceKHR(instance, surface, nullptr);
+
+	vkDestroyDevice(logicalDevice, nullptr);
+
+	vkDestroyInstance(instance, nullptr);
+
+	jobs.shutdown();
+}
+
+/**
+ * sums count integers with the reduction kernel on the compute queue and
+ * with a plain loop on the CPU, checks they agree and reports both times
+ */
+void benchmarkReduction(uint32_t count) {
+
+	const uint32_t REDUCE_GROUP_ELEMENTS = 1024;	// 256 invocations x 4 elements each, as in reduce.comp
+	const uint32_t MAX_REDUCE_PASSES = 8;
+
+	// the sum may wrap, but it wraps identically on both sides
+	std::vector<uint32_t> values(count);
+	for (uint32_t i = 0; i < count; i++)
+		values[i] = (i * 2654435761u) >> 24;
+
+	auto cpuStart = std::chrono::steady_clock::now();
+	uint32_t cpuSum = std::accumulate(values.begin(), values.end(), 0u);
+	double cpuTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - cpuStart).count();
+
+	ComputePipeline reducePipeline = createComputePipeline("spirv/reduce.comp", 2, 0, sizeof(uint32_t), MAX_REDUCE_PASSES);
+
+	VkDeviceSize inputBytes = static_cast<VkDeviceSize>(count) * sizeof(uint32_t);
+	VkDeviceSize partialBytes = static_cast<VkDeviceSize>(getGroupCount(count, REDUCE_GROUP_ELEMENTS)) * sizeof(uint32_t);
+
+	VkBuffer inputBuffer, readbackBuffer;
+	VkDeviceMemory inputBufferMemory, readbackBufferMemory;
+	std::array<VkBuffer, 2> partialBuffers;
+	std::array<VkDeviceMemory, 2> partialBufferMemory;
+
+	createBuffer(inputBuffer, inputBufferMemory, inputBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_TRANSIENT);
+
+	for (uint32_t i = 0; i < partialBuffers.size(); i++)
+		createBuffer(partialBuffers[i], partialBufferMemory[i], partialBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_TRANSIENT);
+
+	createBuffer(readbackBuffer, readbackBufferMemory, sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING);
+
+	UploadBatch batch = beginUploads();
+	stageBufferUpload(batch, values.data(), inputBytes, inputBuffer, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	finishUploads(batch, computeQueue, computeFamilyIndex, computeCommandPool);
+
+	// time the passes on the GPU if the compute queue can write timestamps
+	const std::vector<VkQueueFamilyProperties> &queueFamilies = deviceCapabilities.queueFamilies;
+	const VkPhysicalDeviceProperties &properties = deviceCapabilities.properties;
+
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+
+	if (queueFamilies[computeFamilyIndex].timestampValidBits > 0) {
+
+		VkQueryPoolCreateInfo queryPoolCI = {};
+		queryPoolCI.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCI.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCI.queryCount = 2;
+
+		vkCreateQueryPool(logicalDevice, &queryPoolCI, nullptr, &queryPool);
+	}
+
+	VkCommandBuffer commandBuffer = beginCommandRecording(computeCommandPool);
+
+	if (queryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+	}
+
+	// ping-pong between the partial sum buffers until one value is left
+	VkBuffer src = inputBuffer;
+	uint32_t remaining = count;
+	uint32_t passes = 0;
+
+	do {
+		VkBuffer dst = partialBuffers[passes % 2];
+		uint32_t groupCount = getGroupCount(remaining, REDUCE_GROUP_ELEMENTS);
+
+		VkDescriptorSet descriptorSet = allocateComputeDescriptorSet(reducePipeline);
+		writeStorageBufferDescriptor(descriptorSet, 0, src);
+		writeStorageBufferDescriptor(descriptorSet, 1, dst);
+
+		dispatchCompute(commandBuffer, reducePipeline, descriptorSet, groupCount, 1, 1, &remaining);
+		recordComputeBarrier(commandBuffer);
+
+		src = dst;
+		remaining = groupCount;
+		passes++;
+	} while (remaining > 1 && passes < MAX_REDUCE_PASSES);
+
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr
+		);
+
+	VkBufferCopy region = {};
+	region.size = sizeof(uint32_t);
+
+	vkCmdCopyBuffer(commandBuffer, src, readbackBuffer, 1, &region);
+
+	if (queryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+
+	endCommandRecording(commandBuffer);
 
-	VkRenderPassCreateInfo renderpassCI = {};
-	renderpassCI.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderpassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
-	renderpassCI.pAttachments    = attachments.data();
-	renderpassCI.subpassCount    = 1;
-	renderpassCI.pSubpasses      = &subpassDescription;
-	renderpassCI.dependencyCount = 1;
-	renderpassCI.pDependencies   = &subpassDependency;
+	auto gpuStart = std::chrono::steady_clock::now();
+	submitCommandBuffer(computeCommandPool, commandBuffer, computeQueue);
+	double gpuTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - gpuStart).count();
 
-	VkRenderPass renderpass;
+	if (queryPool != VK_NULL_HANDLE) {
 
-	if (vkCreateRenderPass(logicalDevice, &renderpassCI, nullptr, &renderpass) != VK_SUCCESS) {
-		fputs("Unable to create render pass\n", stderr);
+		uint64_t timestamps[2];
+
+		if (vkGetQueryPoolResults(logicalDevice, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+			gpuTime = (timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod * 1e-9;
+
+		vkDestroyQueryPool(logicalDevice, queryPool, nullptr);
+	}
+
+	uint32_t gpuSum;
+	void *mapped;
+	vkMapMemory(logicalDevice, readbackBufferMemory, 0, sizeof(uint32_t), 0, &mapped);
+	memcpy(&gpuSum, mapped, sizeof(uint32_t));
+	vkUnmapMemory(logicalDevice, readbackBufferMemory);
+
+	fprintf(stdout, "reduce %u values: CPU %.3f ms (%.1f GB/s), GPU %.3f ms (%.1f GB/s) in %u passes\n",
+			count,
+			cpuTime * 1e3, inputBytes / cpuTime * 1e-9,
+			gpuTime * 1e3, inputBytes / gpuTime * 1e-9,
+			passes);
+
+	vkDestroyBuffer(logicalDevice, inputBuffer, nullptr);
+	freeMemory(inputBufferMemory);
+	vkDestroyBuffer(logicalDevice, readbackBuffer, nullptr);
+	freeMemory(readbackBufferMemory);
+
+	for (uint32_t i = 0; i < partialBuffers.size(); i++) {
+		vkDestroyBuffer(logicalDevice, partialBuffers[i], nullptr);
+		freeMemory(partialBufferMemory[i]);
+	}
+
+	destroyComputePipeline(reducePipeline);
+
+	if (gpuSum != cpuSum) {
+		fprintf(stderr, "GPU sum %u does not match CPU sum %u\n", gpuSum, cpuSum);
 		exit(EXIT_FAILURE);
 	}
 
-	return renderpass;
 }
 
-std::vector<VkFramebuffer> createFramebuffers() {
+/*
+ * The baseline for --bench-jobs: one queue behind one lock, shared by every
+ * thread, with a wake-up per job.
+ */
+class MutexJobPool {
+public:
+	void init(uint32_t workerCount) {
+		running = true;
 
-	std::vector<VkFramebuffer> swapchainFramebuffers(swapchainImageViews.size());
+		for (uint32_t i = 0; i < workerCount; i++)
+			workers.emplace_back([this] { work(); });
+	}
 
-	for (uint32_t i = 0; i < swapchainFramebuffers.size(); i++) {
+	void shutdown() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
 
-		std::array<VkImageView, 2> framebufferAttachments = {
-			swapchainImageViews[i], depthBufferView
-		};
+		jobQueued.notify_all();
 
-		VkFramebufferCreateInfo framebufferCI = {};
-		framebufferCI.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferCI.renderPass      = renderpass;
-		framebufferCI.attachmentCount = static_cast<uint32_t>(framebufferAttachments.size());
-		framebufferCI.pAttachments    = framebufferAttachments.data();
-		framebufferCI.width           = swapchainExtent.width;
-		framebufferCI.height          = swapchainExtent.height;
-		framebufferCI.layers          = 1;
+		for (std::thread &worker : workers)
+			worker.join();
 
-		VkFramebuffer framebuffer;
+		workers.clear();
+	}
 
-		if (vkCreateFramebuffer(logicalDevice, &framebufferCI, nullptr, &framebuffer) != VK_SUCCESS) {
-			fputs("Unable to create framebuffer\n", stderr);
-			exit(EXIT_FAILURE);
+	void schedule(const Job &job) {
+		job.counter->pending.fetch_add(1);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(job);
 		}
 
+		jobQueued.notify_one();
 	}
 
-	return swapchainFramebuffers;
-}
+	void wait(JobCounter &counter) {
+		while (counter.pending > 0) {
+			std::unique_lock<std::mutex> lock(mutex);
 
-VkShaderModule createShaderModule(const std::string filename) {
+			if (queue.empty()) {
+				lock.unlock();
+				std::this_thread::yield();
+				continue;
+			}
 
-	std::ifstream file(filename);
+			Job job = queue.front();
+			queue.pop_front();
+			lock.unlock();
 
-	if (!file.is_open()) {
-		fprintf(stderr, "Could not open file %s\n", filename.c_str());
-		return nullptr;
+			job.function(job.data, job.begin, job.end);
+			job.counter->pending.fetch_sub(1);
+		}
 	}
 
-	file.seekg(0, std::ios::end);
-	size_t length = file.tellg();
+private:
+	void work() {
+		std::unique_lock<std::mutex> lock(mutex);
 
-	file.seekg(0);
+		while (true) {
+			jobQueued.wait(lock, [this] { return !queue.empty() || !running; });
 
-	std::string source(length, '\0');
-	file.read(source.data(), length);
+			if (queue.empty())
+				return;
 
-	VkShaderModuleCreateInfo shaderModuleCI = {};
-	shaderModuleCI.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shaderModuleCI.codeSize = source.length();
-	shaderModuleCI.pCode    = reinterpret_cast<const uint32_t *>(source.data());
+			Job job = queue.front();
+			queue.pop_front();
+			lock.unlock();
 
-	VkShaderModule shaderModule;
+			job.function(job.data, job.begin, job.end);
+			job.counter->pending.fetch_sub(1);
 
-	if (vkCreateShaderModule(logicalDevice, &shaderModuleCI, nullptr, &shaderModule) != VK_SUCCESS) {
-		fprintf(stderr, "Could not create shader module for %s\n", filename.c_str());
-		exit(EXIT_FAILURE);
+			lock.lock();
+		}
 	}
 
-	file.close();
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobQueued;
+	std::deque<Job> queue;
+	bool running = false;
+};
 
-	return shaderModule;
-}
+/**
+ * a few dozen multiply-adds per item, about the size of one culling test or
+ * transform update
+ */
+void benchmarkJob(void *data, uint32_t begin, uint32_t end) {
 
-// TODO : overloads for different e.g. geometry, etc. shaders?
-VkPipeline createGraphicsPipeline(const std::string vertexShaderPath, const std::string fragmentShaderPath) {
+	uint64_t *results = static_cast<uint64_t *>(data);
 
-	VkShaderModule vertexShaderModule = createShaderModule(vertexShaderPath);
-	VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderPath);
+	for (uint32_t i = begin; i < end; i++) {
 
-	VkPipelineShaderStageCreateInfo vertShaderStageCI = {};
-	vertShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageCI.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageCI.module = vertexShaderModule;
-	vertShaderStageCI.pName = "main";
+		uint64_t x = i;
 
-	VkPipelineShaderStageCreateInfo fragShaderStageCI = {};
-	fragShaderStageCI.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageCI.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageCI.module = fragmentShaderModule;
-	fragShaderStageCI.pName = "main";
+		for (uint32_t k = 0; k < 32; k++)
+			x = x * 6364136223846793005ull + 1442695040888963407ull;
 
-	VkPipelineShaderStageCreateInfo shaderStages[] = {
-		vertShaderStageCI, fragShaderStageCI
-	};
+		results[i] = x;
+	}
 
-	VkVertexInputBindingDescription vertexInputBindingDescription = Vertex::getInputBindingDescription();
-	std::array<VkVertexInputAttributeDescription, Vertex::attributeCount> vertexInputAttributeDescriptions = Vertex::getAttributeDescriptions();
-	
-	VkPipelineVertexInputStateCreateInfo vertexInputStateCI = {};
-	vertexInputStateCI.sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputStateCI.vertexBindingDescriptionCount   = 1;
-	vertexInputStateCI.pVertexBindingDescriptions      = &vertexInputBindingDescription;
-	vertexInputStateCI.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributeDescriptions.size());
-	vertexInputStateCI.pVertexAttributeDescriptions    = vertexInputAttributeDescriptions.data();
+}
 
-	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = {};
-	inputAssemblyStateCI.sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssemblyStateCI.topology               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssemblyStateCI.primitiveRestartEnable = VK_FALSE;
+/**
+ * runs count one-item jobs through pool, forked and joined in rounds of
+ * jobsPerRound as a frame's fine-grained work would be, and returns the time
+ */
+template<typename Pool>
+double timeJobs(Pool &pool, uint32_t count, uint32_t jobsPerRound, std::vector<uint64_t> &results) {
 
-	VkViewport viewport = {};
-	viewport.x        = 0.0f;
-	viewport.y        = 0.0f;
-	viewport.width    = swapchainExtent.width;
-	viewport.height   = swapchainExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
+	auto start = std::chrono::steady_clock::now();
 
-	VkRect2D scissor = {};
-	scissor.offset = {0, 0};
-	scissor.extent = swapchainExtent;
+	for (uint32_t round = 0; round < count; round += jobsPerRound) {
 
-	VkPipelineViewportStateCreateInfo viewportStateCI = {};
-	viewportStateCI.sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportStateCI.viewportCount = 1;
-	viewportStateCI.pViewports    = &viewport;
-	viewportStateCI.scissorCount  = 1;
-	viewportStateCI.pScissors     = &scissor;
+		JobCounter counter;
+		uint32_t roundEnd = std::min(count, round + jobsPerRound);
 
-	VkPipelineRasterizationStateCreateInfo rasterizationStateCI = {};
-	rasterizationStateCI.sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizationStateCI.depthClampEnable        = VK_FALSE;
-	rasterizationStateCI.rasterizerDiscardEnable = VK_TRUE;
-	rasterizationStateCI.polygonMode             = VK_POLYGON_MODE_FILL;
-	rasterizationStateCI.cullMode                = VK_CULL_MODE_BACK_BIT;
-	rasterizationStateCI.frontFace               = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizationStateCI.depthBiasEnable         = VK_FALSE;
-	rasterizationStateCI.lineWidth               = 1.0f;
+		for (uint32_t i = round; i < roundEnd; i++)
+			pool.schedule({ benchmarkJob, results.data(), i, i + 1, &counter });
 
-	// TODO : detect multisampling support and implement
-	VkPipelineMultisampleStateCreateInfo multisampleStateCI = {};
-	multisampleStateCI.sType                = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampleStateCI.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	multisampleStateCI.sampleShadingEnable  = VK_FALSE;
-	multisampleStateCI.minSampleShading     = 1.0f;
+		pool.wait(counter);
+	}
 
-	VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = {};
-	depthStencilStateCI.sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencilStateCI.depthTestEnable       = VK_TRUE;
-	depthStencilStateCI.depthWriteEnable      = VK_TRUE;
-	depthStencilStateCI.depthCompareOp        = VK_COMPARE_OP_LESS;
-	depthStencilStateCI.depthBoundsTestEnable = VK_FALSE;
-	depthStencilStateCI.stencilTestEnable     = VK_FALSE;
-	depthStencilStateCI.minDepthBounds        = 0.0f;
-	depthStencilStateCI.maxDepthBounds        = 1.0f;
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
 
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
+void benchmarkJobs(uint32_t count) {
 
-	VkPipelineColorBlendStateCreateInfo colorBlendStateCI = {};
-	colorBlendStateCI.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlendStateCI.logicOpEnable = VK_FALSE;
-	colorBlendStateCI.logicOp = VK_LOGIC_OP_COPY;
-	colorBlendStateCI.attachmentCount = 1;
-	colorBlendStateCI.pAttachments = &colorBlendAttachment;
-	colorBlendStateCI.blendConstants[0] = 0.0f;
-	colorBlendStateCI.blendConstants[1] = 0.0f;
-	colorBlendStateCI.blendConstants[2] = 0.0f;
-	colorBlendStateCI.blendConstants[3] = 0.0f;
+	const uint32_t JOBS_PER_ROUND = 1024;
 
-	VkPipelineLayoutCreateInfo pipelineLayoutCI = {};
-	pipelineLayoutCI.sType          = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutCI.setLayoutCount = 1;
-	pipelineLayoutCI.pSetLayouts    = &descriptorSetLayout;
+	std::vector<uint64_t> expected(count);
+	benchmarkJob(expected.data(), 0, count);
 
-	if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout) != VK_SUCCESS) {
-		fputs("Could not create pipeline layout\n", stderr);
+	uint32_t workerCount = jobs.getThreadCount() - 1;
+
+	std::vector<uint64_t> results(count);
+	double stealingTime = timeJobs(jobs, count, JOBS_PER_ROUND, results);
+
+	if (results != expected) {
+		fputs("Job system results do not match\n", stderr);
 		exit(EXIT_FAILURE);
 	}
 
-	VkGraphicsPipelineCreateInfo graphicsPipelineCI = {};
-	graphicsPipelineCI.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	graphicsPipelineCI.stageCount          = 2;
-	graphicsPipelineCI.pStages             = shaderStages;
-	graphicsPipelineCI.pVertexInputState   = &vertexInputStateCI;
-	graphicsPipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
-	graphicsPipelineCI.pViewportState      = &viewportStateCI;
-	graphicsPipelineCI.pRasterizationState = &rasterizationStateCI;
-	graphicsPipelineCI.pMultisampleState   = &multisampleStateCI;
-	graphicsPipelineCI.pDepthStencilState  = &depthStencilStateCI;
-	graphicsPipelineCI.pColorBlendState    = &colorBlendStateCI;
-	graphicsPipelineCI.layout              = pipelineLayout;
-	graphicsPipelineCI.renderPass          = renderpass;
+	MutexJobPool mutexPool;
+	mutexPool.init(workerCount);
 
-	VkPipeline graphicsPipeline;
+	std::fill(results.begin(), results.end(), 0);
+	double mutexTime = timeJobs(mutexPool, count, JOBS_PER_ROUND, results);
 
-	if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCI, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-		fputs("Could not create graphics pipeline\n", stderr);
+	mutexPool.shutdown();
+
+	if (results != expected) {
+		fputs("Mutex pool results do not match\n", stderr);
 		exit(EXIT_FAILURE);
 	}
 
-	return graphicsPipeline;
+	printf("%u jobs in rounds of %u on %u threads%s\n", count, JOBS_PER_ROUND, workerCount + 1, pinWorkers ? ", workers pinned" : "");
+	printf("work stealing: %.2fms, %.1f M jobs/s\n", stealingTime * 1e3, count / stealingTime * 1e-6);
+	printf("mutex queue:   %.2fms, %.1f M jobs/s\n", mutexTime * 1e3, count / mutexTime * 1e-6);
 }
 
-void loop() {
-#if defined(USE_NULLWS)
-	while (1)
-		;
-#else
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
+/**
+ * runs at exit, so a run that ends in a fatal error still leaves its trace
+ */
+void writeTrace() {
+
+	if (!profilerWriteChromeTrace(tracePath))
+		fprintf(stderr, "Could not write trace to %s\n", tracePath);
 
-	}
-#endif
 }
 
-void cleanup() {
+void parseArguments(int argc, char *argv[]) {
+
+	for (int i = 1; i < argc; i++) {
+
+		if (strcmp(argv[i], "--gpu") == 0 && i + 1 < argc) {
+			gpuOverride = argv[++i];
+		} else if (strcmp(argv[i], "--present") == 0 && i + 1 < argc) {
+			presentOverride = argv[++i];
+		} else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+			particleCount = strtoul(argv[++i], nullptr, 0);
+		} else if (strcmp(argv[i], "--characters") == 0 && i + 1 < argc) {
+			characterCount = strtoul(argv[++i], nullptr, 0);
+		} else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+			lightCount = strtoul(argv[++i], nullptr, 0);
+		} else if (strcmp(argv[i], "--depth-prepass") == 0) {
+			depthPrepass = true;
+		} else if (strcmp(argv[i], "--occlusion-cull") == 0) {
+			occlusionCulling = true;
+		} else if (strcmp(argv[i], "--dynamic-rendering") == 0) {
+			dynamicRenderingRequested = true;
+		} else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc) {
+			dynamicResolutionTarget = strtof(argv[++i], nullptr);
+		} else if (strcmp(argv[i], "--variable-rate-shading") == 0) {
+			variableRateShading = true;
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			tracePath = argv[++i];
+		} else if (strcmp(argv[i], "--memory-report") == 0 && i + 1 < argc) {
+			memoryReportInterval = strtoul(argv[++i], nullptr, 0);
+		} else if (strcmp(argv[i], "--memory-json") == 0 && i + 1 < argc) {
+			memoryJsonPath = argv[++i];
+		} else if (strcmp(argv[i], "--startup-report") == 0) {
+			startupReport = true;
+		} else if (strcmp(argv[i], "--pin-workers") == 0) {
+			pinWorkers = true;
+		} else if (strcmp(argv[i], "--bench-jobs") == 0 && i + 1 < argc) {
+			benchJobsCount = strtoul(argv[++i], nullptr, 0);
+		} else if (strcmp(argv[i], "--bench-allocations") == 0 && i + 1 < argc) {
+			benchAllocationFrames = strtoul(argv[++i], nullptr, 0);
+		} else if (strcmp(argv[i], "--bench-reduce") == 0 && i + 1 < argc) {
+			benchReduceCount = strtoul(argv[++i], nullptr, 0);
+		} else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+			capturePath = argv[++i];
+		} else if (argv[i][0] != '-' && !assetPath) {
+			assetPath = argv[i];
+		} else {
+			fprintf(stderr, "usage: %s [--gpu index|uuid|name] [--present low-latency|throughput] [--particles count] [--characters count] [--lights count] [--depth-prepass] [--occlusion-cull] [--dynamic-rendering] [--dynamic-resolution ms] [--variable-rate-shading] [--trace file.json] [--memory-report seconds] [--memory-json file.json] [--startup-report] [--pin-workers] [--bench-jobs count] [--bench-allocations frames] [--bench-reduce count] [--capture file.ppm] [asset.spk]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
 
-	vkDeviceWaitIdle(logicalDevice);
+	const char *present = presentOverride ? presentOverride : getenv("SPOCK_PRESENT");
 
-	vkDestroyBuffer(logicalDevice, vertexBuffer, nullptr);
+	if (present && !parseLatencyMode(present, latencyMode)) {
+		fprintf(stderr, "Unknown present mode %s, expected low-latency or throughput\n", present);
+		exit(EXIT_FAILURE);
+	}
 
-	// vkDestroyShaderModule(logicalDevice, 
+	// the captured frame is the last one the allocation count draws
+	if (capturePath && benchAllocationFrames == 0) {
+		fputs("--capture needs --bench-allocations, which decides the frame captured\n", stderr);
+		exit(EXIT_FAILURE);
+	}
 
-	for (VkImageView imageView : swapchainImageViews) {
-		vkDestroyImageView(logicalDevice, imageView, nullptr);
+	// the occlusion pyramid is built from the whole depth buffer
+	if (dynamicResolutionTarget > 0.0f && occlusionCulling) {
+		fputs("Dynamic resolution does not work with occlusion culling, rendering at full resolution\n", stderr);
+		dynamicResolutionTarget = 0.0f;
 	}
 
-	vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
+}
 
-	vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+int main(int argc, char *argv[]) {
 
-	vkDestroySwapchainKHR(logicalDevice, swapchain, nullptr);
+	parseArguments(argc, argv);
 
-	vkDestroySurfaceKHR(instance, surface, nullptr);
+	PROFILE_THREAD("main");
 
-	vkDestroyDevice(logicalDevice, nullptr);
+	if (tracePath) {
+#if defined(PROFILE)
+		atexit(writeTrace);
+#else
+		fputs("Built without PROFILE=1, --trace records nothing\n", stderr);
+#endif
+	}
 
-	vkDestroyInstance(instance, nullptr);
+	startupTime = std::chrono::steady_clock::now();
 
-}
+	jobs.init(std::max(std::thread::hardware_concurrency(), 2u) - 1, pinWorkers);
 
-int main(int argc, char *argv[]) {
+	if (benchJobsCount > 0) {
+		benchmarkJobs(benchJobsCount);
+		jobs.shutdown();
+		return EXIT_SUCCESS;
+	}
 
+	// names the shaders to load, so it is read before they are
+	if (!shaderManifest.load("spirv/manifest.txt")) {
+		fputs("Could not read spirv/manifest.txt, which the shader build writes\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	// each step waits only for the steps it lists; the queues, command pools
+	// and staging ring are not thread-safe, so everything that records or
+	// submits stays in one chain
+	TaskGraph startup;
+
+	TaskId windowTask = startup.add("create window", [] {
 #if !defined(USE_NULLWS)
-	window = createWindow(640, 480, "spock");
+			window = createWindow(640, 480, "spock");
 #endif
+		}, {}, TASK_MAIN_THREAD);
 
-	std::vector<const char *> instanceLayers = initLayers();
-	std::vector<const char *> instanceExtensions = initInstanceExtensions();
+	TaskId shaderTask = startup.add("load SPIR-V", loadSpirvBinaries);
 
-	instance = createInstance("spock", instanceLayers, instanceExtensions);
-	// printEnabledInstanceExtensions();
+	// exiting from a worker would tear down the globals under the other
+	// tasks, so a failed decode is reported once the graph has finished
+	bool sceneDecoded = true;
 
-	std::vector<const char *> deviceExtensions = initDeviceExtensions();
+	TaskId decodeTask = startup.add("decode scene", [&sceneDecoded] {
+			if (benchReduceCount > 0)
+				return;
 
-	std::vector<VkPhysicalDevice> physicalDevices = queryPhysicalDevices();
-	physicalDevice = selectPhysicalDevice(physicalDevices);
+			if (assetPath) {
+				// cooked asset: geometry and LODs are already packed
+				sceneDecoded = decodeAsset(assetPath);
+			} else {
+				// import scene geometry, generating LOD chains into the shared buffers
+				meshes.push_back(importMesh(vertices, indices, sceneVertices, sceneIndices));
+			}
 
-	surface = createSurface();
+			meshLods.resize(meshes.size(), 0);
+		});
 
-	logicalDevice = createLogicalDevice(deviceExtensions);
+	std::vector<const char *> deviceExtensions;
 
-	swapchain = createSwapchain();
-	swapchainImageViews = createSwapchainImageViews();
+	// the instance extensions GLFW needs are only known once it is initialised
+	TaskId instanceTask = startup.add("create instance", [&deviceExtensions] {
+			std::vector<const char *> instanceLayers = initLayers();
+			std::vector<const char *> instanceExtensions = initInstanceExtensions();
 
-	renderpass = createRenderPass();
+			if (dynamicRenderingRequested && getLoaderApiVersion() >= VK_API_VERSION_1_3)
+				instanceApiVersion = VK_API_VERSION_1_3;
 
-	descriptorSetLayout = createDescriptorSetLayout();
+			instance = createInstance("spock", instanceLayers, instanceExtensions);
+			// printEnabledInstanceExtensions();
 
-	graphicsPipeline = createGraphicsPipeline("spirv/test.vert", "spirv/test.frag");
+			deviceExtensions = initDeviceExtensions();
 
-	swapchainFramebuffers = createFramebuffers();
+			std::vector<VkPhysicalDevice> physicalDevices = queryPhysicalDevices();
+			physicalDevice = selectPhysicalDevice(physicalDevices, deviceExtensions);
 
-	commandPool = createCommandPool(graphicsFamilyIndex);
+			if (dynamicRenderingRequested) {
+				dynamicRenderingEnabled = vulkan13PathSupported(deviceCapabilities);
 
-	vertexBuffer = createVertexBuffer();
-	depthBuffer = createDepthBuffer();
+				if (!dynamicRenderingEnabled)
+					fputs("Dynamic rendering or synchronization2 not supported, falling back to render passes\n", stderr);
+			}
 
-	commandBuffers = createCommandBuffers(commandPool);
+			// optional, renders all shadow cascades in one pass
+			if (physicalDeviceProperties2Supported && deviceExtensionsSupported(deviceCapabilities, { VK_KHR_MULTIVIEW_EXTENSION_NAME })) {
+				deviceExtensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
+				multiviewSupported = true;
+			}
+
+			// optional, coarser shading where it goes unnoticed
+			if (variableRateShading)
+				enableVariableRateShading(deviceExtensions);
+
+			// optional, the driver's own view of per-heap usage and budget
+			if (physicalDeviceProperties2Supported && deviceExtensionsSupported(deviceCapabilities, { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME })) {
+				getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+						vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+
+				if (getMemoryProperties2) {
+					deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+					memoryBudgetSupported = true;
+				}
+			}
+
+			memoryBudget.init(deviceCapabilities.memoryProperties);
+
+			// nothing streams in yet, so there is nothing to evict; say so before
+			// the driver starts paging or the device is lost
+			memoryBudget.addPressureCallback([](const MemoryHeapStatus &status) {
+					fprintf(stderr, "Memory heap %u is at %.0f%% of its budget\n", status.heapIndex, 100.0 * status.usage / status.budget);
+					memoryBudget.writeReport(stderr);
+				});
+		}, { windowTask });
+
+	TaskId surfaceTask = startup.add("create surface", [] {
+			surface = createSurface();
+		}, { windowTask, instanceTask });
+
+	TaskId deviceTask = startup.add("create device", [&deviceExtensions] {
+			logicalDevice = createLogicalDevice(deviceExtensions);
+		}, { surfaceTask });
+
+	// sizes itself from the window's framebuffer, which GLFW only reports on the main thread
+	TaskId swapchainTask = startup.add("create swapchain", [] {
+			if (dynamicResolutionTarget > 0.0f) {
+				resolution.enabled = true;
+				resolution.controller.init(dynamicResolutionTarget * 1e-3);
+			} else if (shadingRate.attachmentRate || (variableRateShading && !shadingRate.enabled && !occlusionCulling)) {
+				// the rates are picked from the scene target; without the
+				// extension the whole scene is shaded at reduced resolution
+				resolution.enabled = true;
+				resolution.controller.initFixed(shadingRate.enabled ? 1.0f : SHADING_RATE_FALLBACK_SCALE);
+			}
+
+			swapchain = createSwapchain();
+
+			if (shadingRate.attachmentRate && !resolution.enabled)
+				shadingRate.attachmentRate = false;
+		}, { deviceTask }, TASK_MAIN_THREAD);
+
+	TaskId renderPassTask = startup.add("create render pass", [] {
+			if (!dynamicRenderingEnabled)
+				renderpass = createRenderPass();
+		}, { swapchainTask });
+
+	TaskId descriptorLayoutTask = startup.add("create descriptor set layout", [] {
+			descriptorSetLayout = createDescriptorSetLayout();
+		}, { deviceTask });
+
+	TaskId pipelineTask = startup.add("create main pipeline", [] {
+			graphicsPipeline = createGraphicsPipeline(shadingRate.primitiveRate ? "spirv/test_rate.vert" : "spirv/test.vert", "spirv/test.frag");
+
+			if (depthPrepass)
+				depthPrepassPipeline = createDepthPrepassPipeline();
+		}, { renderPassTask, descriptorLayoutTask, shaderTask });
+
+	TaskId commandPoolTask = startup.add("create command pools", [] {
+			commandPool = createCommandPool(graphicsFamilyIndex);
+			computeCommandPool = createCommandPool(computeFamilyIndex);
+			transferCommandPool = createCommandPool(transferFamilyIndex);
+
+			createStagingRing();
+		}, { deviceTask });
+
+	if (benchReduceCount > 0) {
+		startup.add("benchmark reduction", [] {
+				benchmarkReduction(benchReduceCount);
+			}, { commandPoolTask, shaderTask });
+
+		startup.run(jobs);
+		cleanupBenchmark();
+		return EXIT_SUCCESS;
+	}
+
+	TaskId uploadTask = startup.add("upload scene", [&sceneDecoded] {
+			if (!sceneDecoded)
+				return;
+
+			if (assetPath)
+				uploadAsset();
+			else
+				uploadSceneGeometry();
+		}, { commandPoolTask, decodeTask });
+
+	// the scene systems build pipelines against the main pass, and record and
+	// submit their initial uploads after the scene's
+	startup.add("create scene systems", [&sceneDecoded] {
+			if (!sceneDecoded)
+				return;
+
+			if (particleCount > 0)
+				createParticleSystem(particleCount);
+
+			if (characterCount > 0)
+				createSkinnedCharacters(characterCount);
+
+			createUniformBuffer();
+			createLightGrid(lightCount);
+			createShadowResources();
+
+			if (occlusionCulling)
+				createOcclusionCuller();
+
+			if (resolution.enabled)
+				createUpscaler();
+
+			if (shadingRate.attachmentRate)
+				createShadingRatePass();
+		}, { uploadTask, renderPassTask, descriptorLayoutTask, shaderTask });
+
+	startup.run(jobs);
+
+	// decodeAsset has said why
+	if (!sceneDecoded)
+		exit(EXIT_FAILURE);
+
+	frames = createFrameSync(presentPolicy.framesInFlight);
+
+	createSwapchainResources();
+
+	if (capturePath)
+		createFrameCapture();
+
+	// the count takes a time for each frame it draws, one more than it counts
+	steadyFrameTimes.reserve(benchAllocationFrames + 1);
+
+	if (startupReport) {
+		startup.writeReport(stdout);
+		printf("startup took %.1fms\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupTime).count());
+	}
+
+	framePacer.init(latencyMode);
+
+#if !defined(USE_NULLWS)
+	const GLFWvidmode *videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+
+	if (videoMode && videoMode->refreshRate > 0)
+		framePacer.setRefreshInterval(1.0 / videoMode->refreshRate);
+#endif
+
+	lastFrameTime = std::chrono::steady_clock::now();
+	lastMemoryReport = lastFrameTime;
+
+	if (memoryReportInterval > 0 || memoryJsonPath)
+		reportMemory();
 
 	loop();
 
-	// TODO : clean up after we're done
+	if (capturePath) {
+		writeFrameCapture();
+		destroyFrameCapture();
+	}
+
+	cleanup();
+
+	if (steadyFrameAllocations > 0) {
+		fputs("Steady frames allocated from the heap\n", stderr);
+		return EXIT_FAILURE;
+	}
 
-	// printGPUInfo(physicalDevice);
 	// printSupportedInstanceLayers();
 	// printSupportedDeviceLayers(physicalDevice);
 	// printSupportedInstanceExtensions();
@@ -0,0 +1,185 @@
+#include <memorybudget.h>
+
+const char *memoryCategoryName(MemoryCategory category) {
+
+	switch (category) {
+	case MEMORY_CATEGORY_BUFFER:    return "buffers";
+	case MEMORY_CATEGORY_IMAGE:     return "images";
+	case MEMORY_CATEGORY_STAGING:   return "staging";
+	case MEMORY_CATEGORY_TRANSIENT: return "transient";
+	default:                        return "unknown";
+	}
+
+}
+
+static double toMiB(VkDeviceSize bytes) {
+	return bytes / (1024.0 * 1024.0);
+}
+
+void MemoryBudget::init(const VkPhysicalDeviceMemoryProperties &memoryProperties) {
+
+	typeHeaps.resize(memoryProperties.memoryTypeCount);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		typeHeaps[i] = memoryProperties.memoryTypes[i].heapIndex;
+
+	heaps.assign(memoryProperties.memoryHeapCount, Heap());
+
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		heaps[i].size        = memoryProperties.memoryHeaps[i].size;
+		heaps[i].deviceLocal = memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+	}
+
+	allocations.clear();
+}
+
+void MemoryBudget::allocated(VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize allocatedBytes, VkDeviceSize usedBytes, MemoryCategory category) {
+
+	uint32_t heapIndex = typeHeaps[memoryTypeIndex];
+
+	allocations[memory] = { heapIndex, category, allocatedBytes, usedBytes };
+
+	Heap &heap = heaps[heapIndex];
+	heap.allocatedBytes[category] += allocatedBytes;
+	heap.usedBytes[category] += usedBytes;
+	heap.allocationCount++;
+
+	// the driver's figures only catch up at the next budget query
+	if (heap.driverBudget > 0)
+		heap.driverUsage += allocatedBytes;
+
+	checkPressure(heapIndex);
+}
+
+void MemoryBudget::freed(VkDeviceMemory memory) {
+
+	auto it = allocations.find(memory);
+
+	if (it == allocations.end())
+		return;
+
+	const Allocation &allocation = it->second;
+
+	Heap &heap = heaps[allocation.heapIndex];
+	heap.allocatedBytes[allocation.category] -= allocation.allocatedBytes;
+	heap.usedBytes[allocation.category] -= allocation.usedBytes;
+	heap.allocationCount--;
+
+	if (heap.driverUsage >= allocation.allocatedBytes)
+		heap.driverUsage -= allocation.allocatedBytes;
+
+	uint32_t heapIndex = allocation.heapIndex;
+	allocations.erase(it);
+
+	checkPressure(heapIndex);
+}
+
+void MemoryBudget::setDriverBudget(const VkDeviceSize *heapBudget, const VkDeviceSize *heapUsage) {
+
+	for (uint32_t i = 0; i < heaps.size(); i++) {
+		heaps[i].driverBudget = heapBudget[i];
+		heaps[i].driverUsage  = heapUsage[i];
+		checkPressure(i);
+	}
+
+}
+
+void MemoryBudget::addPressureCallback(PressureCallback callback) {
+	pressureCallbacks.push_back(callback);
+}
+
+MemoryHeapStatus MemoryBudget::getHeapStatus(uint32_t heapIndex) const {
+
+	const Heap &heap = heaps[heapIndex];
+
+	MemoryHeapStatus status = {};
+	status.heapIndex = heapIndex;
+
+	if (heap.driverBudget > 0) {
+		status.usage  = heap.driverUsage;
+		status.budget = heap.driverBudget;
+	} else {
+		for (uint32_t c = 0; c < MEMORY_CATEGORY_COUNT; c++)
+			status.usage += heap.allocatedBytes[c];
+
+		status.budget = heap.size;
+	}
+
+	return status;
+}
+
+void MemoryBudget::checkPressure(uint32_t heapIndex) {
+
+	MemoryHeapStatus status = getHeapStatus(heapIndex);
+	bool underPressure = status.usage > status.budget * MEMORY_PRESSURE_THRESHOLD;
+
+	if (underPressure == heaps[heapIndex].underPressure)
+		return;
+
+	heaps[heapIndex].underPressure = underPressure;
+
+	if (underPressure) {
+		for (const PressureCallback &callback : pressureCallbacks)
+			callback(status);
+	}
+
+}
+
+void MemoryBudget::writeReport(FILE *file) const {
+
+	for (uint32_t i = 0; i < heaps.size(); i++) {
+
+		const Heap &heap = heaps[i];
+		MemoryHeapStatus status = getHeapStatus(i);
+
+		fprintf(file, "heap %u (%s, %.1f MiB): %u allocations, %.1f of %.1f MiB budget%s%s\n",
+				i, heap.deviceLocal ? "device local" : "host",
+				toMiB(heap.size), heap.allocationCount,
+				toMiB(status.usage), toMiB(status.budget),
+				heap.driverBudget > 0 ? "" : " (tracked, no budget extension)",
+				heap.underPressure ? ", UNDER PRESSURE" : "");
+
+		for (uint32_t c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+
+			if (heap.allocatedBytes[c] == 0)
+				continue;
+
+			fprintf(file, "  %-10s %9.2f MiB allocated %9.2f MiB used\n",
+					memoryCategoryName(static_cast<MemoryCategory>(c)),
+					toMiB(heap.allocatedBytes[c]), toMiB(heap.usedBytes[c]));
+		}
+	}
+
+}
+
+void MemoryBudget::writeJson(FILE *file) const {
+
+	fputs("{\"heaps\":[", file);
+
+	for (uint32_t i = 0; i < heaps.size(); i++) {
+
+		const Heap &heap = heaps[i];
+		MemoryHeapStatus status = getHeapStatus(i);
+
+		fprintf(file, "%s\n{\"index\":%u,\"deviceLocal\":%s,\"size\":%llu,\"usage\":%llu,\"budget\":%llu,\"driverBudget\":%s,\"underPressure\":%s,\"allocations\":%u,\"categories\":{",
+				i > 0 ? "," : "", i, heap.deviceLocal ? "true" : "false",
+				static_cast<unsigned long long>(heap.size),
+				static_cast<unsigned long long>(status.usage),
+				static_cast<unsigned long long>(status.budget),
+				heap.driverBudget > 0 ? "true" : "false",
+				heap.underPressure ? "true" : "false",
+				heap.allocationCount);
+
+		for (uint32_t c = 0; c < MEMORY_CATEGORY_COUNT; c++) {
+			fprintf(file, "%s\"%s\":{\"allocated\":%llu,\"used\":%llu}",
+					c > 0 ? "," : "",
+					memoryCategoryName(static_cast<MemoryCategory>(c)),
+					static_cast<unsigned long long>(heap.allocatedBytes[c]),
+					static_cast<unsigned long long>(heap.usedBytes[c]));
+		}
+
+		fputs("}}", file);
+	}
+
+	fputs("\n]}\n", file);
+}
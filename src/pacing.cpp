@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include <pacing.h>
+
+// weight of the newest sample in the smoothed frame times
+const double FRAME_TIME_SMOOTHING = 0.1;
+
+// start a little early, a late frame costs a whole refresh
+const double PACING_MARGIN = 0.1;
+
+bool parseLatencyMode(const char *name, LatencyMode &mode) {
+
+	if (strcmp(name, "low-latency") == 0) {
+		mode = LATENCY_MODE_LOW_LATENCY;
+		return true;
+	}
+
+	if (strcmp(name, "throughput") == 0) {
+		mode = LATENCY_MODE_THROUGHPUT;
+		return true;
+	}
+
+	return false;
+}
+
+const char *latencyModeName(LatencyMode mode) {
+	return mode == LATENCY_MODE_LOW_LATENCY ? "low-latency" : "throughput";
+}
+
+const char *presentModeName(VkPresentModeKHR presentMode) {
+
+	switch (presentMode) {
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:
+		return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR:
+		return "mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR:
+		return "fifo";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+		return "fifo relaxed";
+	default:
+		return "unknown";
+	}
+
+}
+
+static bool presentModeAvailable(const std::vector<VkPresentModeKHR> &availablePresentModes, VkPresentModeKHR presentMode) {
+	return std::find(availablePresentModes.begin(), availablePresentModes.end(), presentMode) != availablePresentModes.end();
+}
+
+PresentPolicy selectPresentPolicy(
+		LatencyMode mode,
+		const std::vector<VkPresentModeKHR> &availablePresentModes,
+		const VkSurfaceCapabilitiesKHR &surfaceCapabilities) {
+
+	PresentPolicy policy = {};
+
+	// FIFO is the only mode every implementation has to support
+	policy.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+	if (mode == LATENCY_MODE_LOW_LATENCY) {
+
+		// mailbox replaces queued frames so never tears or blocks, immediate
+		// tears but is the next best thing
+		if (presentModeAvailable(availablePresentModes, VK_PRESENT_MODE_MAILBOX_KHR))
+			policy.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+		else if (presentModeAvailable(availablePresentModes, VK_PRESENT_MODE_IMMEDIATE_KHR))
+			policy.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+
+		// mailbox needs one image on screen, one queued and one to render
+		// into; anything else is lowest latency double buffered
+		policy.imageCount = policy.presentMode == VK_PRESENT_MODE_MAILBOX_KHR ? 3 : 2;
+
+		// the pacer keeps the second frame from queueing up behind the first
+		policy.framesInFlight = 2;
+
+	} else {
+
+		// relaxed FIFO tears a late frame rather than holding it a whole refresh
+		if (presentModeAvailable(availablePresentModes, VK_PRESENT_MODE_FIFO_RELAXED_KHR))
+			policy.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+
+		policy.imageCount = 3;
+		policy.framesInFlight = 3;
+	}
+
+	policy.imageCount = std::max(policy.imageCount, surfaceCapabilities.minImageCount);
+
+	// a maximum of 0 means there is no limit
+	if (surfaceCapabilities.maxImageCount > 0)
+		policy.imageCount = std::min(policy.imageCount, surfaceCapabilities.maxImageCount);
+
+	policy.framesInFlight = std::min(policy.framesInFlight, policy.imageCount);
+
+	return policy;
+}
+
+void FramePacer::init(LatencyMode mode) {
+	this->mode = mode;
+
+	cpuFrameTime = gpuFrameTime = 0.0;
+	started = false;
+}
+
+void FramePacer::setRefreshInterval(double seconds) {
+	refreshInterval = seconds;
+}
+
+void FramePacer::waitForFrameStart() {
+
+	Clock::time_point now = Clock::now();
+
+	if (mode == LATENCY_MODE_LOW_LATENCY && started) {
+
+		auto toDuration = [](double seconds) {
+			return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+		};
+
+		// finish building the frame as the GPU finishes the previous one
+		Clock::time_point target = gpuIdle - toDuration(cpuFrameTime + PACING_MARGIN * gpuFrameTime);
+
+		// there is no point starting frames the display will never show
+		target = std::max(target, frameStart + toDuration(refreshInterval * (1.0 - PACING_MARGIN)));
+
+		if (target > now) {
+			std::this_thread::sleep_until(target);
+			now = Clock::now();
+		}
+	}
+
+	frameStart = now;
+}
+
+void FramePacer::frameSubmitted() {
+
+	Clock::time_point now = Clock::now();
+
+	double cpuTime = std::chrono::duration<double>(now - frameStart).count();
+	cpuFrameTime = started ? cpuFrameTime + FRAME_TIME_SMOOTHING * (cpuTime - cpuFrameTime) : cpuTime;
+
+	// the new frame runs once the GPU is done with whatever is queued
+	gpuIdle = std::max(now, gpuIdle) + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gpuFrameTime));
+
+	started = true;
+}
+
+void FramePacer::gpuFrameCompleted(double seconds) {
+
+	if (gpuFrameTime == 0.0)
+		gpuFrameTime = seconds;
+	else
+		gpuFrameTime += FRAME_TIME_SMOOTHING * (seconds - gpuFrameTime);
+
+}
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <profiler.h>
+
+// the GPU's track sorts after every CPU thread
+const uint32_t PROFILE_GPU_THREAD_ID = 1000;
+
+/* every ring ever registered; a ring outlives its thread so it can be exported */
+static std::mutex ringsMutex;
+static std::vector<std::unique_ptr<ProfileRing>> rings;
+
+static std::atomic<uint32_t> nextThreadId(1);
+static thread_local ProfileRing *threadRing = nullptr;
+static ProfileRing *gpuRing = nullptr;
+
+static ProfileRing *registerRing(uint32_t threadId, const char *threadName) {
+
+	std::unique_ptr<ProfileRing> ring(new ProfileRing());
+	ring->head.store(0, std::memory_order_relaxed);
+	ring->threadId = threadId;
+	snprintf(ring->threadName, sizeof(ring->threadName), "%s", threadName);
+
+	std::lock_guard<std::mutex> lock(ringsMutex);
+	rings.push_back(std::move(ring));
+
+	return rings.back().get();
+}
+
+static ProfileRing *getThreadRing() {
+
+	if (!threadRing) {
+
+		uint32_t threadId = nextThreadId.fetch_add(1, std::memory_order_relaxed);
+
+		char threadName[PROFILE_NAME_SIZE];
+		snprintf(threadName, sizeof(threadName), "thread %u", threadId);
+
+		threadRing = registerRing(threadId, threadName);
+	}
+
+	return threadRing;
+}
+
+static void pushEvent(ProfileRing *ring, const char *name, uint64_t start, uint64_t end) {
+
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	ring->events[head & (PROFILE_RING_SIZE - 1)] = { name, start, end };
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+uint64_t profilerNow() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profilerRecord(const char *name, uint64_t start, uint64_t end) {
+	pushEvent(getThreadRing(), name, start, end);
+}
+
+void profilerRecordGpu(const char *name, uint64_t start, uint64_t end) {
+
+	if (!gpuRing)
+		gpuRing = registerRing(PROFILE_GPU_THREAD_ID, "GPU");
+
+	pushEvent(gpuRing, name, start, end);
+}
+
+void profilerSetThreadName(const char *name) {
+	ProfileRing *ring = getThreadRing();
+	snprintf(ring->threadName, sizeof(ring->threadName), "%s", name);
+}
+
+static void writeJsonString(FILE *file, const char *string) {
+
+	fputc('"', file);
+
+	for (const char *c = string; *c; c++) {
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+
+		if (static_cast<unsigned char>(*c) >= 0x20)
+			fputc(*c, file);
+	}
+
+	fputc('"', file);
+}
+
+bool profilerWriteChromeTrace(const char *path) {
+
+	FILE *file = fopen(path, "w");
+
+	if (!file)
+		return false;
+
+	std::lock_guard<std::mutex> lock(ringsMutex);
+
+	// timestamps are written relative to the oldest zone kept
+	uint64_t origin = UINT64_MAX;
+
+	for (const std::unique_ptr<ProfileRing> &ring : rings) {
+
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+		uint64_t first = head > PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE : 0;
+
+		for (uint64_t e = first; e < head; e++)
+			origin = std::min(origin, ring->events[e & (PROFILE_RING_SIZE - 1)].start);
+	}
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+
+	bool firstEvent = true;
+
+	for (const std::unique_ptr<ProfileRing> &ring : rings) {
+
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", firstEvent ? "" : ",\n", ring->threadId);
+		writeJsonString(file, ring->threadName);
+		fputs("}}", file);
+		firstEvent = false;
+
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+		uint64_t first = head > PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE : 0;
+
+		for (uint64_t e = first; e < head; e++) {
+
+			const ProfileEvent &event = ring->events[e & (PROFILE_RING_SIZE - 1)];
+
+			if (event.end < event.start || event.start < origin)
+				continue;
+
+			fputs(",\n{\"name\":", file);
+			writeJsonString(file, event.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					ring->threadId,
+					(event.start - origin) * 1e-3,
+					(event.end - event.start) * 1e-3);
+		}
+	}
+
+	fputs("\n]}\n", file);
+
+	return fclose(file) == 0;
+}
+
+void ProfilerGpuClock::observe(uint64_t gpuTicks, uint64_t cpuTime) {
+
+	int64_t bound = static_cast<int64_t>(cpuTime) - static_cast<int64_t>(gpuTicks * nanosecondsPerTick);
+
+	if (!calibrated || bound < offset) {
+		offset = bound;
+		calibrated = true;
+	}
+}
+
+uint64_t ProfilerGpuClock::toCpuTime(uint64_t gpuTicks) const {
+	return static_cast<uint64_t>(static_cast<int64_t>(gpuTicks * nanosecondsPerTick) + offset);
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cmath>
+
+#include <resolution.h>
+
+// weight of the newest sample in the smoothed frame times
+const double RESOLUTION_SMOOTHING = 0.1;
+
+// aim a little under the target, so an average frame does not miss it
+const double RESOLUTION_HEADROOM = 0.9;
+
+// frames to hold a scale for after changing it; frames recorded at the old
+// scale are still draining
+const uint32_t RESOLUTION_SETTLE_FRAMES = 8;
+
+void ResolutionController::init(double targetSeconds, float minScale) {
+	target = targetSeconds;
+	this->minScale = minScale;
+
+	steps = 0;
+	maxSteps = static_cast<uint32_t>(std::ceil((1.0f - minScale) / RESOLUTION_SCALE_STEP - 1e-3f));
+	scale = 1.0f;
+	fixedTime = scaledTime = 0.0;
+	started = false;
+	framesSinceChange = 0;
+}
+
+void ResolutionController::initFixed(float scale) {
+	init(0.0, scale);
+	this->scale = scale;
+}
+
+void ResolutionController::gpuFrameCompleted(double fixedSeconds, double scaledSeconds, float renderScale) {
+
+	if (target <= 0.0)
+		return;
+
+	// the main pass costs about the same per pixel at any scale
+	double fullScaledSeconds = scaledSeconds / (renderScale * renderScale);
+
+	if (!started) {
+		fixedTime = fixedSeconds;
+		scaledTime = fullScaledSeconds;
+		started = true;
+	} else {
+		fixedTime += RESOLUTION_SMOOTHING * (fixedSeconds - fixedTime);
+		scaledTime += RESOLUTION_SMOOTHING * (fullScaledSeconds - scaledTime);
+	}
+
+	if (framesSinceChange < RESOLUTION_SETTLE_FRAMES) {
+		framesSinceChange++;
+		return;
+	}
+
+	// the scale at which fixed + scaled * scale^2 meets the target
+	double budget = target * RESOLUTION_HEADROOM - fixedTime;
+	double desired = scaledTime > 0.0 ? std::sqrt(std::max(budget, 0.0) / scaledTime) : 1.0;
+
+	// fewest steps down from full resolution that fit
+	uint32_t fitting = static_cast<uint32_t>(std::ceil((1.0 - std::min(desired, 1.0)) / RESOLUTION_SCALE_STEP - 1e-3));
+	fitting = std::min(fitting, maxSteps);
+
+	uint32_t next = steps;
+
+	if (fitting > steps)
+		next = fitting;
+	else if (fitting < steps)
+		next = steps - 1;
+
+	if (next != steps) {
+		steps = next;
+		scale = std::max(1.0f - steps * RESOLUTION_SCALE_STEP, minScale);
+		framesSinceChange = 0;
+	}
+
+}
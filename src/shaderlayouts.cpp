@@ -0,0 +1,40 @@
+#include <lights.h>
+#include <occlusion.h>
+#include <particles.h>
+#include <resolution.h>
+#include <shadingrate.h>
+#include <skeleton.h>
+
+// generated by the shader build, see tools/reflect.cpp
+#include <shaders.h>
+
+/*
+ * Nothing here runs; the engine's constants are checked against the layouts
+ * reflected from the compiled shaders, so changing one side without the other
+ * fails the build. Push constant structures only have to be large enough:
+ * the optimiser drops members a shader never reads.
+ */
+static_assert(shaders::light_cull_comp.localSize[0] == LIGHT_CULL_GROUP_SIZE, "light_cull.comp local size");
+static_assert(shaders::occlusion_cull_comp.localSize[0] == OCCLUSION_CULL_GROUP_SIZE, "occlusion_cull.comp local size");
+static_assert(shaders::skin_comp.localSize[0] == SKINNING_GROUP_SIZE, "skin.comp local size");
+
+static_assert(shaders::hiz_comp.localSize[0] == HIZ_GROUP_SIZE && shaders::hiz_comp.localSize[1] == HIZ_GROUP_SIZE,
+		"hiz.comp local size");
+static_assert(shaders::upscale_comp.localSize[0] == UPSCALE_GROUP_SIZE && shaders::upscale_comp.localSize[1] == UPSCALE_GROUP_SIZE,
+		"upscale.comp local size");
+static_assert(shaders::shading_rate_comp.localSize[0] == SHADING_RATE_GROUP_SIZE &&
+		shaders::shading_rate_comp.localSize[1] == SHADING_RATE_GROUP_SIZE, "shading_rate.comp local size");
+
+static_assert(shaders::particle_emit_comp.localSize[0] == PARTICLE_GROUP_SIZE &&
+		shaders::particle_simulate_comp.localSize[0] == PARTICLE_GROUP_SIZE &&
+		shaders::particle_compact_comp.localSize[0] == PARTICLE_GROUP_SIZE, "particle shader local size");
+
+static_assert(sizeof(HiZParams) >= shaders::hiz_comp.pushConstantSize, "hiz.comp push constants");
+static_assert(sizeof(UpscaleParams) >= shaders::upscale_comp.pushConstantSize, "upscale.comp push constants");
+static_assert(sizeof(ShadingRateParams) >= shaders::shading_rate_comp.pushConstantSize, "shading_rate.comp push constants");
+static_assert(sizeof(SkinningParams) >= shaders::skin_comp.pushConstantSize, "skin.comp push constants");
+static_assert(sizeof(ParticleDrawParams) >= shaders::particle_vert.pushConstantSize, "particle.vert push constants");
+static_assert(sizeof(ParticleSimulationParams) >= shaders::particle_emit_comp.pushConstantSize &&
+		sizeof(ParticleSimulationParams) >= shaders::particle_simulate_comp.pushConstantSize &&
+		sizeof(ParticleSimulationParams) >= shaders::particle_compact_comp.pushConstantSize &&
+		sizeof(ParticleSimulationParams) >= shaders::particle_finish_comp.pushConstantSize, "particle shader push constants");
@@ -0,0 +1,143 @@
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <shadermanifest.h>
+
+static const char *stageNames[SHADER_STAGE_COUNT] = { "vertex", "fragment", "compute" };
+static const char *bindingTypeNames[SHADER_BINDING_TYPE_COUNT] = { "uniform", "storage", "image", "sampler" };
+
+const ShaderBinding *findShaderBinding(const ShaderLayout &layout, uint32_t binding) {
+
+	for (uint32_t i = 0; i < layout.bindingCount; i++) {
+		if (layout.bindings[i].binding == binding)
+			return &layout.bindings[i];
+	}
+
+	return nullptr;
+}
+
+bool hasSpecConstant(const ShaderLayout &layout, uint32_t id) {
+
+	for (uint32_t i = 0; i < layout.specConstantCount; i++) {
+		if (layout.specConstantIds[i] == id)
+			return true;
+	}
+
+	return false;
+}
+
+bool ShaderManifest::load(const char *path) {
+
+	std::ifstream file(path);
+
+	if (!file.is_open())
+		return false;
+
+	layouts.clear();
+
+	std::string line;
+
+	while (std::getline(file, line)) {
+
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::string name;
+		ShaderLayout layout;
+
+		if (!parseLine(line, name, layout))
+			return false;
+
+		layouts[name] = layout;
+	}
+
+	return true;
+}
+
+const ShaderLayout *ShaderManifest::find(const std::string &name) const {
+
+	auto it = layouts.find(name);
+	return it != layouts.end() ? &it->second : nullptr;
+}
+
+std::vector<std::string> ShaderManifest::getNames() const {
+
+	std::vector<std::string> names;
+	names.reserve(layouts.size());
+
+	for (const auto &entry : layouts)
+		names.push_back(entry.first);
+
+	return names;
+}
+
+void ShaderManifest::writeLine(FILE *file, const std::string &name, const ShaderLayout &layout) {
+
+	fprintf(file, "%s %s %u %u %u %u", name.c_str(), stageNames[layout.stage],
+			layout.localSize[0], layout.localSize[1], layout.localSize[2], layout.pushConstantSize);
+
+	for (uint32_t i = 0; i < layout.bindingCount; i++)
+		fprintf(file, " %u:%s", layout.bindings[i].binding, bindingTypeNames[layout.bindings[i].type]);
+
+	for (uint32_t i = 0; i < layout.specConstantCount; i++)
+		fprintf(file, " spec:%u", layout.specConstantIds[i]);
+
+	fputc('\n', file);
+}
+
+bool ShaderManifest::parseLine(const std::string &line, std::string &name, ShaderLayout &layout) {
+
+	std::istringstream fields(line);
+	std::string stage;
+
+	layout = {};
+
+	if (!(fields >> name >> stage >> layout.localSize[0] >> layout.localSize[1] >> layout.localSize[2] >> layout.pushConstantSize))
+		return false;
+
+	uint32_t s = 0;
+	while (s < SHADER_STAGE_COUNT && stage != stageNames[s])
+		s++;
+
+	if (s == SHADER_STAGE_COUNT)
+		return false;
+
+	layout.stage = static_cast<ShaderStage>(s);
+
+	std::string field;
+
+	while (fields >> field) {
+
+		size_t colon = field.find(':');
+
+		if (colon == std::string::npos)
+			return false;
+
+		std::string key = field.substr(0, colon);
+		std::string value = field.substr(colon + 1);
+
+		if (key == "spec") {
+
+			if (layout.specConstantCount == SHADER_MAX_SPEC_CONSTANTS)
+				return false;
+
+			layout.specConstantIds[layout.specConstantCount++] = static_cast<uint32_t>(strtoul(value.c_str(), nullptr, 10));
+			continue;
+		}
+
+		uint32_t t = 0;
+		while (t < SHADER_BINDING_TYPE_COUNT && value != bindingTypeNames[t])
+			t++;
+
+		if (t == SHADER_BINDING_TYPE_COUNT || layout.bindingCount == SHADER_MAX_BINDINGS)
+			return false;
+
+		layout.bindings[layout.bindingCount++] = {
+			static_cast<uint32_t>(strtoul(key.c_str(), nullptr, 10)),
+			static_cast<ShaderBindingType>(t)
+		};
+	}
+
+	return true;
+}
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <shadows.h>
+
+void computeShadowCascades(
+		const glm::mat4 &view,
+		float fovY,
+		float aspect,
+		float near,
+		glm::vec3 lightDirection,
+		ShadowParams &params) {
+
+	const glm::mat4 inverseView = glm::inverse(view);
+	const float tanY = std::tan(0.5f * fovY);
+	const float tanX = tanY * aspect;
+
+	lightDirection = glm::normalize(lightDirection);
+
+	// a light pointing straight down would make lookAt's up vector degenerate
+	glm::vec3 up = std::fabs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	float sliceNear = near;
+
+	for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+
+		float p = static_cast<float>(i + 1) / SHADOW_CASCADE_COUNT;
+		float logarithmic = near * std::pow(SHADOW_DISTANCE / near, p);
+		float uniform = near + (SHADOW_DISTANCE - near) * p;
+		float sliceFar = SHADOW_SPLIT_LAMBDA * logarithmic + (1.0f - SHADOW_SPLIT_LAMBDA) * uniform;
+
+		glm::vec3 corners[8];
+		for (uint32_t c = 0; c < 8; c++) {
+			float depth = c < 4 ? sliceNear : sliceFar;
+			float x = (c & 1) ? depth * tanX : -depth * tanX;
+			float y = (c & 2) ? depth * tanY : -depth * tanY;
+			corners[c] = glm::vec3(inverseView * glm::vec4(x, y, -depth, 1.0f));
+		}
+
+		glm::vec3 center(0.0f);
+		for (const glm::vec3 &corner : corners)
+			center += corner / 8.0f;
+
+		// the sphere only depends on the slice, not on the camera's orientation
+		float radius = 0.0f;
+		for (const glm::vec3 &corner : corners)
+			radius = std::max(radius, glm::length(corner - center));
+		radius = std::ceil(radius * 16.0f) / 16.0f;
+
+		glm::mat4 lightView = glm::lookAt(center - lightDirection * (radius + SHADOW_CASTER_MARGIN), center, up);
+		glm::mat4 lightProjection = glm::orthoRH_ZO(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + SHADOW_CASTER_MARGIN);
+
+		// move the projection by less than a texel so the world origin lands on a texel
+		glm::vec4 origin = lightProjection * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		glm::vec2 texel = glm::vec2(origin.x, origin.y) * (0.5f * SHADOW_MAP_SIZE);
+		glm::vec2 offset = (glm::vec2(std::round(texel.x), std::round(texel.y)) - texel) * (2.0f / SHADOW_MAP_SIZE);
+
+		lightProjection[3][0] += offset.x;
+		lightProjection[3][1] += offset.y;
+
+		params.cascadeViewProjections[i] = lightProjection * lightView;
+		params.viewToCascades[i]         = params.cascadeViewProjections[i] * inverseView;
+		params.splitDepths[i]            = sliceFar;
+
+		sliceNear = sliceFar;
+	}
+
+	params.lightDirection = glm::vec4(glm::normalize(glm::vec3(view * glm::vec4(-lightDirection, 0.0f))), 0.0f);
+}
+
+uint32_t getCascadeMask(const ShadowParams &params, glm::vec3 center, float radius) {
+
+	uint32_t mask = 0;
+
+	for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; i++) {
+
+		const glm::mat4 &m = params.cascadeViewProjections[i];
+		glm::vec4 position = m * glm::vec4(center, 1.0f);
+
+		// orthographic, so the sphere's extent along each clip axis is its
+		// radius scaled by the length of that row of the matrix
+		bool inside = true;
+		for (int axis = 0; axis < 3; axis++) {
+
+			float extent = radius * glm::length(glm::vec3(m[0][axis], m[1][axis], m[2][axis]));
+			float low = axis < 2 ? -1.0f : 0.0f;
+
+			inside = inside && position[axis] + extent >= low && position[axis] - extent <= 1.0f;
+		}
+
+		if (inside)
+			mask |= 1u << i;
+	}
+
+	return mask;
+}
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <skeleton.h>
+
+uint32_t Skeleton::addJoint(int32_t parent, const glm::mat4 &inverseBindMatrix) {
+
+	// the skinning passes keep a pose and matrices per joint on the stack
+	if (parents.size() >= MAX_JOINTS) {
+		fprintf(stderr, "Skeleton has more than %u joints\n", MAX_JOINTS);
+		exit(EXIT_FAILURE);
+	}
+
+	if (parent >= static_cast<int32_t>(parents.size())) {
+		fprintf(stderr, "Joint %zu is added before its parent %d\n", parents.size(), parent);
+		exit(EXIT_FAILURE);
+	}
+
+	parents.push_back(parent);
+	inverseBindMatrices.push_back(inverseBindMatrix);
+
+	return static_cast<uint32_t>(parents.size() - 1);
+}
+
+#if defined(__SSE2__)
+/**
+ * four-wide dot product, broadcast to every lane
+ */
+static inline __m128 dot4(__m128 a, __m128 b) {
+
+	__m128 products = _mm_mul_ps(a, b);
+	__m128 swapped = _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(products, swapped);
+	swapped = _mm_movehl_ps(swapped, sums);
+	sums = _mm_add_ss(sums, swapped);
+
+	return _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(0, 0, 0, 0));
+}
+#endif
+
+void blendPoses(const JointPose *a, const JointPose *b, float t, JointPose *out, uint32_t jointCount) {
+
+#if defined(__SSE2__)
+	const __m128 weightA = _mm_set1_ps(1.0f - t);
+	const __m128 weightB = _mm_set1_ps(t);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (uint32_t i = 0; i < jointCount; i++) {
+
+		__m128 rotationA = _mm_load_ps(reinterpret_cast<const float *>(&a[i].rotation));
+		__m128 rotationB = _mm_load_ps(reinterpret_cast<const float *>(&b[i].rotation));
+
+		// q and -q are the same rotation, blend towards whichever is closer
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot4(rotationA, rotationB), _mm_setzero_ps()), signMask);
+		__m128 rotation = _mm_add_ps(_mm_mul_ps(rotationA, weightA), _mm_mul_ps(rotationB, _mm_xor_ps(weightB, flip)));
+		rotation = _mm_div_ps(rotation, _mm_sqrt_ps(dot4(rotation, rotation)));
+
+		__m128 translationA = _mm_load_ps(&a[i].translation.x);
+		__m128 translationB = _mm_load_ps(&b[i].translation.x);
+		__m128 translation = _mm_add_ps(_mm_mul_ps(translationA, weightA), _mm_mul_ps(translationB, weightB));
+
+		_mm_store_ps(reinterpret_cast<float *>(&out[i].rotation), rotation);
+		_mm_store_ps(&out[i].translation.x, translation);
+	}
+#else
+	for (uint32_t i = 0; i < jointCount; i++) {
+
+		glm::quat rotationB = glm::dot(a[i].rotation, b[i].rotation) < 0.0f ? -b[i].rotation : b[i].rotation;
+
+		out[i].rotation = glm::normalize(a[i].rotation * (1.0f - t) + rotationB * t);
+		out[i].translation = a[i].translation * (1.0f - t) + b[i].translation * t;
+	}
+#endif
+
+}
+
+void Skeleton::samplePose(const AnimationClip &clip, float time, JointPose *pose) const {
+
+	float frame = std::fmod(time * clip.frameRate, static_cast<float>(clip.frameCount));
+	if (frame < 0.0f)
+		frame += clip.frameCount;
+
+	uint32_t frame0 = static_cast<uint32_t>(frame) % clip.frameCount;
+	uint32_t frame1 = (frame0 + 1) % clip.frameCount;
+
+	blendPoses(
+			&clip.poses[frame0 * clip.jointCount],
+			&clip.poses[frame1 * clip.jointCount],
+			frame - std::floor(frame),
+			pose,
+			clip.jointCount
+			);
+
+}
+
+/**
+ * out = a * b for column-major matrices; out may alias a or b
+ */
+static inline void multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out) {
+
+#if defined(__SSE2__)
+	__m128 a0 = _mm_loadu_ps(&a[0][0]);
+	__m128 a1 = _mm_loadu_ps(&a[1][0]);
+	__m128 a2 = _mm_loadu_ps(&a[2][0]);
+	__m128 a3 = _mm_loadu_ps(&a[3][0]);
+
+	__m128 columns[4];
+
+	for (int c = 0; c < 4; c++) {
+		columns[c] = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[c][0])), _mm_mul_ps(a1, _mm_set1_ps(b[c][1]))),
+				_mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[c][2])), _mm_mul_ps(a3, _mm_set1_ps(b[c][3])))
+				);
+	}
+
+	for (int c = 0; c < 4; c++)
+		_mm_storeu_ps(&out[c][0], columns[c]);
+#else
+	out = a * b;
+#endif
+
+}
+
+static glm::mat4 poseToMatrix(const JointPose &pose) {
+
+	glm::mat4 matrix = glm::mat4_cast(pose.rotation);
+
+	matrix[0] *= pose.translation.w;
+	matrix[1] *= pose.translation.w;
+	matrix[2] *= pose.translation.w;
+	matrix[3] = glm::vec4(glm::vec3(pose.translation), 1.0f);
+
+	return matrix;
+}
+
+void Skeleton::computeSkinningMatrices(const JointPose *pose, const glm::mat4 &root, glm::mat4 *skinningMatrices) const {
+
+	glm::mat4 modelMatrices[MAX_JOINTS];
+
+	for (uint32_t j = 0; j < parents.size(); j++) {
+
+		glm::mat4 local = poseToMatrix(pose[j]);
+
+		multiply(parents[j] < 0 ? root : modelMatrices[parents[j]], local, modelMatrices[j]);
+		multiply(modelMatrices[j], inverseBindMatrices[j], skinningMatrices[j]);
+	}
+
+}
+
+void buildSkinnedColumn(
+		uint32_t jointCount,
+		std::vector<Vertex> &vertices,
+		std::vector<VertexSkin> &skins,
+		std::vector<uint32_t> &indices,
+		Skeleton &skeleton,
+		AnimationClip &clip) {
+
+	const float height = 1.0f;
+	const float radius = 0.05f;
+	const uint32_t segments = 12;
+	const uint32_t rings = 4 * jointCount + 1;
+	const float boneLength = height / jointCount;
+	const float pi = 3.14159265f;
+
+	// a straight chain up the y axis, each joint one bone above its parent
+	for (uint32_t j = 0; j < jointCount; j++) {
+		glm::mat4 inverseBind = glm::mat4(1.0f);
+		inverseBind[3] = glm::vec4(0.0f, -(j * boneLength), 0.0f, 1.0f);
+		skeleton.addJoint(static_cast<int32_t>(j) - 1, inverseBind);
+	}
+
+	for (uint32_t r = 0; r < rings; r++) {
+
+		float y = height * r / (rings - 1);
+
+		// blend between the two joints whose pivots the vertex lies between
+		float bone = y / boneLength;
+		uint32_t joint0 = std::min(static_cast<uint32_t>(bone), jointCount - 1);
+		uint32_t joint1 = std::min(joint0 + 1, jointCount - 1);
+		float blend = joint0 == joint1 ? 0.0f : bone - joint0;
+
+		for (uint32_t s = 0; s < segments; s++) {
+
+			float angle = 2.0f * pi * s / segments;
+			glm::vec3 position(radius * std::cos(angle), y, radius * std::sin(angle));
+			glm::vec3 color(0.2f + 0.8f * y / height, 0.4f, 1.0f - 0.8f * y / height);
+
+			vertices.push_back(Vertex(position, color, glm::vec2(static_cast<float>(s) / segments, y / height)));
+			skins.push_back(packVertexSkin(glm::uvec4(joint0, joint1, 0, 0), glm::vec4(1.0f - blend, blend, 0.0f, 0.0f)));
+		}
+	}
+
+	for (uint32_t r = 0; r + 1 < rings; r++) {
+		for (uint32_t s = 0; s < segments; s++) {
+
+			uint32_t a = r * segments + s;
+			uint32_t b = r * segments + (s + 1) % segments;
+			uint32_t c = a + segments;
+			uint32_t d = b + segments;
+
+			indices.insert(indices.end(), { a, c, b, b, c, d });
+		}
+	}
+
+	// two second loop, each joint swaying a little behind its parent
+	clip.frameRate  = 30.0f;
+	clip.frameCount = 60;
+	clip.jointCount = jointCount;
+	clip.poses.resize(clip.frameCount * jointCount);
+
+	for (uint32_t f = 0; f < clip.frameCount; f++) {
+		for (uint32_t j = 0; j < jointCount; j++) {
+
+			float phase = 2.0f * pi * f / clip.frameCount - 0.5f * j;
+
+			JointPose &pose = clip.poses[f * jointCount + j];
+			pose.rotation    = glm::angleAxis(0.25f * std::sin(phase), glm::vec3(0.0f, 0.0f, 1.0f));
+			pose.translation = glm::vec4(0.0f, j == 0 ? 0.0f : boneLength, 0.0f, 1.0f);
+		}
+	}
+
+}
@@ -0,0 +1,62 @@
+#include <cstring>
+
+#include <profiler.h>
+#include <staging.h>
+
+void StagingRing::init(VkBuffer buffer, void *mapped, VkDeviceSize capacity) {
+	this->buffer = buffer;
+	this->mapped = static_cast<uint8_t *>(mapped);
+	this->capacity = capacity;
+
+	head = tail = 0;
+}
+
+void *StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset) {
+
+	if (size > capacity)
+		return nullptr;
+
+	uint64_t start = (head + alignment - 1) / alignment * alignment;
+
+	// wrap rather than split the allocation across the end of the buffer
+	if (start % capacity + size > capacity)
+		start = (start / capacity + 1) * capacity;
+
+	if (start + size - tail > capacity)
+		return nullptr;
+
+	head = start + size;
+	offset = start % capacity;
+
+	return mapped + offset;
+}
+
+bool StagingRing::upload(VkCommandBuffer commandBuffer, const void *data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset) {
+
+	PROFILE_ZONE("StagingRing::upload");
+
+	VkDeviceSize offset;
+	void *dst = allocate(size, 16, offset);
+
+	if (!dst)
+		return false;
+
+	memcpy(dst, data, size);
+
+	VkBufferCopy region = {};
+	region.srcOffset = offset;
+	region.dstOffset = dstOffset;
+	region.size      = size;
+
+	vkCmdCopyBuffer(commandBuffer, buffer, dstBuffer, 1, &region);
+
+	return true;
+}
+
+void StagingRing::retire(uint64_t head) {
+	tail = head;
+}
+
+void StagingRing::reset() {
+	head = tail = 0;
+}
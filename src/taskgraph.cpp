@@ -0,0 +1,172 @@
+#include <algorithm>
+
+#include <profiler.h>
+#include <taskgraph.h>
+
+TaskId TaskGraph::add(const char *name, std::function<void()> function, std::vector<TaskId> dependencies, uint32_t flags) {
+
+	TaskId id = static_cast<TaskId>(tasks.size());
+
+	Task task = {};
+	task.name         = name;
+	task.function     = std::move(function);
+	task.dependencies = std::move(dependencies);
+	task.flags        = flags;
+	task.pendingCount = static_cast<uint32_t>(task.dependencies.size());
+
+	for (TaskId dependency : task.dependencies) {
+
+		if (dependency >= id) {
+			fprintf(stderr, "Task %s depends on a task added after it\n", name);
+			exit(EXIT_FAILURE);
+		}
+
+		tasks[dependency].dependents.push_back(id);
+	}
+
+	tasks.push_back(std::move(task));
+
+	return id;
+}
+
+void TaskGraph::run(JobSystem &jobs) {
+
+	this->jobs = &jobs;
+	runStart = std::chrono::steady_clock::now();
+	threadCount = jobs.getThreadCount();
+	unfinishedCount = static_cast<uint32_t>(tasks.size());
+
+	// all found before the first is scheduled, as its job then changes the
+	// counts and the main-thread queue
+	std::vector<TaskId> ready;
+
+	for (TaskId id = 0; id < tasks.size(); id++) {
+		if (tasks[id].pendingCount > 0)
+			continue;
+
+		if (tasks[id].flags & TASK_MAIN_THREAD)
+			readyMainTasks.push_back(id);
+		else
+			ready.push_back(id);
+	}
+
+	for (TaskId id : ready)
+		schedule(id);
+
+	// the workers take everything else, so the calling thread only wakes for
+	// its own tasks rather than competing with them for a core
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+
+		taskReady.wait(lock, [this] { return !readyMainTasks.empty() || unfinishedCount == 0; });
+
+		if (readyMainTasks.empty())
+			break;
+
+		TaskId id = readyMainTasks.front();
+		readyMainTasks.pop_front();
+
+		lock.unlock();
+		execute(id);
+		lock.lock();
+	}
+
+	lock.unlock();
+
+	// the last task's job may not have returned yet
+	jobs.wait(scheduledTasks);
+
+	runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+}
+
+void TaskGraph::schedule(TaskId id) {
+
+	Job job = {};
+	job.function = [](void *data, uint32_t begin, uint32_t) { static_cast<TaskGraph *>(data)->execute(begin); };
+	job.data     = this;
+	job.begin    = id;
+	job.end      = id + 1;
+	job.counter  = &scheduledTasks;
+
+	jobs->schedule(job);
+}
+
+void TaskGraph::execute(TaskId id) {
+
+	Task &task = tasks[id];
+	task.thread = JobSystem::getThreadIndex();
+	task.start = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+	{
+		PROFILE_ZONE(task.name);
+		task.function();
+	}
+
+	task.end = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+	std::vector<TaskId> ready;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for (TaskId dependent : task.dependents) {
+			if (--tasks[dependent].pendingCount > 0)
+				continue;
+
+			if (tasks[dependent].flags & TASK_MAIN_THREAD)
+				readyMainTasks.push_back(dependent);
+			else
+				ready.push_back(dependent);
+		}
+
+		unfinishedCount--;
+	}
+
+	taskReady.notify_all();
+
+	// scheduled from here they land on this thread's deque, warm and first in line
+	for (TaskId dependent : ready)
+		schedule(dependent);
+
+}
+
+void TaskGraph::writeReport(FILE *file) const {
+
+	std::vector<TaskId> order(tasks.size());
+	for (TaskId id = 0; id < tasks.size(); id++)
+		order[id] = id;
+
+	std::sort(order.begin(), order.end(), [this](TaskId a, TaskId b) { return tasks[a].start < tasks[b].start; });
+
+	double taskTime = 0.0;
+
+	fprintf(file, "%-32s %8s %8s %6s\n", "task", "start", "time", "thread");
+
+	for (TaskId id : order) {
+		const Task &task = tasks[id];
+		fprintf(file, "%-32s %6.1fms %6.1fms %6u\n", task.name, task.start * 1e3, (task.end - task.start) * 1e3, task.thread);
+		taskTime += task.end - task.start;
+	}
+
+	fprintf(file, "%.1fms on %u threads, %.1fms if run one after another\n", runTime * 1e3, threadCount, taskTime * 1e3);
+
+	if (tasks.empty())
+		return;
+
+	// the chain through the dependency that finished last, walked back from the last task to finish
+	TaskId last = *std::max_element(order.begin(), order.end(), [this](TaskId a, TaskId b) { return tasks[a].end < tasks[b].end; });
+
+	std::vector<TaskId> chain = { last };
+
+	while (!tasks[chain.back()].dependencies.empty()) {
+		const std::vector<TaskId> &dependencies = tasks[chain.back()].dependencies;
+		chain.push_back(*std::max_element(dependencies.begin(), dependencies.end(), [this](TaskId a, TaskId b) { return tasks[a].end < tasks[b].end; }));
+	}
+
+	fputs("critical path:", file);
+
+	for (auto it = chain.rbegin(); it != chain.rend(); it++)
+		fprintf(file, " %s%s", tasks[*it].name, it + 1 == chain.rend() ? "\n" : " ->");
+
+}
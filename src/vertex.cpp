@@ -1,9 +1,40 @@
 #include <vertex.h>
 
-// TODO: make position a vec3
 Vertex::Vertex(glm::vec2 position, glm::vec3 color, glm::vec2 texCoord) {
+	this->position = glm::vec3(position, 0.0f);
+	this->color = color;
+	this->texCoord = texCoord;
+}
+
+Vertex::Vertex(glm::vec3 position, glm::vec3 color, glm::vec2 texCoord) {
 	this->position = position;
 	this->color = color;
 	this->texCoord = texCoord;
 }
 
+
+VertexSkin packVertexSkin(glm::uvec4 joints, glm::vec4 weights) {
+
+	float total = weights.x + weights.y + weights.z + weights.w;
+	weights = total > 0.0f ? weights / total : glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+
+	// quantise, giving the rounding error to the largest weight so the sum stays exact
+	uint32_t quantised[4];
+	uint32_t sum = 0, largest = 0;
+
+	for (uint32_t i = 0; i < 4; i++) {
+		quantised[i] = static_cast<uint32_t>(weights[i] * 255.0f + 0.5f);
+		sum += quantised[i];
+
+		if (weights[i] > weights[largest])
+			largest = i;
+	}
+
+	quantised[largest] = quantised[largest] + 255 - sum;
+
+	VertexSkin skin;
+	skin.joints  = (joints.x & 0xff) | (joints.y & 0xff) << 8 | (joints.z & 0xff) << 16 | (joints.w & 0xff) << 24;
+	skin.weights = quantised[0] | quantised[1] << 8 | quantised[2] << 16 | quantised[3] << 24;
+
+	return skin;
+}
@@ -0,0 +1,110 @@
+#!/bin/sh
+#
+# Regression suite: renders each scene in tests/scenes.txt headless, compares
+# the frame with the scene's golden image and its frame time with the
+# baseline. spock itself fails a scene that allocates from the heap in steady
+# state (see --bench-allocations).
+#
+# usage: run.sh check|update spock imagediff
+#
+# update renders every scene and replaces the golden images and baselines
+# with the results; check them in once they have been looked at. Both are
+# specific to the driver they were made on, lavapipe unless LAVAPIPE_ICD is
+# set to another driver's ICD file, and the baselines to the machine.
+#
+# FRAMES         frames counted per scene (default 100), the last is captured
+# PERF_TOLERANCE percent the mean frame time may exceed its baseline (default 25)
+# IMAGE_ARGS     arguments to imagediff (default its own tolerances)
+
+set -u
+
+mode=$1
+spock=$2
+imagediff=$3
+
+tests=$(cd "$(dirname "$0")" && pwd)
+golden=$tests/golden
+baseline=$tests/baseline.txt
+output=test_output
+
+FRAMES=${FRAMES:-100}
+PERF_TOLERANCE=${PERF_TOLERANCE:-25}
+IMAGE_ARGS=${IMAGE_ARGS:-}
+LAVAPIPE_ICD=${LAVAPIPE_ICD:-/usr/share/vulkan/icd.d/lvp_icd.x86_64.json}
+
+if [ ! -f "$LAVAPIPE_ICD" ]; then
+	echo "No Vulkan driver at $LAVAPIPE_ICD; install lavapipe or set LAVAPIPE_ICD" >&2
+	exit 1
+fi
+
+# the loader reads the first, older loaders the second
+export VK_DRIVER_FILES="$LAVAPIPE_ICD"
+export VK_ICD_FILENAMES="$LAVAPIPE_ICD"
+
+mkdir -p "$output"
+
+if [ "$mode" = update ]; then
+	mkdir -p "$golden"
+	: > "$output/baseline.txt"
+fi
+
+failed=0
+
+# every line but comments and blank ones; the name, then spock's arguments
+sed -e 's/#.*//' -e '/^[[:space:]]*$/d' "$tests/scenes.txt" > "$output/scenes.txt"
+
+while read -r name args; do
+
+	frame=$output/$name.ppm
+	log=$output/$name.log
+
+	if ! "$spock" --bench-allocations "$FRAMES" --capture "$frame" $args > "$log" 2>&1 < /dev/null; then
+		echo "$name: FAILED, see $log"
+		failed=1
+		continue
+	fi
+
+	mean=$(sed -n 's/^frame time: \([0-9.]*\)ms mean.*/\1/p' "$log")
+
+	# an empty mean would compare as 0 and pass any baseline
+	if [ -z "$mean" ]; then
+		echo "$name: no frame time in $log, FAILED"
+		failed=1
+		continue
+	fi
+
+	if [ "$mode" = update ]; then
+		cp "$frame" "$golden/$name.ppm"
+		echo "$name $mean" >> "$output/baseline.txt"
+		echo "$name: $mean ms"
+		continue
+	fi
+
+	if [ ! -f "$golden/$name.ppm" ]; then
+		echo "$name: no golden image, make golden creates it"
+		failed=1
+	elif ! "$imagediff" $IMAGE_ARGS "$golden/$name.ppm" "$frame" "$output/$name.diff.ppm"; then
+		echo "$name: frame differs, see $output/$name.diff.ppm"
+		failed=1
+	fi
+
+	expected=$(awk -v name="$name" '$1 == name { print $2 }' "$baseline" 2> /dev/null)
+
+	if [ -z "$expected" ]; then
+		echo "$name: $mean ms, no baseline, make golden creates it"
+		failed=1
+	elif ! awk -v mean="$mean" -v expected="$expected" -v tolerance="$PERF_TOLERANCE" \
+			'BEGIN { exit !(mean <= expected * (1 + tolerance / 100)) }'; then
+		echo "$name: $mean ms against a baseline of $expected ms, FAILED"
+		failed=1
+	else
+		echo "$name: $mean ms against a baseline of $expected ms"
+	fi
+
+done < "$output/scenes.txt"
+
+if [ "$mode" = update ]; then
+	cp "$output/baseline.txt" "$baseline"
+fi
+
+exit $failed
@@ -0,0 +1,349 @@
+/*
+ * cook: offline converter from source assets to the .spk container
+ *
+ * usage: cook -o level.spk [mesh.obj ...] [texture.ppm ...]
+ *
+ * Meshes are imported (with their LOD chains) into one shared vertex and index
+ * array, exactly as the engine would at runtime, and written out in GPU
+ * layout. Textures are expanded to RGBA8.
+ */
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "asset.h"
+#include "lod.h"
+#include "vertex.h"
+
+struct CookedTexture {
+	AssetTexture header;
+	std::vector<uint8_t> texels;
+};
+
+static bool hasSuffix(const std::string &s, const char *suffix) {
+	size_t n = strlen(suffix);
+	return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+/**
+ * resolves a (possibly negative, relative) 1-based OBJ index
+ */
+static int objIndex(int index, size_t count) {
+	return index < 0 ? static_cast<int>(count) + index : index - 1;
+}
+
+static bool loadObj(const char *path, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+
+	std::ifstream file(path);
+
+	if (!file.is_open()) {
+		fprintf(stderr, "Could not open file %s\n", path);
+		return false;
+	}
+
+	std::vector<glm::vec3> positions, colors;
+	std::vector<glm::vec2> texCoords;
+
+	// OBJ indexes positions and texture coordinates separately
+	std::map<std::pair<int, int>, uint32_t> vertexCache;
+
+	std::string line;
+	while (std::getline(file, line)) {
+
+		std::istringstream in(line);
+		std::string token;
+		in >> token;
+
+		if (token == "v") {
+
+			glm::vec3 p, c(1.0f, 1.0f, 1.0f);
+			in >> p.x >> p.y >> p.z;
+
+			// optional per-vertex colour extension
+			if (!(in >> c.x >> c.y >> c.z))
+				c = glm::vec3(1.0f, 1.0f, 1.0f);
+
+			positions.push_back(p);
+			colors.push_back(c);
+
+		} else if (token == "vt") {
+
+			glm::vec2 t;
+			in >> t.x >> t.y;
+			texCoords.push_back(t);
+
+		} else if (token == "f") {
+
+			std::vector<uint32_t> face;
+
+			while (in >> token) {
+
+				int p = 0, t = 0;
+				if (sscanf(token.c_str(), "%d/%d", &p, &t) < 1) {
+					fprintf(stderr, "%s: malformed face '%s'\n", path, line.c_str());
+					return false;
+				}
+
+				p = objIndex(p, positions.size());
+				t = t != 0 ? objIndex(t, texCoords.size()) : -1;
+
+				if (p < 0 || p >= static_cast<int>(positions.size()) || t >= static_cast<int>(texCoords.size())) {
+					fprintf(stderr, "%s: face index out of range '%s'\n", path, line.c_str());
+					return false;
+				}
+
+				auto cached = vertexCache.find({ p, t });
+
+				if (cached == vertexCache.end()) {
+					glm::vec2 texCoord = t >= 0 ? texCoords[t] : glm::vec2(0.0f, 0.0f);
+					cached = vertexCache.insert({ { p, t }, static_cast<uint32_t>(vertices.size()) }).first;
+					vertices.push_back(Vertex(positions[p], colors[p], texCoord));
+				}
+
+				face.push_back(cached->second);
+			}
+
+			// triangulate as a fan
+			for (size_t i = 2; i < face.size(); i++)
+				indices.insert(indices.end(), { face[0], face[i - 1], face[i] });
+		}
+	}
+
+	if (indices.empty()) {
+		fprintf(stderr, "%s contains no faces\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+static bool readPpmToken(FILE *file, char *token, size_t size) {
+
+	int c;
+
+	// skip whitespace and comments
+	while ((c = fgetc(file)) != EOF) {
+		if (c == '#') {
+			while ((c = fgetc(file)) != EOF && c != '\n')
+				;
+		} else if (!isspace(c)) {
+			break;
+		}
+	}
+
+	size_t n = 0;
+	while (c != EOF && !isspace(c) && n + 1 < size) {
+		token[n++] = static_cast<char>(c);
+		c = fgetc(file);
+	}
+	token[n] = '\0';
+
+	return n > 0;
+}
+
+static bool loadPpm(const char *path, CookedTexture &texture) {
+
+	FILE *file = fopen(path, "rb");
+
+	if (!file) {
+		fprintf(stderr, "Could not open file %s\n", path);
+		return false;
+	}
+
+	char magic[8], width[16], height[16], maxValue[16];
+
+	if (!readPpmToken(file, magic, sizeof(magic)) || strcmp(magic, "P6") != 0 ||
+			!readPpmToken(file, width, sizeof(width)) ||
+			!readPpmToken(file, height, sizeof(height)) ||
+			!readPpmToken(file, maxValue, sizeof(maxValue)) || atoi(maxValue) != 255) {
+		fprintf(stderr, "%s is not an 8-bit binary PPM\n", path);
+		fclose(file);
+		return false;
+	}
+
+	uint32_t w = atoi(width), h = atoi(height);
+	std::vector<uint8_t> rgb(static_cast<size_t>(w) * h * 3);
+
+	if (fread(rgb.data(), 1, rgb.size(), file) != rgb.size()) {
+		fprintf(stderr, "%s is truncated\n", path);
+		fclose(file);
+		return false;
+	}
+
+	fclose(file);
+
+	texture.texels.resize(static_cast<size_t>(w) * h * 4);
+	for (size_t i = 0; i < static_cast<size_t>(w) * h; i++) {
+		texture.texels[i * 4 + 0] = rgb[i * 3 + 0];
+		texture.texels[i * 4 + 1] = rgb[i * 3 + 1];
+		texture.texels[i * 4 + 2] = rgb[i * 3 + 2];
+		texture.texels[i * 4 + 3] = 0xff;
+	}
+
+	texture.header = {};
+	texture.header.width     = w;
+	texture.header.height    = h;
+	texture.header.format    = VK_FORMAT_R8G8B8A8_UNORM;
+	texture.header.mipLevels = 1;
+	texture.header.dataSize  = texture.texels.size();
+
+	return true;
+}
+
+static uint64_t alignUp(uint64_t value) {
+	return (value + ASSET_ALIGNMENT - 1) / ASSET_ALIGNMENT * ASSET_ALIGNMENT;
+}
+
+struct PendingSection {
+	AssetSectionType type;
+	uint32_t count;
+	const void *data;
+	uint64_t size;
+};
+
+static bool writeAsset(const char *path, const std::vector<PendingSection> &pending) {
+
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		fprintf(stderr, "Could not create %s\n", path);
+		return false;
+	}
+
+	AssetHeader header = {};
+	header.magic        = ASSET_MAGIC;
+	header.version      = ASSET_VERSION;
+	header.sectionCount = static_cast<uint32_t>(pending.size());
+
+	std::vector<AssetSection> sections(pending.size());
+	uint64_t offset = alignUp(sizeof(AssetHeader) + sections.size() * sizeof(AssetSection));
+
+	for (size_t i = 0; i < pending.size(); i++) {
+		sections[i] = {};
+		sections[i].type   = pending[i].type;
+		sections[i].count  = pending[i].count;
+		sections[i].offset = offset;
+		sections[i].size   = pending[i].size;
+
+		offset = alignUp(offset + pending[i].size);
+	}
+
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(sections.data(), sizeof(AssetSection), sections.size(), file);
+
+	static const uint8_t padding[ASSET_ALIGNMENT] = {};
+
+	for (size_t i = 0; i < pending.size(); i++) {
+		long position = ftell(file);
+		fwrite(padding, 1, sections[i].offset - position, file);
+		fwrite(pending[i].data, 1, pending[i].size, file);
+	}
+
+	bool ok = ferror(file) == 0;
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok)
+		fprintf(stderr, "Failed writing %s\n", path);
+
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+
+	const char *output = nullptr;
+
+	std::vector<Vertex> sharedVertices;
+	std::vector<uint32_t> sharedIndices;
+	std::vector<AssetMesh> meshes;
+	std::vector<CookedTexture> textures;
+
+	for (int i = 1; i < argc; i++) {
+
+		std::string arg = argv[i];
+
+		if (arg == "-o" && i + 1 < argc) {
+			output = argv[++i];
+
+		} else if (hasSuffix(arg, ".obj")) {
+
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+
+			if (!loadObj(argv[i], vertices, indices))
+				return EXIT_FAILURE;
+
+			Mesh mesh = importMesh(vertices, indices, sharedVertices, sharedIndices);
+
+			AssetMesh assetMesh = {};
+			assetMesh.vertexOffset = mesh.vertexOffset;
+			assetMesh.vertexCount  = mesh.vertexCount;
+			assetMesh.center[0]    = mesh.center.x;
+			assetMesh.center[1]    = mesh.center.y;
+			assetMesh.center[2]    = mesh.center.z;
+			assetMesh.radius       = mesh.radius;
+			assetMesh.lodCount     = mesh.lodCount;
+
+			for (uint32_t l = 0; l < mesh.lodCount; l++) {
+				assetMesh.lods[l].firstIndex = mesh.lods[l].firstIndex;
+				assetMesh.lods[l].indexCount = mesh.lods[l].indexCount;
+				assetMesh.lods[l].error      = mesh.lods[l].error;
+			}
+
+			meshes.push_back(assetMesh);
+
+			fprintf(stdout, "%s: %u vertices, %u LODs\n", argv[i], mesh.vertexCount, mesh.lodCount);
+
+		} else if (hasSuffix(arg, ".ppm")) {
+
+			CookedTexture texture;
+
+			if (!loadPpm(argv[i], texture))
+				return EXIT_FAILURE;
+
+			textures.push_back(std::move(texture));
+
+		} else {
+			fprintf(stderr, "usage: %s -o out.spk [mesh.obj ...] [texture.ppm ...]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!output || meshes.empty()) {
+		fprintf(stderr, "usage: %s -o out.spk [mesh.obj ...] [texture.ppm ...]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// texel payloads are packed back to back, each 16-byte aligned
+	std::vector<AssetTexture> textureHeaders;
+	std::vector<uint8_t> textureData;
+
+	for (CookedTexture &texture : textures) {
+		texture.header.dataOffset = textureData.size();
+		textureHeaders.push_back(texture.header);
+
+		textureData.insert(textureData.end(), texture.texels.begin(), texture.texels.end());
+		textureData.resize(alignUp(textureData.size()));
+	}
+
+	std::vector<PendingSection> sections = {
+		{ ASSET_SECTION_VERTICES, static_cast<uint32_t>(sharedVertices.size()), sharedVertices.data(), sharedVertices.size() * sizeof(Vertex) },
+		{ ASSET_SECTION_INDICES, static_cast<uint32_t>(sharedIndices.size()), sharedIndices.data(), sharedIndices.size() * sizeof(uint32_t) },
+		{ ASSET_SECTION_MESHES, static_cast<uint32_t>(meshes.size()), meshes.data(), meshes.size() * sizeof(AssetMesh) }
+	};
+
+	if (!textures.empty()) {
+		sections.push_back({ ASSET_SECTION_TEXTURES, static_cast<uint32_t>(textureHeaders.size()), textureHeaders.data(), textureHeaders.size() * sizeof(AssetTexture) });
+		sections.push_back({ ASSET_SECTION_TEXTURE_DATA, 0, textureData.data(), textureData.size() });
+	}
+
+	if (!writeAsset(output, sections))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/*
+ * imagediff: compares a rendered frame with its golden image
+ *
+ * usage: imagediff [-t tolerance] [-p percent] golden.ppm frame.ppm [diff.ppm]
+ *
+ * A pixel differs if any channel is more than tolerance (default 2) away from
+ * the golden image's; the frames match if no more than percent (default 0.1)
+ * of the pixels differ. Rasterisation rules leave a little room between
+ * drivers and driver versions, which the defaults allow for. The optional
+ * diff image shows differing pixels in red over a darkened golden image.
+ * Exits with failure if the frames do not match.
+ */
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Image {
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> rgb;
+};
+
+static bool readPpmToken(FILE *file, char *token, size_t size) {
+
+	int c;
+
+	// skip whitespace and comments
+	while ((c = fgetc(file)) != EOF) {
+		if (c == '#') {
+			while ((c = fgetc(file)) != EOF && c != '\n')
+				;
+		} else if (!isspace(c)) {
+			break;
+		}
+	}
+
+	size_t n = 0;
+	while (c != EOF && !isspace(c) && n + 1 < size) {
+		token[n++] = static_cast<char>(c);
+		c = fgetc(file);
+	}
+	token[n] = '\0';
+
+	return n > 0;
+}
+
+static bool loadPpm(const char *path, Image &image) {
+
+	FILE *file = fopen(path, "rb");
+
+	if (!file) {
+		fprintf(stderr, "Could not open file %s\n", path);
+		return false;
+	}
+
+	char magic[8], width[16], height[16], maxValue[16];
+
+	if (!readPpmToken(file, magic, sizeof(magic)) || strcmp(magic, "P6") != 0 ||
+			!readPpmToken(file, width, sizeof(width)) ||
+			!readPpmToken(file, height, sizeof(height)) ||
+			!readPpmToken(file, maxValue, sizeof(maxValue)) || atoi(maxValue) != 255) {
+		fprintf(stderr, "%s is not an 8-bit binary PPM\n", path);
+		fclose(file);
+		return false;
+	}
+
+	image.width = atoi(width);
+	image.height = atoi(height);
+	image.rgb.resize(static_cast<size_t>(image.width) * image.height * 3);
+
+	if (fread(image.rgb.data(), 1, image.rgb.size(), file) != image.rgb.size()) {
+		fprintf(stderr, "%s is truncated\n", path);
+		fclose(file);
+		return false;
+	}
+
+	fclose(file);
+	return true;
+}
+
+static bool writePpm(const char *path, const Image &image) {
+
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		fprintf(stderr, "Could not create %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "P6\n%u %u\n255\n", image.width, image.height);
+	fwrite(image.rgb.data(), 1, image.rgb.size(), file);
+
+	bool ok = ferror(file) == 0;
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok)
+		fprintf(stderr, "Failed writing %s\n", path);
+
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+
+	int tolerance = 2;
+	double percent = 0.1;
+	std::vector<const char *> paths;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			tolerance = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+			percent = atof(argv[++i]);
+		else
+			paths.push_back(argv[i]);
+	}
+
+	if (paths.size() < 2 || paths.size() > 3) {
+		fprintf(stderr, "usage: %s [-t tolerance] [-p percent] golden.ppm frame.ppm [diff.ppm]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Image golden, frame;
+
+	if (!loadPpm(paths[0], golden) || !loadPpm(paths[1], frame))
+		return EXIT_FAILURE;
+
+	if (golden.width != frame.width || golden.height != frame.height) {
+		fprintf(stderr, "%s is %ux%u, %s is %ux%u\n", paths[0], golden.width, golden.height,
+				paths[1], frame.width, frame.height);
+		return EXIT_FAILURE;
+	}
+
+	Image diff = golden;
+	size_t pixelCount = static_cast<size_t>(golden.width) * golden.height;
+	size_t differing = 0;
+	int largest = 0;
+
+	for (size_t i = 0; i < pixelCount; i++) {
+
+		int difference = 0;
+
+		for (int c = 0; c < 3; c++)
+			difference = std::max(difference, abs(golden.rgb[i * 3 + c] - frame.rgb[i * 3 + c]));
+
+		largest = std::max(largest, difference);
+
+		if (difference > tolerance) {
+			differing++;
+			diff.rgb[i * 3 + 0] = 0xff;
+			diff.rgb[i * 3 + 1] = 0;
+			diff.rgb[i * 3 + 2] = 0;
+		} else {
+			for (int c = 0; c < 3; c++)
+				diff.rgb[i * 3 + c] /= 4;
+		}
+	}
+
+	double differingPercent = 100.0 * differing / pixelCount;
+	bool match = differingPercent <= percent;
+
+	printf("%s: %zu of %zu pixels differ (%.3f%%, largest difference %d)%s\n", paths[1],
+			differing, pixelCount, differingPercent, largest, match ? "" : ", FAILED");
+
+	if (paths.size() == 3 && !match && !writePpm(paths[2], diff))
+		return EXIT_FAILURE;
+
+	return match ? EXIT_SUCCESS : EXIT_FAILURE;
+}
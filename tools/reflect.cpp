@@ -0,0 +1,457 @@
+/*
+ * reflect: reads the layouts compiled SPIR-V modules expect of their pipelines
+ *
+ * usage: reflect manifest.txt shaders.h module.spv ...
+ *
+ * For each module, the entry point's stage and local size, the size of its
+ * push constant block, the type of each descriptor binding (set 0 only) and
+ * its specialisation constant ids are read. They are written as one line per
+ * module to the manifest the engine loads, and as constexpr ShaderLayouts to
+ * a header the engine compiles against. The module's file name is its name in
+ * the manifest; in the header, characters other than letters and digits
+ * become underscores.
+ */
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shadermanifest.h"
+
+const uint32_t SPIRV_MAGIC = 0x07230203;
+
+// the subset of the SPIR-V specification read here
+enum : uint32_t {
+	OP_ENTRY_POINT			= 15,
+	OP_EXECUTION_MODE		= 16,
+	OP_TYPE_INT				= 21,
+	OP_TYPE_FLOAT			= 22,
+	OP_TYPE_VECTOR			= 23,
+	OP_TYPE_MATRIX			= 24,
+	OP_TYPE_IMAGE			= 25,
+	OP_TYPE_SAMPLED_IMAGE	= 27,
+	OP_TYPE_ARRAY			= 28,
+	OP_TYPE_RUNTIME_ARRAY	= 29,
+	OP_TYPE_STRUCT			= 30,
+	OP_TYPE_POINTER			= 32,
+	OP_CONSTANT				= 43,
+	OP_VARIABLE				= 59,
+	OP_DECORATE				= 71,
+	OP_MEMBER_DECORATE		= 72,
+
+	EXECUTION_MODEL_VERTEX		= 0,
+	EXECUTION_MODEL_FRAGMENT	= 4,
+	EXECUTION_MODEL_GLCOMPUTE	= 5,
+
+	EXECUTION_MODE_LOCAL_SIZE	= 17,
+
+	DECORATION_SPEC_ID			= 1,
+	DECORATION_BLOCK			= 2,
+	DECORATION_BUFFER_BLOCK		= 3,
+	DECORATION_ARRAY_STRIDE		= 6,
+	DECORATION_MATRIX_STRIDE	= 7,
+	DECORATION_BINDING			= 33,
+	DECORATION_DESCRIPTOR_SET	= 34,
+	DECORATION_OFFSET			= 35,
+
+	STORAGE_CLASS_UNIFORM_CONSTANT	= 0,
+	STORAGE_CLASS_UNIFORM			= 2,
+	STORAGE_CLASS_PUSH_CONSTANT		= 9,
+	STORAGE_CLASS_STORAGE_BUFFER	= 12,
+
+	IMAGE_SAMPLED_STORAGE		= 2,	// the Sampled operand of a storage image
+};
+
+/* what is kept of each id; which fields mean anything depends on opcode */
+struct SpirvId {
+	uint32_t opcode = 0;
+	std::vector<uint32_t> operands;		// after the result id
+
+	bool hasBinding = false;
+	uint32_t binding = 0;
+	uint32_t set = 0;
+
+	bool hasSpecId = false;
+	uint32_t specId = 0;
+
+	bool block = false;
+	bool bufferBlock = false;
+	uint32_t arrayStride = 0;
+
+	std::vector<uint32_t> memberOffsets;
+	std::vector<uint32_t> memberMatrixStrides;
+};
+
+class SpirvModule {
+public:
+	bool load(const char *path);
+	bool reflect(const char *path, ShaderLayout &layout);
+
+private:
+	uint32_t typeSize(uint32_t type, uint32_t matrixStride) const;
+	bool bindingType(uint32_t type, uint32_t storageClass, ShaderBindingType &bindingType) const;
+
+	std::vector<uint32_t> words;
+	std::vector<SpirvId> ids;
+
+	uint32_t executionModel = ~0u;
+	uint32_t entryPoint = 0;
+	uint32_t localSize[3] = { 1, 1, 1 };
+};
+
+static std::vector<uint32_t> &grow(std::vector<uint32_t> &v, size_t size) {
+	if (v.size() < size)
+		v.resize(size, 0);
+	return v;
+}
+
+bool SpirvModule::load(const char *path) {
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open()) {
+		fprintf(stderr, "Could not open file %s\n", path);
+		return false;
+	}
+
+	size_t size = file.tellg();
+	file.seekg(0);
+
+	words.resize(size / sizeof(uint32_t));
+	file.read(reinterpret_cast<char *>(words.data()), words.size() * sizeof(uint32_t));
+
+	if (size % sizeof(uint32_t) != 0 || words.size() < 5 || words[0] != SPIRV_MAGIC) {
+		fprintf(stderr, "%s is not a SPIR-V module\n", path);
+		return false;
+	}
+
+	ids.assign(words[3], SpirvId());
+
+	for (size_t at = 5; at < words.size();) {
+
+		uint32_t opcode = words[at] & 0xffff;
+		uint32_t count = words[at] >> 16;
+
+		if (count == 0 || at + count > words.size()) {
+			fprintf(stderr, "%s: malformed instruction\n", path);
+			return false;
+		}
+
+		const uint32_t *op = &words[at + 1];
+		uint32_t operandCount = count - 1;
+
+		auto id = [&](uint32_t i) -> SpirvId & {
+			static SpirvId invalid;
+			return op[i] < ids.size() ? ids[op[i]] : invalid;
+		};
+
+		switch (opcode) {
+
+		case OP_ENTRY_POINT:
+			// the engine builds one entry point per module
+			if (executionModel == ~0u) {
+				executionModel = op[0];
+				entryPoint = op[1];
+			}
+			break;
+
+		case OP_EXECUTION_MODE:
+			if (op[0] == entryPoint && op[1] == EXECUTION_MODE_LOCAL_SIZE && operandCount >= 5) {
+				localSize[0] = op[2];
+				localSize[1] = op[3];
+				localSize[2] = op[4];
+			}
+			break;
+
+		case OP_DECORATE:
+			switch (op[1]) {
+			case DECORATION_SPEC_ID:		id(0).hasSpecId = true; id(0).specId = op[2]; break;
+			case DECORATION_BLOCK:			id(0).block = true; break;
+			case DECORATION_BUFFER_BLOCK:	id(0).bufferBlock = true; break;
+			case DECORATION_ARRAY_STRIDE:	id(0).arrayStride = op[2]; break;
+			case DECORATION_BINDING:		id(0).hasBinding = true; id(0).binding = op[2]; break;
+			case DECORATION_DESCRIPTOR_SET:	id(0).set = op[2]; break;
+			}
+			break;
+
+		case OP_MEMBER_DECORATE:
+			if (op[2] == DECORATION_OFFSET)
+				grow(id(0).memberOffsets, op[1] + 1)[op[1]] = op[3];
+			else if (op[2] == DECORATION_MATRIX_STRIDE)
+				grow(id(0).memberMatrixStrides, op[1] + 1)[op[1]] = op[3];
+			break;
+
+		case OP_TYPE_INT:
+		case OP_TYPE_FLOAT:
+		case OP_TYPE_VECTOR:
+		case OP_TYPE_MATRIX:
+		case OP_TYPE_IMAGE:
+		case OP_TYPE_SAMPLED_IMAGE:
+		case OP_TYPE_ARRAY:
+		case OP_TYPE_RUNTIME_ARRAY:
+		case OP_TYPE_STRUCT:
+		case OP_TYPE_POINTER:
+			id(0).opcode = opcode;
+			id(0).operands.assign(op + 1, op + operandCount);
+			break;
+
+		case OP_CONSTANT:
+		case OP_VARIABLE:
+			// result type comes first; keep it after the result id like the rest
+			id(1).opcode = opcode;
+			id(1).operands.assign(op + 2, op + operandCount);
+			id(1).operands.insert(id(1).operands.begin(), op[0]);
+			break;
+
+		default:
+			// spec constants of every kind carry their id in a decoration
+			break;
+		}
+
+		at += count;
+	}
+
+	return true;
+}
+
+/**
+ * bytes a value of type occupies under the decorated layout; matrixStride is
+ * that of the struct member the value is
+ */
+uint32_t SpirvModule::typeSize(uint32_t type, uint32_t matrixStride) const {
+
+	const SpirvId &t = ids[type];
+
+	switch (t.opcode) {
+
+	case OP_TYPE_INT:
+	case OP_TYPE_FLOAT:
+		return t.operands[0] / 8;
+
+	case OP_TYPE_VECTOR:
+		return typeSize(t.operands[0], 0) * t.operands[1];
+
+	case OP_TYPE_MATRIX:
+		return (matrixStride ? matrixStride : typeSize(t.operands[0], 0)) * t.operands[1];
+
+	case OP_TYPE_ARRAY: {
+		const SpirvId &length = ids[t.operands[1]];
+		uint32_t count = length.opcode == OP_CONSTANT ? length.operands[1] : 1;
+		uint32_t stride = t.arrayStride ? t.arrayStride : typeSize(t.operands[0], matrixStride);
+		return stride * count;
+	}
+
+	case OP_TYPE_STRUCT: {
+		uint32_t size = 0;
+
+		for (size_t m = 0; m < t.operands.size(); m++) {
+			uint32_t offset = m < t.memberOffsets.size() ? t.memberOffsets[m] : 0;
+			uint32_t stride = m < t.memberMatrixStrides.size() ? t.memberMatrixStrides[m] : 0;
+			size = std::max(size, offset + typeSize(t.operands[m], stride));
+		}
+
+		return size;
+	}
+
+	default:
+		// runtime arrays add nothing to the size a layout must provide
+		return 0;
+	}
+}
+
+bool SpirvModule::bindingType(uint32_t type, uint32_t storageClass, ShaderBindingType &bindingType) const {
+
+	// arrays of descriptors take their element's type
+	while (ids[type].opcode == OP_TYPE_ARRAY || ids[type].opcode == OP_TYPE_RUNTIME_ARRAY)
+		type = ids[type].operands[0];
+
+	const SpirvId &t = ids[type];
+
+	if (storageClass == STORAGE_CLASS_STORAGE_BUFFER) {
+		bindingType = SHADER_BINDING_STORAGE_BUFFER;
+		return true;
+	}
+
+	if (storageClass == STORAGE_CLASS_UNIFORM) {
+		bindingType = t.bufferBlock ? SHADER_BINDING_STORAGE_BUFFER : SHADER_BINDING_UNIFORM_BUFFER;
+		return true;
+	}
+
+	if (t.opcode == OP_TYPE_SAMPLED_IMAGE) {
+		bindingType = SHADER_BINDING_SAMPLED_IMAGE;
+		return true;
+	}
+
+	if (t.opcode == OP_TYPE_IMAGE && t.operands[5] == IMAGE_SAMPLED_STORAGE) {
+		bindingType = SHADER_BINDING_STORAGE_IMAGE;
+		return true;
+	}
+
+	return false;
+}
+
+bool SpirvModule::reflect(const char *path, ShaderLayout &layout) {
+
+	layout = {};
+
+	switch (executionModel) {
+	case EXECUTION_MODEL_VERTEX:	layout.stage = SHADER_STAGE_VERTEX; break;
+	case EXECUTION_MODEL_FRAGMENT:	layout.stage = SHADER_STAGE_FRAGMENT; break;
+	case EXECUTION_MODEL_GLCOMPUTE:	layout.stage = SHADER_STAGE_COMPUTE; break;
+	default:
+		fprintf(stderr, "%s: unsupported entry point\n", path);
+		return false;
+	}
+
+	for (int i = 0; i < 3; i++)
+		layout.localSize[i] = localSize[i];
+
+	for (uint32_t i = 0; i < ids.size(); i++) {
+
+		const SpirvId &id = ids[i];
+
+		if (id.hasSpecId) {
+
+			if (layout.specConstantCount == SHADER_MAX_SPEC_CONSTANTS) {
+				fprintf(stderr, "%s: more than %u specialisation constants\n", path, SHADER_MAX_SPEC_CONSTANTS);
+				return false;
+			}
+
+			layout.specConstantIds[layout.specConstantCount++] = id.specId;
+		}
+
+		if (id.opcode != OP_VARIABLE)
+			continue;
+
+		uint32_t storageClass = id.operands[1];
+		const SpirvId &pointer = ids[id.operands[0]];
+		uint32_t type = pointer.operands[1];
+
+		if (storageClass == STORAGE_CLASS_PUSH_CONSTANT) {
+			layout.pushConstantSize = typeSize(type, 0);
+			continue;
+		}
+
+		if (storageClass != STORAGE_CLASS_UNIFORM_CONSTANT && storageClass != STORAGE_CLASS_UNIFORM &&
+				storageClass != STORAGE_CLASS_STORAGE_BUFFER)
+			continue;
+
+		ShaderBindingType bindingType;
+
+		if (!id.hasBinding || !this->bindingType(type, storageClass, bindingType)) {
+			fprintf(stderr, "%s: variable %u is not a descriptor the engine binds\n", path, i);
+			return false;
+		}
+
+		if (id.set != 0) {
+			fprintf(stderr, "%s: binding %u is in set %u; only set 0 is used\n", path, id.binding, id.set);
+			return false;
+		}
+
+		if (layout.bindingCount == SHADER_MAX_BINDINGS) {
+			fprintf(stderr, "%s: more than %u bindings\n", path, SHADER_MAX_BINDINGS);
+			return false;
+		}
+
+		layout.bindings[layout.bindingCount++] = { id.binding, bindingType };
+	}
+
+	std::sort(layout.bindings, layout.bindings + layout.bindingCount,
+			[](const ShaderBinding &a, const ShaderBinding &b) { return a.binding < b.binding; });
+	std::sort(layout.specConstantIds, layout.specConstantIds + layout.specConstantCount);
+
+	return true;
+}
+
+static std::string baseName(const std::string &path) {
+	size_t slash = path.find_last_of('/');
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static std::string identifier(const std::string &name) {
+
+	std::string result = name;
+
+	for (char &c : result) {
+		if (!isalnum(static_cast<unsigned char>(c)))
+			c = '_';
+	}
+
+	return result;
+}
+
+static void writeLayout(FILE *file, const std::string &name, const ShaderLayout &layout) {
+
+	static const char *stages[] = { "SHADER_STAGE_VERTEX", "SHADER_STAGE_FRAGMENT", "SHADER_STAGE_COMPUTE" };
+	static const char *types[] = { "SHADER_BINDING_UNIFORM_BUFFER", "SHADER_BINDING_STORAGE_BUFFER",
+			"SHADER_BINDING_STORAGE_IMAGE", "SHADER_BINDING_SAMPLED_IMAGE" };
+
+	fprintf(file, "\n// %s\nconstexpr ShaderLayout %s = {\n", name.c_str(), identifier(name).c_str());
+	fprintf(file, "\t%s, { %u, %u, %u }, %u,\n", stages[layout.stage],
+			layout.localSize[0], layout.localSize[1], layout.localSize[2], layout.pushConstantSize);
+
+	fprintf(file, "\t%u, {", layout.bindingCount);
+	for (uint32_t i = 0; i < layout.bindingCount; i++)
+		fprintf(file, "%s { %u, %s }", i ? "," : "", layout.bindings[i].binding, types[layout.bindings[i].type]);
+	fprintf(file, " },\n");
+
+	fprintf(file, "\t%u, {", layout.specConstantCount);
+	for (uint32_t i = 0; i < layout.specConstantCount; i++)
+		fprintf(file, "%s %u", i ? "," : "", layout.specConstantIds[i]);
+	fprintf(file, " }\n};\n");
+}
+
+int main(int argc, char *argv[]) {
+
+	if (argc < 4) {
+		fprintf(stderr, "usage: %s manifest.txt shaders.h module.spv ...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FILE *manifest = fopen(argv[1], "w");
+	FILE *header = fopen(argv[2], "w");
+
+	if (!manifest || !header) {
+		fprintf(stderr, "Could not open %s or %s for writing\n", argv[1], argv[2]);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(manifest, "# generated by reflect; name stage localX localY localZ pushConstantBytes [binding:type]... [spec:id]...\n");
+	fprintf(header, "// generated by reflect from the compiled shaders; do not edit\n");
+	fprintf(header, "#ifndef _SHADERS_H\n#define _SHADERS_H\n\n#include <shadermanifest.h>\n\nnamespace shaders {\n");
+
+	bool ok = true;
+
+	for (int i = 3; i < argc && ok; i++) {
+
+		SpirvModule module;
+		ShaderLayout layout;
+
+		ok = module.load(argv[i]) && module.reflect(argv[i], layout);
+
+		if (ok) {
+			std::string name = baseName(argv[i]);
+			ShaderManifest::writeLine(manifest, name, layout);
+			writeLayout(header, name, layout);
+		}
+	}
+
+	fprintf(header, "\n}\n\n#endif\n");
+
+	fclose(manifest);
+	fclose(header);
+
+	if (!ok) {
+		// leave nothing behind for make to mistake for up to date
+		remove(argv[1]);
+		remove(argv[2]);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}